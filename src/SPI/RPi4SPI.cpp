@@ -65,4 +65,14 @@ short RPi4SPI::spiTransfer16(short toSend)
 
 void RPi4SPI::csHigh() { this->gpioDriver.digitalWrite(this->csPin, GPIO_HIGH); }
 
-void RPi4SPI::csLow() { this->gpioDriver.digitalWrite(this->csPin, GPIO_LOW); }
\ No newline at end of file
+void RPi4SPI::csLow() { this->gpioDriver.digitalWrite(this->csPin, GPIO_LOW); }
+
+void RPi4SPI::addCS(PIN csPin)
+{
+	this->gpioDriver.pinMode(csPin, GPIO_OUTPUT);
+	this->gpioDriver.digitalWrite(csPin, GPIO_HIGH);
+}
+
+void RPi4SPI::csHigh(PIN csPin) { this->gpioDriver.digitalWrite(csPin, GPIO_HIGH); }
+
+void RPi4SPI::csLow(PIN csPin) { this->gpioDriver.digitalWrite(csPin, GPIO_LOW); }
\ No newline at end of file
@@ -45,6 +45,10 @@ class RPi4SPI : public SPIDriver
 
 	void csHigh();
 	void csLow();
+
+	void addCS(PIN csPin);
+	void csHigh(PIN csPin);
+	void csLow(PIN csPin);
 };
 
 #endif
\ No newline at end of file
@@ -41,6 +41,10 @@ class SPIDriver
 
 	virtual void csHigh();
 	virtual void csLow();
+
+	virtual void addCS(PIN csPin);
+	virtual void csHigh(PIN csPin);
+	virtual void csLow(PIN csPin);
 };
 
 inline void	 SPIDriver::init(PIN csPin, unsigned int frequency, int settings) {}
@@ -48,5 +52,8 @@ inline char	 SPIDriver::spiTransfer(char toSend) { return 0; }
 inline short SPIDriver::spiTransfer16(short toSend) { return 0; }
 inline void	 SPIDriver::csHigh() {}
 inline void	 SPIDriver::csLow() {}
+inline void	 SPIDriver::addCS(PIN csPin) {}
+inline void	 SPIDriver::csHigh(PIN csPin) {}
+inline void	 SPIDriver::csLow(PIN csPin) {}
 
 #endif
\ No newline at end of file
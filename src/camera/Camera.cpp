@@ -27,29 +27,84 @@
  * Plus OV5642 Camera
  */
 
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
 #include "Camera.h"
 #include "ov5642_regs.h"
 
-#ifdef DEBUG
-#include <stdio.h>
-#endif
+// Registers that differ from their power-on values once init() has run
+static const unsigned int signatureRegisters[SIGNATURE_REGISTERS] = {
+	0x3818, 0x3621, 0x3801, 0x4407, 0x4740, 0x501e, 0x5002, 0x4300, 0x3808, 0x3809, 0x380a, 0x380b};
+
+// FNV-1a over the state file contents preceding the digest
+static unsigned int stateDigest(const CameraState & state)
+{
+	const unsigned char * bytes	 = (const unsigned char *) &state;
+	unsigned int		  digest = 2166136261u;
+
+	for(unsigned int i = 0; i < offsetof(CameraState, digest); i++)
+	{
+		digest ^= bytes[i];
+		digest *= 16777619u;
+	}
+
+	return digest;
+}
 
 Camera::Camera()
 {
-	this->csPin	 = 21;
-	this->format = IMG_JPEG;
+	this->csPin			= 21;
+	this->format		= IMG_JPEG;
+	this->currentLength = 0;
+	this->readOffset	= 0;
+	this->captureState	= CAPTURE_IDLE;
+	this->timing		= FrameTiming();
+	this->warmStart		= false;
+	this->spi			= &this->spiDriver;
+
+	snprintf(this->statePath, STATE_PATH_SIZE, CAMERA_STATE_PATH, this->csPin);
 }
 
 Camera::Camera(unsigned int cs)
 {
-	this->csPin	 = cs;
-	this->format = IMG_JPEG;
+	this->csPin			= cs;
+	this->format		= IMG_JPEG;
+	this->currentLength = 0;
+	this->readOffset	= 0;
+	this->captureState	= CAPTURE_IDLE;
+	this->timing		= FrameTiming();
+	this->warmStart		= false;
+	this->spi			= &this->spiDriver;
+
+	snprintf(this->statePath, STATE_PATH_SIZE, CAMERA_STATE_PATH, this->csPin);
+}
+
+Camera::Camera(SPIDriver & bus, unsigned int cs)
+{
+	this->csPin			= cs;
+	this->format		= IMG_JPEG;
+	this->currentLength = 0;
+	this->readOffset	= 0;
+	this->captureState	= CAPTURE_IDLE;
+	this->timing		= FrameTiming();
+	this->warmStart		= false;
+	this->spi			= &bus;
+	this->sharedBus		= true;
+
+	snprintf(this->statePath, STATE_PATH_SIZE, CAMERA_STATE_PATH, this->csPin);
 }
 
 void Camera::init()
 {
 	this->i2cDriver.init();
-	this->spiDriver.init(this->csPin, 0, 0);	// TODO: Add correct vals
+
+	if(this->sharedBus)
+		this->spi->addCS(this->csPin);
+	else
+		this->spiDriver.init(this->csPin, 0, 0);	// TODO: Add correct vals
+
 	this->timer.init();
 
 	while(1)
@@ -97,13 +152,32 @@ void Camera::init()
 		}
 	}
 
+	// A sensor that stayed powered since the last run still holds its tables
+	this->warmStart = this->restoreState();
+	if(this->warmStart)
+	{
+#ifdef DEBUG
+		printf("OV5642 configuration intact, skipping reset.\n");
+#endif
+		return;
+	}
+
+	this->invalidateState();
+
+	this->config.format		= this->format;
+	this->config.resolution = SETTING_UNSET;
+	this->config.saturation = SETTING_UNSET;
+	this->config.brightness = SETTING_UNSET;
+	this->config.effect		= SETTING_UNSET;
+	this->config.sharpness	= SETTING_UNSET;
+
 	this->wrSensorReg16_8(0x3008, 0x80);
-	this->wrSensorRegs16_8(OV5642_QVGA_Preview);
+	this->wrSensorTable(OV5642_QVGA_Preview_packed.table());
 
 	if(this->format == IMG_JPEG)
 	{
-		this->wrSensorRegs16_8(OV5642_JPEG_Capture_QSXGA);
-		this->wrSensorRegs16_8(ov5642_320x240);
+		this->wrSensorTable(OV5642_JPEG_Capture_QSXGA_packed.table());
+		this->wrSensorTable(ov5642_320x240_packed.table());
 		this->wrSensorReg16_8(0x3818, 0xa8);
 		this->wrSensorReg16_8(0x3621, 0x10);
 		this->wrSensorReg16_8(0x3801, 0xb0);
@@ -129,49 +203,56 @@ void Camera::init()
 void Camera::activate()
 {
 	this->timer.delay_us(1);
-	this->spiDriver.csLow();
+	this->spi->csLow(this->csPin);
 }
 
 void Camera::deactivate()
 {
 	this->timer.delay_us(1);
-	this->spiDriver.csHigh();
+	this->spi->csHigh(this->csPin);
 }
 
 void Camera::setImageFormat(IMAGE_TYPE format) { this->format = format; }
 
 void Camera::setResolution(RESOLUTION res)
 {
+	this->invalidateState();
+
 	switch(res)
 	{
 		case RES_320x240:
-			this->wrSensorRegs16_8(ov5642_320x240);
+			this->wrSensorTable(ov5642_320x240_packed.table());
 			break;
 		case RES_640x480:
-			this->wrSensorRegs16_8(ov5642_640x480);
+			this->wrSensorTable(ov5642_640x480_packed.table());
 			break;
 		case RES_1024x768:
-			this->wrSensorRegs16_8(ov5642_1024x768);
+			this->wrSensorTable(ov5642_1024x768_packed.table());
 			break;
 		case RES_1280x960:
-			this->wrSensorRegs16_8(ov5642_1280x960);
+			this->wrSensorTable(ov5642_1280x960_packed.table());
 			break;
 		case RES_1600x1200:
-			this->wrSensorRegs16_8(ov5642_1600x1200);
+			this->wrSensorTable(ov5642_1600x1200_packed.table());
 			break;
 		case RES_2048x1536:
-			this->wrSensorRegs16_8(ov5642_2048x1536);
+			this->wrSensorTable(ov5642_2048x1536_packed.table());
 			break;
 		case RES_2592x1944:
-			this->wrSensorRegs16_8(ov5642_2592x1944);
+			this->wrSensorTable(ov5642_2592x1944_packed.table());
 			break;
 		default:
 			break;
 	}
+
+	this->config.resolution = res;
+	this->saveState();
 }
 
 void Camera::setColorSaturation(COLOR_SATURATION sat)
 {
+	this->invalidateState();
+
 	this->wrSensorReg16_8(0x5001, 0xff);
 
 	switch(sat)
@@ -219,10 +300,15 @@ void Camera::setColorSaturation(COLOR_SATURATION sat)
 	}
 
 	this->wrSensorReg16_8(0x5580, 0x02);
+
+	this->config.saturation = sat;
+	this->saveState();
 }
 
 void Camera::setBrightness(BRIGHTNESS level)
 {
+	this->invalidateState();
+
 	this->wrSensorReg16_8(0x5001, 0xff);
 
 	switch(level)
@@ -269,10 +355,15 @@ void Camera::setBrightness(BRIGHTNESS level)
 			this->wrSensorReg16_8(0x558a, 0x00);
 			break;
 	}
+
+	this->config.brightness = level;
+	this->saveState();
 }
 
 void Camera::setSpecialEffect(SPECIAL_EFFECTS effect)
 {
+	this->invalidateState();
+
 	switch(effect)
 	{
 		case EFFECT_BLUISH:
@@ -314,10 +405,15 @@ void Camera::setSpecialEffect(SPECIAL_EFFECTS effect)
 			this->wrSensorReg16_8(0x5580, 0x00);
 			break;
 	}
+
+	this->config.effect = effect;
+	this->saveState();
 }
 
 void Camera::setSharpnessType(SHARPNESS_TYPE sharpness)
 {
+	this->invalidateState();
+
 	switch(sharpness)
 	{
 		case SHARP_AUTO_DEFAULT:
@@ -369,6 +465,9 @@ void Camera::setSharpnessType(SHARPNESS_TYPE sharpness)
 			this->wrSensorReg16_8(0x531f, 0x1f);
 			break;
 	}
+
+	this->config.sharpness = sharpness;
+	this->saveState();
 }
 
 void Camera::resetFirmware()
@@ -382,25 +481,157 @@ void Camera::resetFirmware()
 }
 
 void Camera::singleCapture()
+{
+	this->beginCapture();
+
+	while(this->poll() == CAPTURE_EXPOSING) {}
+
+	while(this->readChunk(CAPTURE_CHUNK_SIZE) > 0) {}
+}
+
+void Camera::startCapture() { this->writeRegister(ARDUCHIP_FIFO, FIFO_START_MASK); }
+
+void Camera::beginCapture()
 {
 	this->flushFIFO();
 	this->startCapture();
 
-	while(!this->getBit(ARDUCHIP_TRIG, CAP_DONE_MASK)) {}
+	this->currentLength = 0;
+	this->readOffset	= 0;
+	this->captureState	= CAPTURE_EXPOSING;
 
-	int count			= this->readFIFOLength();
-	this->currentLength = count;
-	int i				= 0;
+	this->timing.trigger	 = this->timer.micros();
+	this->timing.captureDone = 0;
+	this->timing.drained	 = 0;
+}
+
+CAPTURE_STATE Camera::poll()
+{
+	if(this->captureState != CAPTURE_EXPOSING) return this->captureState;
 
+	if(!this->getBit(ARDUCHIP_TRIG, CAP_DONE_MASK)) return CAPTURE_EXPOSING;
+
+	this->timing.captureDone = this->timer.micros();
+
+	unsigned int length = this->readFIFOLength();
+	if(length > JPEG_BUFFER_SIZE) length = JPEG_BUFFER_SIZE;
+
+	this->currentLength = length;
+	this->captureState	= (length > 0) ? CAPTURE_READING : CAPTURE_DONE;
+
+	if(this->captureState == CAPTURE_DONE) this->timing.drained = this->timing.captureDone;
+
+	return this->captureState;
+}
+
+unsigned int Camera::readChunk(unsigned int maxBytes)
+{
+	if(this->captureState != CAPTURE_READING) return 0;
+
+	unsigned int count = this->currentLength - this->readOffset;
+	if(count > maxBytes) count = maxBytes;
+
+	// The FIFO read pointer is kept by the ArduChip, so each chunk resumes the burst
 	this->activate();
 	this->setFIFOBurst();
 
-	while((count--) > 0) { this->readBuffer[i++] = this->spiDriver.spiTransfer(0); }
+	for(unsigned int i = 0; i < count; i++)
+		this->readBuffer[this->readOffset++] = this->spi->spiTransfer(0);
 
 	this->deactivate();
+
+	if(this->readOffset >= this->currentLength)
+	{
+		this->captureState	 = CAPTURE_DONE;
+		this->timing.drained = this->timer.micros();
+	}
+
+	return count;
 }
 
-void Camera::startCapture() { this->writeRegister(ARDUCHIP_FIFO, FIFO_START_MASK); }
+void Camera::abortCapture()
+{
+	this->currentLength = 0;
+	this->readOffset	= 0;
+	this->captureState	= CAPTURE_IDLE;
+}
+
+void Camera::setStatePath(const char * path) { snprintf(this->statePath, STATE_PATH_SIZE, "%s", path); }
+
+bool Camera::isWarmStart() const { return this->warmStart; }
+
+PIN Camera::getCSPin() const { return this->csPin; }
+
+CAPTURE_STATE Camera::getCaptureState() const { return this->captureState; }
+
+unsigned int Camera::getBytesRemaining() const { return this->currentLength - this->readOffset; }
+
+const char * Camera::getFrame() const { return this->readBuffer; }
+
+unsigned int Camera::getFrameLength() const { return this->currentLength; }
+
+FrameTiming Camera::getFrameTiming() const { return this->timing; }
+
+void Camera::readSignature(unsigned char * signature)
+{
+	for(unsigned int i = 0; i < SIGNATURE_REGISTERS; i++)
+	{
+		signature[i] = 0;
+		this->rdSensorReg16_8(signatureRegisters[i], &signature[i]);
+	}
+}
+
+bool Camera::restoreState()
+{
+	CameraState	  state;
+	unsigned char signature[SIGNATURE_REGISTERS];
+
+	FILE * file = fopen(this->statePath, "rb");
+	if(file == nullptr) return false;
+
+	bool valid = fread(&state, sizeof(state), 1, file) == 1;
+	fclose(file);
+
+	if(!valid || state.magic != STATE_MAGIC || state.digest != stateDigest(state)) return false;
+	if(state.config.format != (unsigned int) this->format) return false;
+
+	this->readSignature(signature);
+	if(memcmp(signature, state.signature, SIGNATURE_REGISTERS) != 0) return false;
+
+	this->config = state.config;
+
+	return true;
+}
+
+void Camera::saveState()
+{
+	CameraState state;
+	char		tmpPath[STATE_PATH_SIZE + 4];
+
+	memset(&state, 0, sizeof(state));
+	state.magic	 = STATE_MAGIC;
+	state.config = this->config;
+	this->readSignature(state.signature);
+	state.digest = stateDigest(state);
+
+	// Written aside and renamed so a crash never leaves a torn state file
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", this->statePath);
+
+	FILE * file = fopen(tmpPath, "wb");
+	if(file == nullptr) return;
+
+	bool written = fwrite(&state, sizeof(state), 1, file) == 1;
+	if(fclose(file) != 0 || !written)
+	{
+		remove(tmpPath);
+		return;
+	}
+
+	rename(tmpPath, this->statePath);
+}
+
+// Called before touching sensor registers, a restart in between must reprogram
+void Camera::invalidateState() { remove(this->statePath); }
 
 void Camera::clearFIFOFlag() { this->writeRegister(ARDUCHIP_FIFO, FIFO_CLEAR_MASK); }
 
@@ -415,7 +646,7 @@ unsigned int Camera::readFIFOLength()
 		   0x7fffff;
 }
 
-void Camera::setFIFOBurst() { this->spiDriver.spiTransfer(BURST_FIFO_READ); }
+void Camera::setFIFOBurst() { this->spi->spiTransfer(BURST_FIFO_READ); }
 
 unsigned char Camera::readRegister(unsigned char address) { return this->busRead(address & 0x7F); }
 
@@ -444,8 +675,8 @@ unsigned char Camera::getBit(unsigned char address, unsigned char bit)
 unsigned char Camera::busWrite(int address, int value)
 {
 	this->activate();
-	this->spiDriver.spiTransfer(address);
-	this->spiDriver.spiTransfer(value);
+	this->spi->spiTransfer(address);
+	this->spi->spiTransfer(value);
 	this->deactivate();
 	return 1;
 }
@@ -453,8 +684,8 @@ unsigned char Camera::busWrite(int address, int value)
 unsigned char Camera::busRead(int address)
 {
 	this->activate();
-	this->spiDriver.spiTransfer(address);
-	unsigned char val = this->spiDriver.spiTransfer(0x00);
+	this->spi->spiTransfer(address);
+	unsigned char val = this->spi->spiTransfer(0x00);
 	this->deactivate();
 	return val;
 }
@@ -552,6 +783,14 @@ unsigned char Camera::rdSensorReg8_8(unsigned char regID, unsigned char * regDat
 }
 
 unsigned char Camera::wrSensorReg16_8(int regID, int regDat)
+{
+	unsigned char value = regDat;
+
+	return this->wrSensorRegsBurst16_8(regID, &value, 1);
+}
+
+// The OV5642 increments the register address after every data byte
+unsigned char Camera::wrSensorRegsBurst16_8(int regID, const unsigned char * values, unsigned int count)
 {
 	this->timer.delay_us(10);
 	this->i2cDriver.start();
@@ -578,35 +817,32 @@ unsigned char Camera::wrSensorReg16_8(int regID, int regDat)
 		return 0;
 	}
 
-	this->timer.delay_us(10);
-
-	if(this->i2cDriver.write(regDat) == 0)
+	for(unsigned int i = 0; i < count; i++)
 	{
-		this->i2cDriver.stop();
-		return 0;
+		this->timer.delay_us(10);
+
+		if(this->i2cDriver.write(values[i]) == 0)
+		{
+			this->i2cDriver.stop();
+			return 0;
+		}
 	}
 
 	this->i2cDriver.stop();
 	return 1;
 }
 
-int Camera::wrSensorRegs16_8(const struct sensor_reg reglist[])
+int Camera::wrSensorTable(const RegisterTable & table)
 {
-	int			 err		= 1;
-	unsigned int regAddress = 0;
-	unsigned int regValue	= 0;
-
-	const struct sensor_reg * next = reglist;
+	int err = 1;
 
-	while((regAddress != 0xffff) | (regValue != 0xff))
+	for(unsigned int i = 0; i < table.runCount; i++)
 	{
-		regAddress = next->reg;
-		regValue   = next->val;
-		err &= this->wrSensorReg16_8(regAddress, regValue);
+		const RegisterRun & run = table.runs[i];
 
-		this->timer.delay_ms(10);
+		err &= this->wrSensorRegsBurst16_8(run.address, &table.values[run.first], run.length);
 
-		next++;
+		this->timer.delay_ms(10);
 	}
 
 	return err;
@@ -33,6 +33,7 @@
 #include "SPIDriver.h"
 #include "I2CDriver.h"
 #include "Timer.h"
+#include "CameraInput.h"
 
 #ifdef RPi4
 #include "RPi4SPI.h"
@@ -48,6 +49,29 @@ enum BUFFER_SIZE
 	CMD_BUFFER_SIZE	 = 512
 };
 
+enum CAPTURE_STATE
+{
+	CAPTURE_IDLE = 0,
+	CAPTURE_EXPOSING,
+	CAPTURE_READING,
+	CAPTURE_DONE
+};
+
+enum CAPTURE_CHUNK
+{
+	CAPTURE_CHUNK_SIZE = 4096
+};
+
+#define CAMERA_STATE_PATH "/tmp/arducam-%u.state"
+
+enum WARM_RESTART
+{
+	STATE_MAGIC			= 0x4f563532,
+	STATE_PATH_SIZE		= 128,
+	SIGNATURE_REGISTERS = 12,
+	SETTING_UNSET		= 0xff
+};
+
 enum CHIPID_LEVEL
 {
 	CHIPID_HIGH = 0x300a,
@@ -245,12 +269,40 @@ enum FRAMERATE_DETECT
 	FRAMERATE_AUTO_DETECT
 };
 
+struct RegisterTable;
+
+// Settings applied to the sensor since it was last reset
+struct CameraConfig
+{
+	unsigned int format;
+	unsigned int resolution;
+	unsigned int saturation;
+	unsigned int brightness;
+	unsigned int effect;
+	unsigned int sharpness;
+};
+
+// Contents of the state file, the digest covers everything before it
+struct CameraState
+{
+	unsigned int  magic;
+	CameraConfig  config;
+	unsigned char signature[SIGNATURE_REGISTERS];
+	unsigned int  digest;
+};
+
 class Camera
 {
   private:
-	PIN			 csPin;
-	unsigned int currentLength;
-	IMAGE_TYPE	 format;
+	PIN			  csPin;
+	unsigned int  currentLength;
+	unsigned int  readOffset;
+	CAPTURE_STATE captureState;
+	FrameTiming	  timing;
+	CameraConfig  config;
+	bool		  warmStart;
+	char		  statePath[STATE_PATH_SIZE];
+	IMAGE_TYPE	  format;
 
 	char readBuffer[JPEG_BUFFER_SIZE];
 	char commandBuffer[CMD_BUFFER_SIZE];
@@ -267,6 +319,9 @@ class Camera
 	Timer	  timer;
 #endif
 
+	SPIDriver * spi;
+	bool		sharedBus = false;
+
 	unsigned char sensorAddress = 0;
 
 	void		  clearFIFOFlag();
@@ -290,16 +345,25 @@ class Camera
 	unsigned char rdSensorReg8_8(unsigned char regID, unsigned char * regDat);
 
 	unsigned char wrSensorReg16_8(int regID, int regDat);
-	int			  wrSensorRegs16_8(const struct sensor_reg reglist[]);
+	unsigned char wrSensorRegsBurst16_8(int regID, const unsigned char * values, unsigned int count);
+	int			  wrSensorTable(const RegisterTable & table);
 	unsigned char rdSensorReg16_8(unsigned int regID, unsigned char * regDat);
 	int			  rdSensorRegs16_8(const struct sensor_reg reglist[]);
 
+	void readSignature(unsigned char * signature);
+	bool restoreState();
+	void saveState();
+	void invalidateState();
+
   public:
 	Camera(unsigned int cs);
+	Camera(SPIDriver & bus, unsigned int cs);
 	Camera();
 	~Camera() = default;
 
 	void init();
+	void setStatePath(const char * path);
+	bool isWarmStart() const;
 
 	void activate();
 	void deactivate();
@@ -314,6 +378,18 @@ class Camera
 	void resetFirmware();
 	void singleCapture();
 	void startCapture();
+
+	void		  beginCapture();
+	CAPTURE_STATE poll();
+	unsigned int  readChunk(unsigned int maxBytes);
+	void		  abortCapture();
+
+	PIN			  getCSPin() const;
+	CAPTURE_STATE getCaptureState() const;
+	unsigned int  getBytesRemaining() const;
+	const char *  getFrame() const;
+	unsigned int  getFrameLength() const;
+	FrameTiming	  getFrameTiming() const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Lena Voytek
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * CameraBus
+ *
+ * This module schedules up to four ArduCam modules sharing a single SPI bus.
+ * Exposures are triggered on every camera at once and only the FIFO readouts
+ * are serialized, in the order the cameras finish capturing
+ */
+
+#include "CameraBus.h"
+
+CameraBus::CameraBus()
+{
+	this->cameraCount	 = 0;
+	this->captureTimeout = CAPTURE_TIMEOUT_US;
+
+	for(unsigned int i = 0; i < MAX_BUS_CAMERAS; i++)
+	{
+		this->cameras[i] = nullptr;
+		this->inputs[i]	 = nullptr;
+	}
+}
+
+CameraBus::~CameraBus()
+{
+	for(unsigned int i = 0; i < this->cameraCount; i++) delete this->cameras[i];
+}
+
+Camera * CameraBus::addCamera(PIN cs, CameraInput * input)
+{
+	if(this->cameraCount >= MAX_BUS_CAMERAS) return nullptr;
+
+	Camera * camera = new Camera(this->spiDriver, cs);
+
+	this->cameras[this->cameraCount] = camera;
+	this->inputs[this->cameraCount]	 = input;
+	this->cameraCount++;
+
+	return camera;
+}
+
+void CameraBus::init()
+{
+	if(this->cameraCount == 0) return;
+
+	this->spiDriver.init(this->cameras[0]->getCSPin(), 0, 0);	// TODO: Add correct vals
+	this->timer.init();
+
+	for(unsigned int i = 0; i < this->cameraCount; i++) this->cameras[i]->init();
+}
+
+void CameraBus::setCaptureTimeout(unsigned long micros) { this->captureTimeout = micros; }
+
+unsigned int CameraBus::getCameraCount() const { return this->cameraCount; }
+
+Camera * CameraBus::getCamera(unsigned int index) const
+{
+	if(index >= this->cameraCount) return nullptr;
+
+	return this->cameras[index];
+}
+
+unsigned int CameraBus::captureAll()
+{
+	bool		 pending[MAX_BUS_CAMERAS];
+	unsigned int remaining = this->cameraCount;
+	unsigned int captured  = 0;
+
+	// Start every exposure before waiting on any of them
+	for(unsigned int i = 0; i < this->cameraCount; i++)
+	{
+		this->cameras[i]->beginCapture();
+		pending[i] = true;
+	}
+
+	uint64_t start = this->timer.micros();
+
+	// The bus is only held for a whole FIFO readout by the camera that finished first
+	while(remaining > 0)
+	{
+		for(unsigned int i = 0; i < this->cameraCount; i++)
+		{
+			if(!pending[i] || this->cameras[i]->poll() == CAPTURE_EXPOSING) continue;
+
+			while(this->cameras[i]->readChunk(CAPTURE_CHUNK_SIZE) > 0) {}
+			pending[i] = false;
+			remaining--;
+			captured++;
+
+			if(this->inputs[i] != nullptr)
+				this->inputs[i]->publish(this->cameras[i]->getFrame(),
+										 this->cameras[i]->getFrameLength(),
+										 this->cameras[i]->getFrameTiming());
+		}
+
+		// A camera that never signals CAP_DONE only loses its frame for this cycle
+		if(remaining > 0 && this->timer.micros() - start >= this->captureTimeout)
+		{
+			for(unsigned int i = 0; i < this->cameraCount; i++)
+			{
+				if(!pending[i]) continue;
+
+				this->cameras[i]->abortCapture();
+				pending[i] = false;
+			}
+			remaining = 0;
+		}
+	}
+
+	return captured;
+}
@@ -0,0 +1,77 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Lena Voytek
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * CameraBus
+ *
+ * This module schedules up to four ArduCam modules sharing a single SPI bus.
+ * Exposures are triggered on every camera at once and only the FIFO readouts
+ * are serialized, in the order the cameras finish capturing
+ */
+
+#ifndef CAMERABUS_H
+#define CAMERABUS_H
+
+#include "Camera.h"
+#include "CameraInput.h"
+
+enum BUS_LIMITS
+{
+	MAX_BUS_CAMERAS	   = 4,
+	CAPTURE_TIMEOUT_US = 1000000
+};
+
+class CameraBus
+{
+  private:
+#ifdef RPi4
+	RPi4SPI	  spiDriver;
+	RPi4Timer timer;
+#else
+	SPIDriver spiDriver;
+	Timer	  timer;
+#endif
+
+	Camera *	  cameras[MAX_BUS_CAMERAS];
+	CameraInput * inputs[MAX_BUS_CAMERAS];
+	unsigned int  cameraCount;
+	unsigned long captureTimeout;
+
+  public:
+	CameraBus();
+	~CameraBus();
+
+	// The bus owns its cameras, so it can not be copied
+	CameraBus(const CameraBus &) = delete;
+	CameraBus & operator=(const CameraBus &) = delete;
+
+	Camera * addCamera(PIN cs, CameraInput * input);
+	void	 init();
+
+	void		 setCaptureTimeout(unsigned long micros);
+	unsigned int getCameraCount() const;
+	Camera *	 getCamera(unsigned int index) const;
+
+	unsigned int captureAll();
+};
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Lena Voytek
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * CameraInput
+ *
+ * This module acts as the parent class for consumers of frames captured by a
+ * camera, such as a video stream input
+ */
+
+#ifndef CAMERAINPUT_H
+#define CAMERAINPUT_H
+
+#include <stdint.h>
+
+// Monotonic microsecond stamps of one frame, 0 when a stage was not reached
+struct FrameTiming
+{
+	uint64_t trigger;
+	uint64_t captureDone;
+	uint64_t drained;
+};
+
+class CameraInput
+{
+  public:
+	virtual ~CameraInput() = default;
+
+	virtual void publish(const char * frame, unsigned int length, const FrameTiming & timing) = 0;
+};
+
+#endif
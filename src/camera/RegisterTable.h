@@ -0,0 +1,152 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Lena Voytek
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * RegisterTable
+ *
+ * This module packs sensor register tables at compile time. Entries writing
+ * consecutive addresses are grouped into runs that can be sent as a single
+ * auto-incrementing I2C burst, and entries repeating the previous one are
+ * dropped
+ */
+
+#ifndef REGISTERTABLE_H
+#define REGISTERTABLE_H
+
+enum REGISTER_TABLE
+{
+	TABLE_END_REG	= 0xffff,
+	TABLE_END_VAL	= 0xff,
+	SYSTEM_CTRL_REG = 0x3008	// Soft reset, a burst never continues past it
+};
+
+struct RegisterRun
+{
+	unsigned short address;
+	unsigned short first;
+	unsigned short length;
+};
+
+struct RegisterTable
+{
+	const RegisterRun *	  runs;
+	unsigned int		  runCount;
+	const unsigned char * values;
+};
+
+template <unsigned int RUNS, unsigned int VALUES>
+struct PackedRegisters
+{
+	RegisterRun	  runs[RUNS];
+	unsigned char values[VALUES];
+
+	constexpr RegisterTable table() const { return {this->runs, RUNS, this->values}; }
+};
+
+template <typename REG, unsigned int N>
+constexpr bool isTerminated(const REG (&regs)[N])
+{
+	for(unsigned int i = 0; i + 1 < N; i++)
+		if(regs[i].reg == TABLE_END_REG && regs[i].val == TABLE_END_VAL) return false;
+
+	return regs[N - 1].reg == TABLE_END_REG && regs[N - 1].val == TABLE_END_VAL;
+}
+
+template <typename REG, unsigned int N>
+constexpr bool isInRange(const REG (&regs)[N])
+{
+	for(unsigned int i = 0; i < N; i++)
+		if(regs[i].reg > 0xffff || regs[i].val > 0xff) return false;
+
+	return true;
+}
+
+template <typename REG, unsigned int N>
+constexpr bool isDuplicate(const REG (&regs)[N], unsigned int i)
+{
+	return i > 0 && regs[i].reg == regs[i - 1].reg && regs[i].val == regs[i - 1].val;
+}
+
+template <typename REG, unsigned int N>
+constexpr bool continuesRun(const REG (&regs)[N], unsigned int i)
+{
+	return i > 0 && regs[i].reg == regs[i - 1].reg + 1 && regs[i - 1].reg != SYSTEM_CTRL_REG;
+}
+
+template <typename REG, unsigned int N>
+constexpr unsigned int countValues(const REG (&regs)[N])
+{
+	unsigned int count = 0;
+
+	for(unsigned int i = 0; i + 1 < N; i++)
+		if(!isDuplicate(regs, i)) count++;
+
+	return count;
+}
+
+template <typename REG, unsigned int N>
+constexpr unsigned int countRuns(const REG (&regs)[N])
+{
+	unsigned int count = 0;
+
+	for(unsigned int i = 0; i + 1 < N; i++)
+		if(!isDuplicate(regs, i) && !continuesRun(regs, i)) count++;
+
+	return count;
+}
+
+template <unsigned int RUNS, unsigned int VALUES, typename REG, unsigned int N>
+constexpr PackedRegisters<RUNS, VALUES> packRegisters(const REG (&regs)[N])
+{
+	PackedRegisters<RUNS, VALUES> packed {};
+	unsigned int				  run	= 0;
+	unsigned int				  value = 0;
+
+	for(unsigned int i = 0; i + 1 < N; i++)
+	{
+		if(isDuplicate(regs, i)) continue;
+
+		if(!continuesRun(regs, i))
+		{
+			packed.runs[run].address = regs[i].reg;
+			packed.runs[run].first	 = value;
+			run++;
+		}
+
+		packed.runs[run - 1].length++;
+		packed.values[value++] = regs[i].val;
+	}
+
+	return packed;
+}
+
+// Checks a {0xffff,0xff} terminated table without packing it
+#define CHECK_REGISTERS(name)                                                        \
+	static_assert(isTerminated(name), #name " must end with exactly one sentinel"); \
+	static_assert(isInRange(name), #name " must hold 16 bit addresses and 8 bit values")
+
+// Defines name_packed, the run-length form of a checked table
+#define PACK_REGISTERS(name) \
+	CHECK_REGISTERS(name);   \
+	constexpr auto name##_packed = packRegisters<countRuns(name), countValues(name)>(name)
+
+#endif
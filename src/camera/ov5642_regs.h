@@ -28,10 +28,14 @@
 #ifndef OV5642_REGS_H
 #define OV5642_REGS_H
 #include "ArduCAM.h"
+#include "RegisterTable.h"
 
 #define OV5642_CHIPID_HIGH 0x300a
 #define OV5642_CHIPID_LOW 0x300b
-const struct sensor_reg ov5642_RAW[]  =
+
+// The tables are inline so only what Camera uses is emitted, that is the
+// packed tables, a static constant is kept even when unused without -O
+inline constexpr struct sensor_reg ov5642_RAW[]  =
 {
 {0x3103,0x03},
 {0x3008,0x82},
@@ -161,7 +165,7 @@ const struct sensor_reg ov5642_RAW[]  =
 
 
 
-const struct sensor_reg OV5642_1280x960_RAW[]  =
+inline constexpr struct sensor_reg OV5642_1280x960_RAW[]  =
 {
 {0x3103,0x93},
 {0x3008,0x02},
@@ -438,7 +442,7 @@ const struct sensor_reg OV5642_1280x960_RAW[]  =
 {0xffff,0xff},	
 };
 
-const struct sensor_reg OV5642_1920x1080_RAW[]  =
+inline constexpr struct sensor_reg OV5642_1920x1080_RAW[]  =
 {
 
 {0x3808,0x07},
@@ -448,7 +452,7 @@ const struct sensor_reg OV5642_1920x1080_RAW[]  =
 {0xffff,0xff},	
 };
 
-const struct sensor_reg OV5642_640x480_RAW[]  =
+inline constexpr struct sensor_reg OV5642_640x480_RAW[]  =
 {
 	/*
 {0x3800,0x03},
@@ -494,7 +498,7 @@ const struct sensor_reg OV5642_640x480_RAW[]  =
 
 
 
-const struct sensor_reg ov5642_320x240[]  =
+inline constexpr struct sensor_reg ov5642_320x240[]  =
 {
 	{0x3800 ,0x1 },
 	{0x3801 ,0xa8},
@@ -525,7 +529,7 @@ const struct sensor_reg ov5642_320x240[]  =
 	{0xffff, 0xff},
 };
 
-const struct sensor_reg ov5642_640x480[]  =
+inline constexpr struct sensor_reg ov5642_640x480[]  =
 {
 	{0x3800 ,0x1 },
 	{0x3801 ,0xa8},
@@ -556,7 +560,7 @@ const struct sensor_reg ov5642_640x480[]  =
 	{0xffff, 0xff},
 };
 
-const struct sensor_reg ov5642_1280x960[]  =
+inline constexpr struct sensor_reg ov5642_1280x960[]  =
 {
 	{0x3800 ,0x1 },
 	{0x3801 ,0xB0},
@@ -586,7 +590,7 @@ const struct sensor_reg ov5642_1280x960[]  =
 	{0xffff, 0xff},
 };
 
-const struct sensor_reg ov5642_1600x1200[]  =
+inline constexpr struct sensor_reg ov5642_1600x1200[]  =
 {
 	{0x3800 ,0x1 },
 	{0x3801 ,0xB0},
@@ -616,7 +620,7 @@ const struct sensor_reg ov5642_1600x1200[]  =
 	{0xffff, 0xff},
 };
 
-const struct sensor_reg ov5642_1024x768[]  =
+inline constexpr struct sensor_reg ov5642_1024x768[]  =
 {
 	{0x3800 ,0x1 },
 	{0x3801 ,0xB0},
@@ -649,7 +653,7 @@ const struct sensor_reg ov5642_1024x768[]  =
 
 
 
-const struct sensor_reg ov5642_2048x1536[]  =
+inline constexpr struct sensor_reg ov5642_2048x1536[]  =
 {
 	{0x3800 ,0x01},
 	{0x3801 ,0xb0},
@@ -713,7 +717,7 @@ const struct sensor_reg ov5642_2048x1536[]  =
 	{0xffff, 0xff},
 };
 
-const struct sensor_reg ov5642_2592x1944[]  =
+inline constexpr struct sensor_reg ov5642_2592x1944[]  =
 {
 	{0x3800 ,0x1 },
 	{0x3801 ,0xB0},
@@ -743,7 +747,7 @@ const struct sensor_reg ov5642_2592x1944[]  =
 	{0xffff, 0xff},
 };
 
-const struct sensor_reg ov5642_dvp_zoom8[] =
+inline constexpr struct sensor_reg ov5642_dvp_zoom8[] =
 {
 
 	{0x3800 ,0x5 },
@@ -784,7 +788,7 @@ const struct sensor_reg ov5642_dvp_zoom8[] =
 	{0xffff, 0xff},
 };
 
-const struct sensor_reg OV5642_QVGA_Preview[]  =
+inline constexpr struct sensor_reg OV5642_QVGA_Preview[]  =
 {
 	{0x3103 ,0x93},
 	{0x3008 ,0x82},
@@ -1382,7 +1386,7 @@ const struct sensor_reg OV5642_QVGA_Preview[]  =
 	{0xffff,0xff},
 };        
 
-const struct sensor_reg OV5642_JPEG_Capture_QSXGA[]  =
+inline constexpr struct sensor_reg OV5642_JPEG_Capture_QSXGA[]  =
 {
 	// OV5642_ QSXGA _YUV7.5 fps
 	// 24 MHz input clock, 24Mhz pclk
@@ -1467,7 +1471,7 @@ const struct sensor_reg OV5642_JPEG_Capture_QSXGA[]  =
 };
 
 
-const struct sensor_reg OV5642_1080P_Video_setting[]  = 
+inline constexpr struct sensor_reg OV5642_1080P_Video_setting[]  = 
 {
 	{0x3103 ,0x93},
 	{0x3008 ,0x82},
@@ -2020,7 +2024,7 @@ const struct sensor_reg OV5642_1080P_Video_setting[]  =
 	{0xffff, 0xff},
 };
 
-const struct sensor_reg OV5642_720P_Video_setting[]  = 
+inline constexpr struct sensor_reg OV5642_720P_Video_setting[]  = 
 {
 	{0x3103 ,0x93},
 	{0x3008 ,0x82},
@@ -2551,5 +2555,25 @@ const struct sensor_reg OV5642_720P_Video_setting[]  =
 	
 };
 
+// Tables applied by Camera are packed into register runs
+PACK_REGISTERS(OV5642_QVGA_Preview);
+PACK_REGISTERS(OV5642_JPEG_Capture_QSXGA);
+PACK_REGISTERS(ov5642_320x240);
+PACK_REGISTERS(ov5642_640x480);
+PACK_REGISTERS(ov5642_1024x768);
+PACK_REGISTERS(ov5642_1280x960);
+PACK_REGISTERS(ov5642_1600x1200);
+PACK_REGISTERS(ov5642_2048x1536);
+PACK_REGISTERS(ov5642_2592x1944);
+
+// The remaining tables are only checked
+CHECK_REGISTERS(ov5642_RAW);
+CHECK_REGISTERS(OV5642_1280x960_RAW);
+CHECK_REGISTERS(OV5642_1920x1080_RAW);
+CHECK_REGISTERS(OV5642_640x480_RAW);
+CHECK_REGISTERS(ov5642_dvp_zoom8);
+CHECK_REGISTERS(OV5642_1080P_Video_setting);
+CHECK_REGISTERS(OV5642_720P_Video_setting);
+
 #endif
 
@@ -0,0 +1,312 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "mjpg_streamer.h"
+#include "command_queue.h"
+
+/******************************************************************************
+Description.: cleanup handler that releases the queue mutex if a thread gets
+              cancelled while it waits for a command to complete
+Input Value.: arg is the mutex
+Return Value: -
+******************************************************************************/
+static void unlock_queue(void *arg)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)arg);
+}
+
+/******************************************************************************
+Description.: tells whether a later command may replace a queued one, that
+              is true for commands setting a value but not for relative moves
+              which add up
+Input Value.: * a is the queued command
+              * control_id and group identify the new command
+Return Value: 1 if the new command replaces a, 0 otherwise
+******************************************************************************/
+static int coalesces(input_command *a, unsigned int control_id, unsigned int group)
+{
+    if(a->control_id != control_id || a->group != group)
+        return 0;
+
+    if(group == IN_CMD_V4L2) {
+        switch(control_id) {
+        case V4L2_CID_PAN_RELATIVE:
+        case V4L2_CID_TILT_RELATIVE:
+        case V4L2_CID_FOCUS_RELATIVE:
+        case V4L2_CID_ZOOM_RELATIVE:
+            return 0;
+        }
+    }
+
+    return group == IN_CMD_V4L2 || group == IN_CMD_RESOLUTION || group == IN_CMD_JPEG_QUALITY;
+}
+
+/******************************************************************************
+Description.: worker thread of an input, runs the queued commands in order
+Input Value.: arg is the input plugin
+Return Value: -
+******************************************************************************/
+static void *command_thread(void *arg)
+{
+    input *in = arg;
+    command_queue *q = &in->commands;
+    input_command c;
+    unsigned long long start;
+    int res;
+
+    while(1) {
+        pthread_mutex_lock(&q->mutex);
+        while(q->count == 0)
+            pthread_cond_wait(&q->update, &q->mutex);
+
+        c = q->pending[q->head];
+        q->head = (q->head + 1) % COMMAND_QUEUE_LENGTH;
+        q->count--;
+        pthread_mutex_unlock(&q->mutex);
+
+        DBG("input %d: running command %u (group %u, value %d), ticket %llu\n",
+            in->param.id, c.control_id, c.group, c.value, c.ticket);
+
+        pthread_mutex_lock(&q->controls);
+        start = latency_now();
+        res = in->cmd(in->param.id, c.control_id, c.group, c.value, c.has_str ? c.value_str : NULL);
+        metric_observe(q->duration, latency_now() - start);
+        pthread_mutex_unlock(&q->controls);
+
+        pthread_mutex_lock(&q->mutex);
+        q->results[c.ticket % COMMAND_RESULTS].ticket = c.ticket;
+        q->results[c.ticket % COMMAND_RESULTS].result = res;
+        q->done = c.ticket;
+        q->version++;
+        pthread_cond_broadcast(&q->update);
+        pthread_mutex_unlock(&q->mutex);
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: prepares the command queue of an input and starts its worker,
+              called once the plugin is loaded
+Input Value.: * in is the input plugin, a worker is only started if the plugin
+                has an input_cmd() function
+              * id is the number of the input plugin
+Return Value: 0 if ok, -1 if the worker could not be started
+******************************************************************************/
+int command_queue_init(input *in, int id)
+{
+    command_queue *q = &in->commands;
+    char labels[32];
+
+    memset(q, 0, sizeof(*q));
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->update, NULL);
+    pthread_mutex_init(&q->controls, NULL);
+
+    snprintf(labels, sizeof(labels), "input=\"%d\"", id);
+    q->submitted = metric_counter("mjpg_commands_total", labels,
+                                  "Control commands queued for the input.");
+    q->coalesced = metric_counter("mjpg_commands_coalesced_total", labels,
+                                  "Control commands that replaced the value of a queued one.");
+    q->duration = metric_histogram("mjpg_command_microseconds", labels,
+                                   "Time the input plugin took to run a control command.");
+
+    if(in->cmd == NULL)
+        return 0;
+
+    if(pthread_create(&q->worker, NULL, command_thread, in) != 0)
+        return -1;
+    pthread_detach(q->worker);
+    q->running = 1;
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: queues a control command for an input
+Input Value.: * in is the input plugin
+              * control_id, group, value and value_str are passed on to the
+                input_cmd() function of the plugin, value_str may be NULL
+Return Value: ticket of the command, 0 if the input takes no commands or the
+              queue is full
+******************************************************************************/
+unsigned long long command_submit(input *in, unsigned int control_id, unsigned int group, int value, const char *value_str)
+{
+    command_queue *q = &in->commands;
+    input_command *c = NULL;
+    input_command *tail;
+    unsigned long long ticket = 0;
+
+    if(!q->running)
+        return 0;
+
+    pthread_mutex_lock(&q->mutex);
+
+    /* only the last queued command is replaced, replacing an older one
+       would run the new value before the commands queued in between */
+    if(q->count > 0) {
+        tail = &q->pending[(q->head + q->count - 1) % COMMAND_QUEUE_LENGTH];
+        if(coalesces(tail, control_id, group)) {
+            c = tail;
+            metric_inc(q->coalesced);
+        }
+    }
+
+    if(c == NULL && q->count < COMMAND_QUEUE_LENGTH) {
+        c = &q->pending[(q->head + q->count) % COMMAND_QUEUE_LENGTH];
+        c->ticket = ++q->queued;
+        c->control_id = control_id;
+        c->group = group;
+        q->count++;
+        pthread_cond_broadcast(&q->update);
+    }
+
+    if(c != NULL) {
+        c->value = value;
+        c->has_str = (value_str != NULL);
+        if(value_str != NULL)
+            snprintf(c->value_str, sizeof(c->value_str), "%s", value_str);
+        ticket = c->ticket;
+        metric_inc(q->submitted);
+    }
+
+    pthread_mutex_unlock(&q->mutex);
+
+    return ticket;
+}
+
+/******************************************************************************
+Description.: looks up whether a queued command completed
+Input Value.: * in is the input plugin
+              * ticket was returned by command_submit()
+              * result receives the return value of input_cmd() once done
+Return Value: COMMAND_DONE, COMMAND_PENDING or COMMAND_UNKNOWN if the ticket
+              was never handed out or its result was already overwritten
+******************************************************************************/
+int command_status(input *in, unsigned long long ticket, int *result)
+{
+    command_queue *q = &in->commands;
+    int status = COMMAND_UNKNOWN;
+
+    pthread_mutex_lock(&q->mutex);
+    if(ticket == 0 || ticket > q->queued) {
+        status = COMMAND_UNKNOWN;
+    } else if(ticket > q->done) {
+        status = COMMAND_PENDING;
+    } else if(q->results[ticket % COMMAND_RESULTS].ticket == ticket) {
+        *result = q->results[ticket % COMMAND_RESULTS].result;
+        status = COMMAND_DONE;
+    }
+    pthread_mutex_unlock(&q->mutex);
+
+    return status;
+}
+
+/******************************************************************************
+Description.: waits until a queued command completed
+Input Value.: * in is the input plugin
+              * ticket was returned by command_submit()
+              * result receives the return value of input_cmd()
+Return Value: COMMAND_DONE or COMMAND_UNKNOWN, see command_status()
+******************************************************************************/
+int command_wait(input *in, unsigned long long ticket, int *result)
+{
+    command_queue *q = &in->commands;
+    int status;
+
+    pthread_mutex_lock(&q->mutex);
+    while(ticket != 0 && ticket <= q->queued && ticket > q->done)
+        pthread_cond_wait(&q->update, &q->mutex);
+    pthread_mutex_unlock(&q->mutex);
+
+    status = command_status(in, ticket, result);
+
+    return status == COMMAND_PENDING ? COMMAND_UNKNOWN : status;
+}
+
+/******************************************************************************
+Description.: tells how many commands the input ran so far
+Input Value.: in is the input plugin
+Return Value: the version of its controls
+******************************************************************************/
+unsigned long long command_version(input *in)
+{
+    command_queue *q = &in->commands;
+    unsigned long long version;
+
+    pthread_mutex_lock(&q->mutex);
+    version = q->version;
+    pthread_mutex_unlock(&q->mutex);
+
+    return version;
+}
+
+/******************************************************************************
+Description.: waits until the input ran another command, the wait may be
+              cancelled
+Input Value.: * in is the input plugin
+              * version was returned by command_version() or this function
+Return Value: the new version
+******************************************************************************/
+unsigned long long command_wait_version(input *in, unsigned long long version)
+{
+    command_queue *q = &in->commands;
+
+    pthread_mutex_lock(&q->mutex);
+    pthread_cleanup_push(unlock_queue, &q->mutex);
+
+    while(q->version == version)
+        pthread_cond_wait(&q->update, &q->mutex);
+    version = q->version;
+
+    pthread_cleanup_pop(1);
+
+    return version;
+}
+
+/******************************************************************************
+Description.: waits for the command that runs to complete and keeps further
+              commands from running until command_unlock()
+Input Value.: in is the input plugin
+Return Value: -
+******************************************************************************/
+void command_lock(input *in)
+{
+    pthread_mutex_lock(&in->commands.controls);
+}
+
+/******************************************************************************
+Description.: lets the commands of an input run again
+Input Value.: in is the input plugin
+Return Value: -
+******************************************************************************/
+void command_unlock(input *in)
+{
+    pthread_mutex_unlock(&in->commands.controls);
+}
@@ -0,0 +1,117 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <pthread.h>
+
+#include "metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Control commands for an input are not run on the thread that received
+ * them. They are queued and a worker thread per input hands them to the
+ * input_cmd() function of the plugin one after the other, so a slow sensor
+ * only delays the worker and not the HTTP client.
+ *
+ * A command that sets the same control as the last one still waiting in the
+ * queue replaces its value instead of being queued again, both share the
+ * ticket of the queued command. Tickets are numbered from 1 in the order commands
+ * are queued and completed in that order.
+ *
+ * The version of the queue counts the commands that ran, readers of the
+ * controls of the input learn from it that a value may have changed.
+ *
+ * command_lock() holds the controls of the input still: no command runs and
+ * the plugin may replace what its controls point to until command_unlock().
+ * The watchdog holds it while it restarts the input, readers of the controls
+ * of the input take it as well.
+ */
+#define COMMAND_QUEUE_LENGTH 32
+#define COMMAND_RESULTS      64     /* results kept for polling */
+#define COMMAND_VALUE_MAX    256
+
+/* return values of command_status() */
+#define COMMAND_DONE     0
+#define COMMAND_PENDING  1
+#define COMMAND_UNKNOWN  (-1)
+
+typedef struct _input_command input_command;
+struct _input_command {
+    unsigned long long ticket;
+    unsigned int control_id;
+    unsigned int group;
+    int value;
+    char value_str[COMMAND_VALUE_MAX];
+    int has_str;
+};
+
+typedef struct _command_result command_result;
+struct _command_result {
+    unsigned long long ticket;
+    int result;
+};
+
+typedef struct _command_queue command_queue;
+struct _command_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t update;      /* a command was queued or completed */
+    pthread_mutex_t controls;   /* held while a command runs, see command_lock() */
+
+    input_command pending[COMMAND_QUEUE_LENGTH];
+    int head;
+    int count;
+
+    unsigned long long queued;  /* ticket of the last queued command */
+    unsigned long long done;    /* ticket of the last completed command */
+    command_result results[COMMAND_RESULTS];
+    unsigned long long version; /* commands that ran */
+
+    pthread_t worker;
+    int running;
+
+    /* registered by command_queue_init() */
+    metric *submitted;
+    metric *coalesced;
+    metric *duration;
+};
+
+struct _input;
+
+int command_queue_init(struct _input *in, int id);
+unsigned long long command_submit(struct _input *in, unsigned int control_id, unsigned int group, int value, const char *value_str);
+int command_status(struct _input *in, unsigned long long ticket, int *result);
+int command_wait(struct _input *in, unsigned long long ticket, int *result);
+unsigned long long command_version(struct _input *in);
+unsigned long long command_wait_version(struct _input *in, unsigned long long version);
+void command_lock(struct _input *in);
+void command_unlock(struct _input *in);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mjpg_streamer.h"
+#include "command_queue.h"
+
+static int failed = 0;
+
+#define CHECK(cond) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failed++; \
+        } \
+    } while(0)
+
+/* commands the fake input ran, in order */
+static struct {
+    unsigned int control_id;
+    int value;
+    char value_str[COMMAND_VALUE_MAX];
+} ran[COMMAND_QUEUE_LENGTH];
+static int runs = 0;
+
+/******************************************************************************
+Description.: input_cmd() of a fake input, records the command
+Input Value.: see input_cmd()
+Return Value: ten times the value
+******************************************************************************/
+static int fake_cmd(int plugin, unsigned int control_id, unsigned int group, int value, char *value_str)
+{
+    ran[runs].control_id = control_id;
+    ran[runs].value = value;
+    snprintf(ran[runs].value_str, sizeof(ran[runs].value_str), "%s", value_str != NULL ? value_str : "");
+    runs++;
+
+    return value * 10;
+}
+
+/******************************************************************************
+Description.: waits until the worker took every queued command
+Input Value.: in is the input
+Return Value: -
+******************************************************************************/
+static void wait_taken(input *in)
+{
+    int count;
+
+    do {
+        usleep(1000);
+        pthread_mutex_lock(&in->commands.mutex);
+        count = in->commands.count;
+        pthread_mutex_unlock(&in->commands.mutex);
+    } while(count > 0);
+}
+
+int main(void)
+{
+    static input in, mute;
+    unsigned long long t[8];
+    int result;
+
+    /* an input without input_cmd() takes no commands */
+    CHECK(command_queue_init(&mute, 1) == 0);
+    CHECK(command_submit(&mute, V4L2_CID_BRIGHTNESS, IN_CMD_V4L2, 1, NULL) == 0);
+
+    in.cmd = fake_cmd;
+    CHECK(command_queue_init(&in, 0) == 0);
+    CHECK(command_version(&in) == 0);
+
+    /* while the controls are locked the worker takes the first command
+       but does not run it, the others stay queued */
+    command_lock(&in);
+    t[0] = command_submit(&in, V4L2_CID_CONTRAST, IN_CMD_V4L2, 1, NULL);
+    wait_taken(&in);
+
+    t[1] = command_submit(&in, V4L2_CID_BRIGHTNESS, IN_CMD_V4L2, 2, NULL);
+    t[2] = command_submit(&in, V4L2_CID_BRIGHTNESS, IN_CMD_V4L2, 3, NULL);
+    t[3] = command_submit(&in, V4L2_CID_CONTRAST, IN_CMD_V4L2, 4, NULL);
+    t[4] = command_submit(&in, V4L2_CID_BRIGHTNESS, IN_CMD_V4L2, 5, "five");
+    t[5] = command_submit(&in, V4L2_CID_PAN_RELATIVE, IN_CMD_V4L2, 6, NULL);
+    t[6] = command_submit(&in, V4L2_CID_PAN_RELATIVE, IN_CMD_V4L2, 6, NULL);
+
+    /* tickets count up, the last queued command of the same control is
+       replaced, relative moves and older commands are not */
+    CHECK(t[0] == 1 && t[1] == 2 && t[2] == 2 && t[3] == 3);
+    CHECK(t[4] == 4 && t[5] == 5 && t[6] == 6);
+
+    usleep(10000);
+    CHECK(runs == 0 && command_version(&in) == 0);
+    CHECK(command_status(&in, t[0], &result) == COMMAND_PENDING);
+    CHECK(command_status(&in, 0, &result) == COMMAND_UNKNOWN);
+    CHECK(command_status(&in, 7, &result) == COMMAND_UNKNOWN);
+    command_unlock(&in);
+
+    /* commands complete in the order of their tickets */
+    CHECK(command_wait(&in, t[6], &result) == COMMAND_DONE && result == 60);
+    CHECK(command_status(&in, t[0], &result) == COMMAND_DONE && result == 10);
+    CHECK(command_status(&in, t[2], &result) == COMMAND_DONE && result == 30);
+    CHECK(command_version(&in) == 6);
+    CHECK(command_wait_version(&in, 5) == 6);
+
+    CHECK(runs == 6);
+    CHECK(ran[0].control_id == V4L2_CID_CONTRAST && ran[0].value == 1);
+    CHECK(ran[1].control_id == V4L2_CID_BRIGHTNESS && ran[1].value == 3);
+    CHECK(ran[2].control_id == V4L2_CID_CONTRAST && ran[2].value == 4);
+    CHECK(ran[3].value == 5 && strcmp(ran[3].value_str, "five") == 0);
+    CHECK(ran[4].control_id == V4L2_CID_PAN_RELATIVE && ran[5].control_id == V4L2_CID_PAN_RELATIVE);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <pthread.h>
+
+#include "mjpg_streamer.h"
+#include "frame_consumer.h"
+
+static const char *policy_names[] = {
+    "latest",
+    "every",
+    "fps"
+};
+
+/******************************************************************************
+Description.: parses the value of a --policy option
+Input Value.: * arg is "latest", "every[:queue length]" or "fps:rate"
+              * policy receives the policy
+              * param receives the queue length or the rate
+Return Value: 0 if the value is valid, -1 otherwise
+******************************************************************************/
+int consumer_parse_policy(const char *arg, consumer_policy *policy, int *param)
+{
+    if(strcmp(arg, "latest") == 0) {
+        *policy = CONSUME_LATEST;
+        *param = 0;
+    } else if(strcmp(arg, "every") == 0) {
+        *policy = CONSUME_EVERY;
+        *param = CONSUMER_QUEUE_MAX;
+    } else if(strncmp(arg, "every:", 6) == 0) {
+        *policy = CONSUME_EVERY;
+        *param = atoi(arg + 6);
+        if(*param < 1 || *param > CONSUMER_QUEUE_MAX)
+            return -1;
+    } else if(strncmp(arg, "fps:", 4) == 0) {
+        *policy = CONSUME_FPS;
+        *param = atoi(arg + 4);
+        if(*param < 1)
+            return -1;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: names a policy for messages
+Input Value.: policy
+Return Value: the name
+******************************************************************************/
+const char *consumer_policy_name(consumer_policy policy)
+{
+    return policy_names[policy];
+}
+
+/******************************************************************************
+Description.: attaches a consumer to an input, output plugins call this from
+              their worker thread before the first frame is read
+Input Value.: * c is the consumer to set up
+              * in is the input plugin to read from
+              * policy selects how frames are taken
+              * param is the queue length for CONSUME_EVERY and the rate for
+                CONSUME_FPS, otherwise ignored
+Return Value: 0 if ok, -1 if param is out of range
+******************************************************************************/
+int consumer_init(frame_consumer *c, input *in, consumer_policy policy, int param)
+{
+    char labels[32];
+
+    memset(c, 0, sizeof(*c));
+    c->in = in;
+    c->policy = policy;
+
+    snprintf(labels, sizeof(labels), "input=\"%d\"", in->param.id);
+    c->dropped_total = metric_counter("mjpg_consumer_frames_dropped_total", labels,
+                                      "Frames output plugins lost because they were too slow.");
+    c->lag_us = metric_histogram("mjpg_consumer_lag_microseconds", labels,
+                                 "Time from publishing a frame to an output plugin taking it.");
+
+    if(policy == CONSUME_EVERY) {
+        if(param < 1 || param > CONSUMER_QUEUE_MAX)
+            return -1;
+        c->queue_length = param;
+    } else if(policy == CONSUME_FPS) {
+        if(param < 1)
+            return -1;
+        c->fps = param;
+    }
+
+    frame_lock(in);
+    c->next = in->ring.consumers;
+    in->ring.consumers = c;
+    pthread_mutex_unlock(&in->db);
+
+    frame_interest_add(in, &c->interest, policy == CONSUME_FPS ? c->fps : DEMAND_ALL);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: drops the oldest frame queued for a consumer
+Input Value.: c is a CONSUME_EVERY consumer with a frame queued, the db mutex
+              of its input is held
+Return Value: -
+******************************************************************************/
+static void drop_oldest(frame_consumer *c)
+{
+    frame_release(c->queue[c->head]);
+    c->head = (c->head + 1) % CONSUMER_QUEUE_MAX;
+    c->queued--;
+    c->in->ring.queued--;
+    c->dropped++;
+    metric_inc(c->dropped_total);
+}
+
+/******************************************************************************
+Description.: hands a freshly published frame to every CONSUME_EVERY consumer
+              of the input. A full queue loses its oldest frame. Once the
+              queues together hold CONSUMER_QUEUE_MAX frames, the longest
+              one loses its oldest frame, so several consumers never pin
+              the whole ring and only the slowest one misses frames.
+Input Value.: * in is the input plugin, its db mutex is held
+              * slot is the published frame
+Return Value: -
+******************************************************************************/
+void consumer_enqueue(input *in, frame_slot *slot)
+{
+    frame_consumer *c, *o, *longest;
+
+    for(c = in->ring.consumers; c != NULL; c = c->next) {
+        if(c->policy != CONSUME_EVERY)
+            continue;
+
+        if(c->queued == c->queue_length) {
+            drop_oldest(c);
+        } else if(in->ring.queued >= CONSUMER_QUEUE_MAX) {
+            longest = c;
+            for(o = in->ring.consumers; o != NULL; o = o->next) {
+                if(o->policy == CONSUME_EVERY && o->queued > longest->queued)
+                    longest = o;
+            }
+            drop_oldest(longest);
+        }
+
+        slot->refs++;
+        c->queue[(c->head + c->queued) % CONSUMER_QUEUE_MAX] = slot;
+        c->queued++;
+        in->ring.queued++;
+    }
+}
+
+/******************************************************************************
+Description.: waits for the next frame according to the policy and pins it,
+              for plugins that need to copy the frame somewhere themselves
+Input Value.: c is the consumer
+Return Value: the referenced slot, hand it back with consumer_release()
+******************************************************************************/
+frame_slot *consumer_acquire(frame_consumer *c)
+{
+    frame_slot *slot;
+    unsigned long long now;
+
+    if(c->policy == CONSUME_EVERY) {
+        frame_lock(c->in);
+        pthread_cleanup_push(frame_unlock_db, &c->in->db);
+
+        while(c->queued == 0)
+            pthread_cond_wait(&c->in->db_update, &c->in->db);
+
+        slot = c->queue[c->head];
+        c->head = (c->head + 1) % CONSUMER_QUEUE_MAX;
+        c->queued--;
+        c->in->ring.queued--;
+
+        pthread_cleanup_pop(1);
+    } else {
+        if(c->policy == CONSUME_FPS) {
+            now = latency_now();
+            if(c->next_due > now) {
+                usleep(c->next_due - now);
+                now = c->next_due;
+            }
+            c->next_due = now + 1000000ULL / c->fps;
+        }
+
+        slot = wait_for_frame(c->in, c->seq, -1);
+
+        if(c->policy == CONSUME_FPS)
+            c->skipped += FRAMES_MISSED(c->seq, slot->seq);
+        else {
+            c->dropped += FRAMES_MISSED(c->seq, slot->seq);
+            metric_add(c->dropped_total, FRAMES_MISSED(c->seq, slot->seq));
+        }
+    }
+
+    c->seq = slot->seq;
+    if(slot->trace.published) {
+        c->lag = latency_now() - slot->trace.published;
+        if(c->lag > c->max_lag)
+            c->max_lag = c->lag;
+        metric_observe(c->lag_us, c->lag);
+    }
+    c->frames++;
+
+    return slot;
+}
+
+/******************************************************************************
+Description.: unpins a frame returned by consumer_acquire()
+Input Value.: * c is the consumer
+              * slot is the frame
+Return Value: -
+******************************************************************************/
+void consumer_release(frame_consumer *c, frame_slot *slot)
+{
+    frame_unref(c->in, slot);
+}
+
+/******************************************************************************
+Description.: waits for the next frame according to the policy and copies it
+              into the buffer of the consumer
+Input Value.: c is the consumer
+Return Value: 0 if buf holds the next frame, -1 if there was not enough memory
+******************************************************************************/
+int consumer_next(frame_consumer *c)
+{
+    frame_slot *slot = consumer_acquire(c);
+    unsigned char *tmp;
+
+    /* grow the private buffer, it is never smaller than the frame */
+    if((size_t)slot->size > c->capacity) {
+        DBG("increasing buffer size to %d\n", slot->size);
+
+        if((tmp = realloc(c->buf, slot->size + (1 << 16))) == NULL) {
+            consumer_release(c, slot);
+            return -1;
+        }
+        c->buf = tmp;
+        c->capacity = slot->size + (1 << 16);
+    }
+
+    memcpy(c->buf, slot->buf, slot->size);
+    c->size = slot->size;
+    c->timestamp = slot->timestamp;
+    c->trace = slot->trace;
+    c->hash = slot->hash;
+    c->duplicate = slot->duplicate;
+
+    consumer_release(c, slot);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: detaches a consumer from its input and releases its resources,
+              output plugins call this from their cleanup function
+Input Value.: c is the consumer
+Return Value: -
+******************************************************************************/
+void consumer_free(frame_consumer *c)
+{
+    frame_consumer **p;
+
+    if(c->in == NULL)
+        return;
+
+    LOG("consumer of input %d (%s): %llu frames, %llu dropped, %llu skipped, lag %llu us, max %llu us\n",
+        c->in->param.id, consumer_policy_name(c->policy),
+        c->frames, c->dropped, c->skipped, c->lag, c->max_lag);
+
+    frame_lock(c->in);
+    for(p = &c->in->ring.consumers; *p != NULL; p = &(*p)->next) {
+        if(*p == c) {
+            *p = c->next;
+            break;
+        }
+    }
+
+    while(c->queued > 0) {
+        frame_release(c->queue[c->head]);
+        c->head = (c->head + 1) % CONSUMER_QUEUE_MAX;
+        c->queued--;
+        c->in->ring.queued--;
+    }
+    pthread_mutex_unlock(&c->in->db);
+
+    frame_interest_remove(c->in, &c->interest);
+
+    free(c->buf);
+    c->buf = NULL;
+    c->in = NULL;
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef FRAME_CONSUMER_H
+#define FRAME_CONSUMER_H
+
+#include <stddef.h>
+#include <sys/time.h>
+
+#include "latency.h"
+#include "frame_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Output plugins read the frames of an input through a consumer. It waits
+ * for the next frame according to its policy, copies it into a private
+ * buffer that grows with the frames and keeps statistics on how far the
+ * plugin lags behind the input. Plugins that keep frames in their own
+ * buffers pin the frame with consumer_acquire() and copy it themselves.
+ */
+typedef enum {
+    CONSUME_LATEST = 0, /* skip to the newest frame whenever the plugin is ready */
+    CONSUME_EVERY,      /* queue frames, drop the oldest one if the queue is full */
+    CONSUME_FPS         /* take the newest frame at a fixed rate */
+} consumer_policy;
+
+/*
+ * queued frames stay referenced, so this has to leave room in the ring, it
+ * bounds the queue of one consumer and the queues of all consumers of an
+ * input together
+ */
+#define CONSUMER_QUEUE_MAX (FRAME_RING_SLOTS / 2)
+
+typedef struct _frame_consumer frame_consumer;
+struct _frame_consumer {
+    struct _input *in;
+    consumer_policy policy;
+    int queue_length;               /* CONSUME_EVERY */
+    int fps;                        /* CONSUME_FPS */
+
+    /* the current frame, owned by the consumer */
+    unsigned char *buf;
+    int size;
+    size_t capacity;
+    struct timeval timestamp;
+    frame_trace trace;
+    unsigned long long seq;
+    unsigned long long hash;        /* see frame_slot */
+    int duplicate;
+
+    /* statistics */
+    unsigned long long frames;      /* frames handed to the plugin */
+    unsigned long long dropped;     /* frames lost because the plugin was too slow */
+    unsigned long long skipped;     /* frames left out on purpose by CONSUME_FPS */
+    unsigned long long lag;         /* publish to copy of the last frame in us */
+    unsigned long long max_lag;
+
+    /* the same statistics in the metrics registry, shared per input */
+    metric *dropped_total;
+    metric *lag_us;
+
+    /* frames waiting for a CONSUME_EVERY consumer, protected by db */
+    frame_slot *queue[CONSUMER_QUEUE_MAX];
+    int head, queued;
+
+    unsigned long long next_due;    /* CONSUME_FPS, monotonic us */
+
+    frame_consumer *next;           /* consumers of the same input */
+
+    frame_interest interest;        /* keeps the input capturing */
+};
+
+int consumer_parse_policy(const char *arg, consumer_policy *policy, int *param);
+const char *consumer_policy_name(consumer_policy policy);
+
+int consumer_init(frame_consumer *c, struct _input *in, consumer_policy policy, int param);
+int consumer_next(frame_consumer *c);
+frame_slot *consumer_acquire(frame_consumer *c);
+void consumer_release(frame_consumer *c, frame_slot *slot);
+void consumer_free(frame_consumer *c);
+
+/* called by frame_publish() with the db mutex held */
+void consumer_enqueue(struct _input *in, frame_slot *slot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,505 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "mjpg_streamer.h"
+#include "frame_ring.h"
+#include "frame_consumer.h"
+
+/******************************************************************************
+Description.: cleanup handler that releases the db mutex if a consumer thread
+              gets cancelled while it waits for a frame
+Input Value.: arg is the mutex
+Return Value: -
+******************************************************************************/
+void frame_unlock_db(void *arg)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)arg);
+}
+
+/******************************************************************************
+Description.: hashes the data of a frame, eight bytes at a time, so outputs
+              can tell unchanged frames apart without comparing them
+Input Value.: * buf is the frame
+              * size is its length in bytes
+Return Value: the hash
+******************************************************************************/
+static unsigned long long frame_hash(const unsigned char *buf, int size)
+{
+    unsigned long long h = 0x9e3779b97f4a7c15ULL ^ (unsigned long long)size;
+    unsigned long long w;
+    int i;
+
+    for(i = 0; i + 8 <= size; i += 8) {
+        memcpy(&w, buf + i, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+
+    for(w = 0; i < size; i++)
+        w = (w << 8) | buf[i];
+    h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+
+    return h ^ (h >> 29);
+}
+
+/******************************************************************************
+Description.: prepares the empty ring of an input, called before the plugin
+              is initialized
+Input Value.: * in is the input plugin
+              * id is the number of the input plugin
+Return Value: -
+******************************************************************************/
+void frame_ring_init(input *in, int id)
+{
+    char labels[32];
+
+    memset(&in->ring, 0, sizeof(in->ring));
+    in->ring.demand = DEMAND_NONE;
+
+    snprintf(labels, sizeof(labels), "input=\"%d\"", id);
+    in->ring.published = metric_counter("mjpg_frames_published_total", labels,
+                                        "Frames handed to the output plugins.");
+    in->ring.frame_bytes = metric_gauge("mjpg_frame_bytes", labels,
+                                        "Size of the latest frame.");
+    in->ring.db_wait = metric_histogram("mjpg_db_wait_microseconds", labels,
+                                        "Time spent waiting for the db mutex of the input.");
+    in->ring.restarts = metric_counter("mjpg_input_restarts_total", labels,
+                                       "Restarts of a stalled input by the watchdog.");
+    in->ring.duplicates = metric_counter("mjpg_frames_duplicate_total", labels,
+                                         "Published frames with the same data as the previous one.");
+
+    snprintf(labels, sizeof(labels), "input=\"%d\",reason=\"ring_full\"", id);
+    in->ring.dropped = metric_counter("mjpg_frames_dropped_total", labels,
+                                      "Frames the input could not publish.");
+}
+
+/******************************************************************************
+Description.: locks the db mutex of an input and records how long that took
+Input Value.: in is the input plugin
+Return Value: -
+******************************************************************************/
+void frame_lock(input *in)
+{
+    unsigned long long start;
+
+    if(pthread_mutex_trylock(&in->db) == 0) {
+        metric_observe(in->ring.db_wait, 0);
+        return;
+    }
+
+    start = latency_now();
+    pthread_mutex_lock(&in->db);
+    metric_observe(in->ring.db_wait, latency_now() - start);
+}
+
+/******************************************************************************
+Description.: drops a reference to a slot, the caller holds the db mutex.
+              The last reference to an orphaned slot releases its memory.
+Input Value.: slot is the referenced slot
+Return Value: -
+******************************************************************************/
+void frame_release(frame_slot *slot)
+{
+    if(--slot->refs > 0 || !slot->orphan)
+        return;
+
+    free(slot->buf);
+    slot->buf = NULL;
+    slot->capacity = 0;
+    slot->size = 0;
+    slot->orphan = 0;
+}
+
+/******************************************************************************
+Description.: releases the memory of all slots, the plugin calls this from
+              its cleanup once no frames are produced anymore. Slots that
+              consumers still read are only marked, the last frame_unref()
+              releases them. While the watchdog may restart the input the
+              frames are kept, whether the thread was stopped or left its
+              loop on an error, and outputs keep serving the last one.
+Input Value.: in is the input plugin
+Return Value: -
+******************************************************************************/
+void frame_ring_free(input *in)
+{
+    frame_slot *slot;
+    int i;
+
+    frame_lock(in);
+
+    /* a frame the cancelled producer was filling is never published */
+    if(in->ring.reserved != NULL) {
+        frame_release(in->ring.reserved);
+        in->ring.reserved = NULL;
+    }
+
+    if(!__atomic_load_n(&in->ring.watched, __ATOMIC_ACQUIRE)) {
+        if(in->ring.latest != NULL) {
+            frame_release(in->ring.latest);
+            in->ring.latest = NULL;
+        }
+
+        for(i = 0; i < FRAME_RING_SLOTS; i++) {
+            slot = &in->ring.slot[i];
+            if(slot->refs > 0) {
+                slot->orphan = 1;
+                continue;
+            }
+            free(slot->buf);
+            slot->buf = NULL;
+            slot->capacity = 0;
+            slot->size = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&in->db);
+
+    __atomic_store_n(&in->ring.stopped, 1, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************
+Description.: hands an unreferenced slot to the producer
+Input Value.: * in is the input plugin
+              * size is the largest frame the producer is going to write
+Return Value: the slot, or NULL if every slot is still in use and the frame
+              has to be dropped
+******************************************************************************/
+frame_slot *frame_reserve(input *in, size_t size)
+{
+    frame_slot *slot = NULL;
+    unsigned char *tmp;
+    int i;
+
+    frame_lock(in);
+    for(i = 0; i < FRAME_RING_SLOTS; i++) {
+        if(in->ring.slot[i].refs == 0) {
+            slot = &in->ring.slot[i];
+            slot->refs = 1;
+            in->ring.reserved = slot;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&in->db);
+
+    if(slot == NULL) {
+        DBG("all %d frame slots are in use\n", FRAME_RING_SLOTS);
+        metric_inc(in->ring.dropped);
+        return NULL;
+    }
+
+    /* nobody else references the slot, so it can grow without the lock */
+    if(slot->capacity < size) {
+        if((tmp = realloc(slot->buf, size)) == NULL) {
+            frame_cancel(in, slot);
+            return NULL;
+        }
+        slot->buf = tmp;
+        slot->capacity = size;
+    }
+
+    slot->size = 0;
+    memset(&slot->timestamp, 0, sizeof(slot->timestamp));
+    memset(&slot->trace, 0, sizeof(slot->trace));
+
+    return slot;
+}
+
+/******************************************************************************
+Description.: makes a filled slot the latest frame and wakes up the consumers,
+              the reference of the producer passes to the ring
+Input Value.: * in is the input plugin
+              * slot was returned by frame_reserve()
+Return Value: -
+******************************************************************************/
+void frame_publish(input *in, frame_slot *slot)
+{
+    /* the producer holds the only reference, hash without the lock */
+    slot->hash = frame_hash(slot->buf, slot->size);
+
+    frame_lock(in);
+
+    slot->duplicate = (in->ring.latest != NULL &&
+                       FRAME_SAME(slot->hash, slot->size, in->ring.latest->hash, in->ring.latest->size));
+    if(slot->duplicate)
+        metric_inc(in->ring.duplicates);
+
+    if(in->ring.latest != NULL)
+        frame_release(in->ring.latest);
+    in->ring.latest = slot;
+    in->ring.reserved = NULL;
+    slot->seq = ++in->ring.seq;
+    __atomic_store_n(&in->ring.last_frame, latency_now(), __ATOMIC_RELAXED);
+
+    latency_publish(&slot->trace, in->param.id);
+    consumer_enqueue(in, slot);
+
+    metric_inc(in->ring.published);
+    metric_set(in->ring.frame_bytes, slot->size);
+
+    /* signal fresh_frame */
+    pthread_cond_broadcast(&in->db_update);
+    pthread_mutex_unlock(&in->db);
+}
+
+/******************************************************************************
+Description.: returns a reserved slot without publishing it
+Input Value.: * in is the input plugin
+              * slot was returned by frame_reserve()
+Return Value: -
+******************************************************************************/
+void frame_cancel(input *in, frame_slot *slot)
+{
+    frame_lock(in);
+    if(in->ring.reserved == slot)
+        in->ring.reserved = NULL;
+    frame_release(slot);
+    pthread_mutex_unlock(&in->db);
+}
+
+/******************************************************************************
+Description.: takes a reference to the latest frame, the caller must hold the
+              db mutex, e.g. right after waiting for db_update
+Input Value.: in is the input plugin
+Return Value: the slot, or NULL if nothing was published yet
+******************************************************************************/
+frame_slot *frame_ref_latest(input *in)
+{
+    frame_slot *slot = in->ring.latest;
+
+    if(slot != NULL)
+        slot->refs++;
+
+    return slot;
+}
+
+/******************************************************************************
+Description.: waits until a frame newer than last_seq was published and takes
+              a reference to the latest frame. Unlike a bare wait on db_update
+              this returns at once if the consumer already missed a frame and
+              is not fooled by spurious wakeups.
+Input Value.: * in is the input plugin
+              * last_seq is the sequence number of the last frame the consumer
+                got, 0 returns the current frame if there is one
+              * timeout in milliseconds, a negative value waits forever
+Return Value: the referenced slot, or NULL on timeout
+******************************************************************************/
+frame_slot *wait_for_frame(input *in, unsigned long long last_seq, int timeout)
+{
+    frame_slot *slot = NULL;
+    struct timespec deadline;
+
+    if(timeout >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000000L;
+        if(deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    frame_lock(in);
+    pthread_cleanup_push(frame_unlock_db, &in->db);
+
+    while(in->ring.seq <= last_seq || in->ring.latest == NULL) {
+        if(timeout < 0) {
+            pthread_cond_wait(&in->db_update, &in->db);
+        } else if(pthread_cond_timedwait(&in->db_update, &in->db, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    if(in->ring.seq > last_seq)
+        slot = frame_ref_latest(in);
+
+    pthread_cleanup_pop(1);
+
+    return slot;
+}
+
+/******************************************************************************
+Description.: returns the sequence number of the latest frame
+Input Value.: in is the input plugin
+Return Value: the sequence number, 0 if nothing was published yet
+******************************************************************************/
+unsigned long long frame_seq(input *in)
+{
+    unsigned long long seq;
+
+    frame_lock(in);
+    seq = in->ring.seq;
+    pthread_mutex_unlock(&in->db);
+
+    return seq;
+}
+
+/******************************************************************************
+Description.: drops a reference taken with frame_ref_latest()
+Input Value.: * in is the input plugin
+              * slot is the referenced slot
+Return Value: -
+******************************************************************************/
+void frame_unref(input *in, frame_slot *slot)
+{
+    frame_lock(in);
+    frame_release(slot);
+    pthread_mutex_unlock(&in->db);
+}
+
+/******************************************************************************
+Description.: recomputes the combined demand of all interests of an input
+Input Value.: in is the input plugin, its db mutex is held
+Return Value: -
+******************************************************************************/
+static void update_demand(input *in)
+{
+    frame_interest *i;
+    int demand = DEMAND_NONE;
+
+    for(i = in->ring.interests; i != NULL; i = i->next) {
+        if(i->fps == DEMAND_ALL) {
+            demand = DEMAND_ALL;
+            break;
+        }
+        if(i->fps > demand)
+            demand = i->fps;
+    }
+
+    __atomic_store_n(&in->ring.demand, demand, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+Description.: declares that an output needs frames from now on, an idle input
+              is woken up
+Input Value.: * in is the input plugin
+              * interest is owned by the caller until frame_interest_remove()
+              * fps is the rate the output needs or DEMAND_ALL
+Return Value: the demand before, DEMAND_NONE if the input may be idle and
+              its latest frame old
+******************************************************************************/
+int frame_interest_add(input *in, frame_interest *interest, int fps)
+{
+    int before;
+
+    interest->fps = fps;
+
+    frame_lock(in);
+    before = in->ring.demand;
+    interest->next = in->ring.interests;
+    in->ring.interests = interest;
+    update_demand(in);
+
+    /* inputs wait for demand on the same condition as outputs for frames */
+    if(before == DEMAND_NONE)
+        pthread_cond_broadcast(&in->db_update);
+    pthread_mutex_unlock(&in->db);
+
+    return before;
+}
+
+/******************************************************************************
+Description.: withdraws an interest added with frame_interest_add()
+Input Value.: * in is the input plugin
+              * interest to remove
+Return Value: -
+******************************************************************************/
+void frame_interest_remove(input *in, frame_interest *interest)
+{
+    frame_interest **p;
+
+    frame_lock(in);
+    for(p = &in->ring.interests; *p != NULL; p = &(*p)->next) {
+        if(*p == interest) {
+            *p = interest->next;
+            break;
+        }
+    }
+    update_demand(in);
+    pthread_mutex_unlock(&in->db);
+}
+
+/******************************************************************************
+Description.: returns the combined demand of the outputs without locking
+Input Value.: in is the input plugin
+Return Value: DEMAND_NONE, DEMAND_ALL or the highest rate asked for
+******************************************************************************/
+int frame_demand(input *in)
+{
+    return __atomic_load_n(&in->ring.demand, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+Description.: blocks an input while no output needs frames
+Input Value.: in is the input plugin
+Return Value: the demand that ended the wait
+******************************************************************************/
+int frame_wait_demand(input *in)
+{
+    int demand;
+
+    frame_lock(in);
+    pthread_cleanup_push(frame_unlock_db, &in->db);
+
+    while(in->ring.demand == DEMAND_NONE)
+        pthread_cond_wait(&in->db_update, &in->db);
+    demand = in->ring.demand;
+
+    pthread_cleanup_pop(1);
+
+    return demand;
+}
+
+/******************************************************************************
+Description.: decides whether a frame captured now is needed, inputs call it
+              before they spend time on encoding or copying the frame
+Input Value.: * in is the input plugin
+              * next_due keeps the time the next frame is due, in us from
+                latency_now(), start with 0
+Return Value: 1 if the frame should be published, 0 to drop it
+******************************************************************************/
+int frame_wanted(input *in, unsigned long long *next_due)
+{
+    unsigned long long now, period;
+    int demand = frame_demand(in);
+
+    if(demand == DEMAND_NONE)
+        return 0;
+    if(demand == DEMAND_ALL)
+        return 1;
+
+    /* accept frames a little early, cameras do not tick exactly */
+    now = latency_now();
+    period = 1000000ULL / demand;
+    if(now + period / 8 < *next_due)
+        return 0;
+
+    *next_due = (now > *next_due + period) ? now + period : *next_due + period;
+    return 1;
+}
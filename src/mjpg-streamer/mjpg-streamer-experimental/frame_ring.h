@@ -0,0 +1,163 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stddef.h>
+#include <sys/time.h>
+
+#include "latency.h"
+#include "metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every input publishes its frames into a small ring of reference counted
+ * slots. A slot is referenced by the ring while it is the latest frame, by
+ * the producer while it is being filled and by every consumer that is still
+ * reading it. Consumers never copy a frame, they hold a reference instead,
+ * and a slot is only reused once nothing references it anymore.
+ *
+ * Reference counts and the latest pointer are protected by the db mutex of
+ * the input, the frame data itself is only written while the producer holds
+ * the sole reference.
+ *
+ * Published frames are numbered starting at 1, so a consumer can tell a new
+ * frame from a spurious wakeup and count the frames it missed in between.
+ */
+#define FRAME_RING_SLOTS 8
+
+/*
+ * Outputs declare while they need frames and at which rate. Inputs that
+ * support it stop capturing while nobody needs frames and only publish as
+ * many frames as the most demanding output asks for.
+ */
+#define DEMAND_NONE (-1)    /* nobody needs frames */
+#define DEMAND_ALL  0       /* every frame the input produces */
+
+typedef struct _frame_interest frame_interest;
+struct _frame_interest {
+    int fps;                /* DEMAND_ALL or frames per second */
+    frame_interest *next;
+};
+
+typedef struct _frame_slot frame_slot;
+struct _frame_slot {
+    unsigned char *buf;
+    int size;
+    size_t capacity;
+
+    /* v4l2_buffer timestamp */
+    struct timeval timestamp;
+
+    /* pipeline stamps, see latency.h */
+    frame_trace trace;
+
+    /* sequence number assigned by frame_publish() */
+    unsigned long long seq;
+
+    /* hash of the frame data and whether the previous frame had the same
+       data, also set by frame_publish() */
+    unsigned long long hash;
+    int duplicate;
+
+    int refs;
+
+    /* the ring was freed while this slot was still referenced, the last
+       reference releases its memory */
+    int orphan;
+};
+
+typedef struct _frame_ring frame_ring;
+struct _frame_ring {
+    frame_slot slot[FRAME_RING_SLOTS];
+    frame_slot *latest;
+    unsigned long long seq;
+
+    /* output plugins reading this input and the frames queued for all of
+       them together, see frame_consumer.h */
+    struct _frame_consumer *consumers;
+    int queued;
+
+    /* outputs that currently need frames and their combined demand, the
+       list is protected by db, demand may be read without it */
+    frame_interest *interests;
+    int demand;
+
+    /* watched by the supervisor in mjpg_streamer.c */
+    unsigned long long last_frame;  /* latency_now() of the last publish */
+    frame_slot *reserved;           /* slot the producer is filling */
+    int stopped;                    /* set once the input thread cleaned up */
+    int watched;                    /* the watchdog may restart the input,
+                                       keep the frames for the next run */
+
+    /* registered by frame_ring_init() */
+    metric *published;
+    metric *dropped;
+    metric *duplicates;
+    metric *frame_bytes;
+    metric *db_wait;
+    metric *restarts;
+};
+
+struct _input;
+
+void frame_ring_init(struct _input *in, int id);
+void frame_lock(struct _input *in);
+void frame_ring_free(struct _input *in);
+
+/* producer side */
+frame_slot *frame_reserve(struct _input *in, size_t size);
+void frame_publish(struct _input *in, frame_slot *slot);
+void frame_cancel(struct _input *in, frame_slot *slot);
+
+/* consumer side, frame_ref_latest() expects the db mutex to be held */
+frame_slot *frame_ref_latest(struct _input *in);
+frame_slot *wait_for_frame(struct _input *in, unsigned long long last_seq, int timeout);
+unsigned long long frame_seq(struct _input *in);
+void frame_unref(struct _input *in, frame_slot *slot);
+void frame_release(frame_slot *slot);
+
+/* cleanup handler for threads cancelled while they hold the db mutex */
+void frame_unlock_db(void *arg);
+
+/* demand for frames, see DEMAND_NONE */
+int frame_interest_add(struct _input *in, frame_interest *interest, int fps);
+void frame_interest_remove(struct _input *in, frame_interest *interest);
+int frame_demand(struct _input *in);
+int frame_wait_demand(struct _input *in);
+int frame_wanted(struct _input *in, unsigned long long *next_due);
+
+/* whether two frames have the same data */
+#define FRAME_SAME(a_hash, a_size, b_hash, b_size) ((a_hash) == (b_hash) && (a_size) == (b_size))
+
+/* number of frames published between two frames a consumer received */
+#define FRAMES_MISSED(last_seq, seq) (((last_seq) != 0 && (seq) > (last_seq) + 1) ? (seq) - (last_seq) - 1 : 0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mjpg_streamer.h"
+#include "frame_ring.h"
+
+static int failed = 0;
+
+#define CHECK(cond) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failed++; \
+        } \
+    } while(0)
+
+/******************************************************************************
+Description.: reserves a slot, fills it and publishes it
+Input Value.: * in is the input
+              * data is the frame
+Return Value: the published slot, NULL if the ring was full
+******************************************************************************/
+static frame_slot *publish(input *in, const char *data)
+{
+    frame_slot *slot;
+
+    if((slot = frame_reserve(in, strlen(data))) == NULL)
+        return NULL;
+    memcpy(slot->buf, data, strlen(data));
+    slot->size = strlen(data);
+    frame_publish(in, slot);
+
+    return slot;
+}
+
+/******************************************************************************
+Description.: takes a reference to the latest frame like a consumer does
+Input Value.: in is the input
+Return Value: the slot
+******************************************************************************/
+static frame_slot *ref_latest(input *in)
+{
+    frame_slot *slot;
+
+    pthread_mutex_lock(&in->db);
+    slot = frame_ref_latest(in);
+    pthread_mutex_unlock(&in->db);
+
+    return slot;
+}
+
+int main(void)
+{
+    static input in;
+    frame_slot *a, *b, *held[FRAME_RING_SLOTS], *slot;
+    char data[16];
+    int i;
+
+    pthread_mutex_init(&in.db, NULL);
+    pthread_cond_init(&in.db_update, NULL);
+    frame_ring_init(&in, 0);
+
+    /* nothing published yet */
+    CHECK(frame_seq(&in) == 0);
+    CHECK(ref_latest(&in) == NULL);
+    CHECK(wait_for_frame(&in, 0, 0) == NULL);
+
+    /* the producer holds the reserved slot, the ring the published one */
+    a = frame_reserve(&in, 3);
+    CHECK(a != NULL && a->refs == 1 && in.ring.reserved == a);
+    memcpy(a->buf, "abc", 3);
+    a->size = 3;
+    frame_publish(&in, a);
+    CHECK(a->refs == 1 && a->seq == 1 && !a->duplicate);
+    CHECK(in.ring.latest == a && in.ring.reserved == NULL);
+
+    /* a consumer keeps the frame once a newer one replaced it */
+    CHECK(ref_latest(&in) == a && a->refs == 2);
+    b = publish(&in, "abc");
+    CHECK(b != NULL && b != a);
+    CHECK(b->seq == 2 && b->duplicate && b->refs == 1);
+    CHECK(a->refs == 1 && a->buf != NULL);
+    frame_unref(&in, a);
+    CHECK(a->refs == 0);
+
+    b = publish(&in, "abd");
+    CHECK(b->seq == 3 && !b->duplicate);
+
+    /* cancelled frames are not published */
+    slot = frame_reserve(&in, 3);
+    frame_cancel(&in, slot);
+    CHECK(slot->refs == 0 && frame_seq(&in) == 3);
+
+    /* frames a consumer missed */
+    CHECK(FRAMES_MISSED(0, 5) == 0);
+    CHECK(FRAMES_MISSED(4, 5) == 0);
+    CHECK(FRAMES_MISSED(5, 5) == 0);
+    CHECK(FRAMES_MISSED(3, 7) == 3);
+    CHECK(wait_for_frame(&in, 3, 0) == NULL);
+    slot = wait_for_frame(&in, 1, 0);
+    CHECK(slot == b && FRAMES_MISSED(1, slot->seq) == 1);
+    frame_unref(&in, slot);
+
+    /* consumers holding every slot make the producer drop frames */
+    for(i = 0; i < FRAME_RING_SLOTS; i++) {
+        snprintf(data, sizeof(data), "frame %d", i);
+        CHECK(publish(&in, data) != NULL);
+        held[i] = ref_latest(&in);
+    }
+    CHECK(frame_reserve(&in, 8) == NULL);
+    CHECK(frame_seq(&in) == 3 + FRAME_RING_SLOTS);
+
+    frame_unref(&in, held[0]);
+    slot = frame_reserve(&in, 8);
+    CHECK(slot == held[0]);
+    frame_cancel(&in, slot);
+
+    /* slots still read survive the ring, the last reference frees them */
+    frame_ring_free(&in);
+    CHECK(in.ring.latest == NULL && in.ring.stopped);
+    for(i = 1; i < FRAME_RING_SLOTS; i++) {
+        CHECK(held[i]->orphan && held[i]->buf != NULL);
+        frame_unref(&in, held[i]);
+        CHECK(held[i]->refs == 0 && held[i]->buf == NULL);
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
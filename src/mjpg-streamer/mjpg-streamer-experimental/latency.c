@@ -0,0 +1,228 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "mjpg_streamer.h"
+#include "utils.h"
+#include "metrics.h"
+#include "latency.h"
+
+/*
+ * The samples are kept in the metrics registry as the histogram
+ * mjpg_latency_microseconds, labelled with the input and the stage, so
+ * /metrics and /latency.json report the same buckets. The metrics are
+ * registered on first use, registering one twice returns the same entry so
+ * threads racing here store the same pointer.
+ */
+static metric *histograms[MAX_INPUT_PLUGINS][LAT_STAGES];
+
+static const char *stage_names[LAT_STAGES] = {
+    "exposure",
+    "readout",
+    "publish",
+    "delivery",
+    "total"
+};
+
+/******************************************************************************
+Description.: looks up the histogram of a stage, registers it on first use
+Input Value.: * input is the number of the input plugin
+              * stage selects the histogram
+Return Value: the metric, or NULL if the registry is full
+******************************************************************************/
+static metric *stage_histogram(int input, latency_stage stage)
+{
+    metric *m = __atomic_load_n(&histograms[input][stage], __ATOMIC_ACQUIRE);
+    char labels[48];
+
+    if(m == NULL) {
+        snprintf(labels, sizeof(labels), "input=\"%d\",stage=\"%s\"", input, stage_names[stage]);
+        m = metric_histogram("mjpg_latency_microseconds", labels,
+                             "Time frames spent in each stage of the pipeline.");
+        __atomic_store_n(&histograms[input][stage], m, __ATOMIC_RELEASE);
+    }
+
+    return m;
+}
+
+/******************************************************************************
+Description.: reads the clock all pipeline stamps are taken from
+Input Value.: -
+Return Value: CLOCK_MONOTONIC in microseconds
+******************************************************************************/
+unsigned long long latency_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/******************************************************************************
+Description.: converts a monotonic timeval (e.g. a V4L2 buffer timestamp)
+Input Value.: tv is the time to convert
+Return Value: the time in microseconds
+******************************************************************************/
+unsigned long long latency_timeval(const struct timeval *tv)
+{
+    return (unsigned long long)tv->tv_sec * 1000000ULL + tv->tv_usec;
+}
+
+/******************************************************************************
+Description.: adds one sample to the histogram of a stage
+Input Value.: * input is the number of the input plugin the frame came from
+              * stage selects the histogram
+              * usec is the time the frame spent in this stage
+Return Value: -
+******************************************************************************/
+void latency_record(int input, latency_stage stage, unsigned long long usec)
+{
+    if(input < 0 || input >= MAX_INPUT_PLUGINS || stage >= LAT_STAGES)
+        return;
+
+    metric_observe(stage_histogram(input, stage), usec);
+}
+
+/******************************************************************************
+Description.: stamps a frame as published and records the device side stages,
+              input plugins call this while holding the db mutex right before
+              they signal db_update
+Input Value.: * trace holds the stamps the input plugin could provide
+              * input is the number of the input plugin
+Return Value: -
+******************************************************************************/
+void latency_publish(frame_trace *trace, int input)
+{
+    unsigned long long last;
+
+    trace->published = latency_now();
+
+    if(trace->trigger && trace->capture_done > trace->trigger)
+        latency_record(input, LAT_EXPOSURE, trace->capture_done - trace->trigger);
+
+    if(trace->capture_done && trace->drained > trace->capture_done)
+        latency_record(input, LAT_READOUT, trace->drained - trace->capture_done);
+
+    last = trace->drained ? trace->drained : (trace->capture_done ? trace->capture_done : trace->trigger);
+    if(last && trace->published > last)
+        latency_record(input, LAT_PUBLISH, trace->published - last);
+}
+
+/******************************************************************************
+Description.: records the client side stages once a frame was completely
+              written to a client
+Input Value.: * trace is the copy of the stamps taken together with the frame
+              * input is the number of the input plugin
+Return Value: -
+******************************************************************************/
+void latency_delivered(const frame_trace *trace, int input)
+{
+    unsigned long long now = latency_now(), first;
+
+    if(trace->published == 0)
+        return;
+
+    latency_record(input, LAT_DELIVERY, now - trace->published);
+
+    first = trace->trigger ? trace->trigger :
+            (trace->capture_done ? trace->capture_done :
+             (trace->drained ? trace->drained : trace->published));
+    latency_record(input, LAT_TOTAL, now - first);
+}
+
+/******************************************************************************
+Description.: formats the histograms of all inputs as JSON
+Input Value.: * buffer receives the text
+              * size is the size of buffer
+              * inputs is the number of loaded input plugins
+Return Value: the length of the text, or -1 if buffer was too small
+******************************************************************************/
+int latency_json(char *buffer, size_t size, int inputs)
+{
+    size_t len = 0;
+    int i, s, b, n;
+
+#define APPEND(...) \
+    do { \
+        n = snprintf(buffer + len, size - len, __VA_ARGS__); \
+        if(n < 0 || (size_t)n >= size - len) return -1; \
+        len += n; \
+    } while(0)
+
+    APPEND("{\n\"unit\": \"us\",\n\"inputs\": [\n");
+    for(i = 0; i < inputs && i < MAX_INPUT_PLUGINS; i++) {
+        APPEND("{\n\"id\": %d,\n\"stages\": {\n", i);
+        for(s = 0; s < LAT_STAGES; s++) {
+            const metric *h = stage_histogram(i, s);
+            unsigned long long count = h ? __atomic_load_n(&h->count, __ATOMIC_RELAXED) : 0;
+            unsigned long long sum = h ? __atomic_load_n(&h->sum, __ATOMIC_RELAXED) : 0;
+
+            APPEND("\"%s\": {\"count\": %llu, \"mean\": %llu, \"p50\": %llu, \"p99\": %llu, \"max\": %llu, \"buckets\": [",
+                   stage_names[s], count, count ? sum / count : 0,
+                   metric_percentile(h, count, 500),
+                   metric_percentile(h, count, 990),
+                   h ? __atomic_load_n(&h->max, __ATOMIC_RELAXED) : 0);
+            for(b = 0; b < METRIC_BUCKETS; b++)
+                APPEND("%s%llu", b ? ", " : "", h ? __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED) : 0);
+            APPEND("]}%s\n", (s != LAT_STAGES - 1) ? "," : "");
+        }
+        APPEND("}\n}%s\n", (i != inputs - 1) ? "," : "");
+    }
+    APPEND("]\n}\n");
+
+#undef APPEND
+
+    return len;
+}
+
+/******************************************************************************
+Description.: prints a short summary of the histograms, used when the process
+              receives SIGUSR1
+Input Value.: * stream to print to
+              * inputs is the number of loaded input plugins
+Return Value: -
+******************************************************************************/
+void latency_dump(FILE *stream, int inputs)
+{
+    int i, s;
+
+    for(i = 0; i < inputs && i < MAX_INPUT_PLUGINS; i++) {
+        for(s = 0; s < LAT_STAGES; s++) {
+            const metric *h = __atomic_load_n(&histograms[i][s], __ATOMIC_ACQUIRE);
+            unsigned long long count = h ? __atomic_load_n(&h->count, __ATOMIC_RELAXED) : 0;
+
+            if(count == 0)
+                continue;
+
+            fprintf(stream, "latency input %d %-8s: %llu frames, mean %llu us, p50 <= %llu us, p99 <= %llu us, max %llu us\n",
+                    i, stage_names[s], count,
+                    __atomic_load_n(&h->sum, __ATOMIC_RELAXED) / count,
+                    metric_percentile(h, count, 500),
+                    metric_percentile(h, count, 990),
+                    __atomic_load_n(&h->max, __ATOMIC_RELAXED));
+        }
+    }
+}
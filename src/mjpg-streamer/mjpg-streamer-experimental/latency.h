@@ -0,0 +1,71 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every frame carries the CLOCK_MONOTONIC time (in microseconds) at which it
+ * passed each stage of the pipeline. Stamps an input can not provide stay 0
+ * and the stages depending on them are not recorded.
+ */
+typedef struct _frame_trace frame_trace;
+struct _frame_trace {
+    uint64_t trigger;       /* exposure was started */
+    uint64_t capture_done;  /* sensor finished the exposure */
+    uint64_t drained;       /* frame was read out of the device */
+    uint64_t published;     /* frame was handed to the output plugins */
+};
+
+typedef enum {
+    LAT_EXPOSURE = 0,   /* trigger -> capture_done */
+    LAT_READOUT,        /* capture_done -> drained */
+    LAT_PUBLISH,        /* last device stamp -> published */
+    LAT_DELIVERY,       /* published -> written to a client */
+    LAT_TOTAL,          /* first stamp -> written to a client */
+    LAT_STAGES
+} latency_stage;
+
+unsigned long long latency_now(void);
+unsigned long long latency_timeval(const struct timeval *tv);
+
+void latency_record(int input, latency_stage stage, unsigned long long usec);
+void latency_publish(frame_trace *trace, int input);
+void latency_delivered(const frame_trace *trace, int input);
+
+int latency_json(char *buffer, size_t size, int inputs);
+void latency_dump(FILE *stream, int inputs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
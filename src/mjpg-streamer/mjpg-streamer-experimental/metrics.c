@@ -0,0 +1,266 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <pthread.h>
+
+#include "mjpg_streamer.h"
+#include "metrics.h"
+
+/*
+ * Entries are only appended. A new entry is completely written before the
+ * count is raised with release semantics, so readers that load the count
+ * with acquire semantics never see a half initialized metric. Registration
+ * itself is serialized by a mutex, it only happens at startup.
+ */
+static metric registry[METRICS_MAX];
+static int registered = 0;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *type_names[] = {
+    "counter",
+    "gauge",
+    "histogram"
+};
+
+/******************************************************************************
+Description.: finds or creates a metric
+Input Value.: * type of the metric
+              * name of the metric, without labels
+              * labels in the Prometheus format without braces, may be NULL
+              * help is a short description, it must stay valid
+Return Value: the metric, or NULL if the registry is full or the name is
+              already used by a metric of another type
+******************************************************************************/
+static metric *metric_register(metric_type type, const char *name, const char *labels, const char *help)
+{
+    metric *m = NULL;
+    int i;
+
+    if(labels == NULL)
+        labels = "";
+
+    pthread_mutex_lock(&registry_lock);
+
+    for(i = 0; i < registered; i++) {
+        if(strcmp(registry[i].name, name) == 0 && strcmp(registry[i].labels, labels) == 0) {
+            m = (registry[i].type == type) ? &registry[i] : NULL;
+            goto out;
+        }
+    }
+
+    if(registered == METRICS_MAX) {
+        LOG("metrics registry is full, %s is not recorded\n", name);
+        goto out;
+    }
+
+    m = &registry[registered];
+    memset(m, 0, sizeof(*m));
+    m->type = type;
+    snprintf(m->name, sizeof(m->name), "%s", name);
+    snprintf(m->labels, sizeof(m->labels), "%s", labels);
+    m->help = help;
+
+    __atomic_store_n(&registered, registered + 1, __ATOMIC_RELEASE);
+
+out:
+    pthread_mutex_unlock(&registry_lock);
+    return m;
+}
+
+metric *metric_counter(const char *name, const char *labels, const char *help)
+{
+    return metric_register(METRIC_COUNTER, name, labels, help);
+}
+
+metric *metric_gauge(const char *name, const char *labels, const char *help)
+{
+    return metric_register(METRIC_GAUGE, name, labels, help);
+}
+
+metric *metric_histogram(const char *name, const char *labels, const char *help)
+{
+    return metric_register(METRIC_HISTOGRAM, name, labels, help);
+}
+
+/******************************************************************************
+Description.: adds to a counter or a gauge
+Input Value.: * m is the metric
+              * delta is added, counters should only grow
+Return Value: -
+******************************************************************************/
+void metric_add(metric *m, long long delta)
+{
+    if(m != NULL)
+        __atomic_fetch_add(&m->value, delta, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+Description.: sets a gauge
+Input Value.: * m is the metric
+              * value is the new value
+Return Value: -
+******************************************************************************/
+void metric_set(metric *m, long long value)
+{
+    if(m != NULL)
+        __atomic_store_n(&m->value, value, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+Description.: records one observation in a histogram
+Input Value.: * m is the metric
+              * value is the observation, e.g. a duration in microseconds
+Return Value: -
+******************************************************************************/
+void metric_observe(metric *m, unsigned long long value)
+{
+    unsigned long long max;
+    int bucket = 0;
+
+    if(m == NULL)
+        return;
+
+    while(bucket < METRIC_BUCKETS - 1 && value > (1ULL << bucket))
+        bucket++;
+
+    __atomic_fetch_add(&m->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->sum, value, __ATOMIC_RELAXED);
+
+    max = __atomic_load_n(&m->max, __ATOMIC_RELAXED);
+    while(value > max &&
+          !__atomic_compare_exchange_n(&m->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/******************************************************************************
+Description.: estimates a percentile from the buckets of a histogram
+Input Value.: * m is the histogram
+              * count is the number of observations read from it
+              * permille selects the percentile, e.g. 990 for p99
+Return Value: the upper bound of the bucket holding the percentile, limited
+              to the largest observation seen
+******************************************************************************/
+unsigned long long metric_percentile(const metric *m, unsigned long long count, int permille)
+{
+    unsigned long long seen = 0, wanted = (count * permille + 999) / 1000;
+    unsigned long long max;
+    int i;
+
+    if(m == NULL || count == 0)
+        return 0;
+
+    max = __atomic_load_n(&m->max, __ATOMIC_RELAXED);
+    for(i = 0; i < METRIC_BUCKETS - 1; i++) {
+        seen += __atomic_load_n(&m->buckets[i], __ATOMIC_RELAXED);
+        if(seen >= wanted)
+            return ((1ULL << i) < max) ? (1ULL << i) : max;
+    }
+
+    return max;
+}
+
+/******************************************************************************
+Description.: formats the samples of one metric
+Input Value.: * m is the metric
+              * buffer receives the text
+              * size is the size of buffer
+Return Value: the length of the text, or -1 if buffer was too small
+******************************************************************************/
+static int metric_samples(const metric *m, char *buffer, size_t size)
+{
+    const char *open = m->labels[0] ? "{" : "", *close = m->labels[0] ? "}" : "";
+    const char *sep = m->labels[0] ? "," : "";
+    unsigned long long cumulative = 0;
+    size_t len = 0;
+    int b, n;
+
+#define APPEND(...) \
+    do { \
+        n = snprintf(buffer + len, size - len, __VA_ARGS__); \
+        if(n < 0 || (size_t)n >= size - len) return -1; \
+        len += n; \
+    } while(0)
+
+    if(m->type != METRIC_HISTOGRAM) {
+        APPEND("%s%s%s%s %lld\n", m->name, open, m->labels, close,
+               __atomic_load_n(&m->value, __ATOMIC_RELAXED));
+        return len;
+    }
+
+    for(b = 0; b < METRIC_BUCKETS - 1; b++) {
+        cumulative += __atomic_load_n(&m->buckets[b], __ATOMIC_RELAXED);
+        APPEND("%s_bucket{%s%sle=\"%llu\"} %llu\n", m->name, m->labels, sep, 1ULL << b, cumulative);
+    }
+    cumulative += __atomic_load_n(&m->buckets[b], __ATOMIC_RELAXED);
+    APPEND("%s_bucket{%s%sle=\"+Inf\"} %llu\n", m->name, m->labels, sep, cumulative);
+    APPEND("%s_sum%s%s%s %llu\n", m->name, open, m->labels, close,
+           __atomic_load_n(&m->sum, __ATOMIC_RELAXED));
+    APPEND("%s_count%s%s%s %llu\n", m->name, open, m->labels, close, cumulative);
+
+#undef APPEND
+
+    return len;
+}
+
+/******************************************************************************
+Description.: formats all metrics in the Prometheus text exposition format,
+              the samples of a name are grouped below its HELP and TYPE lines
+Input Value.: * buffer receives the text
+              * size is the size of buffer
+Return Value: the length of the text, or -1 if buffer was too small
+******************************************************************************/
+int metrics_text(char *buffer, size_t size)
+{
+    int count = __atomic_load_n(&registered, __ATOMIC_ACQUIRE);
+    size_t len = 0;
+    int i, j, n;
+
+    for(i = 0; i < count; i++) {
+        /* skip names that were printed together with an earlier metric */
+        for(j = 0; j < i; j++) {
+            if(strcmp(registry[j].name, registry[i].name) == 0)
+                break;
+        }
+        if(j < i)
+            continue;
+
+        n = snprintf(buffer + len, size - len, "# HELP %s %s\n# TYPE %s %s\n",
+                     registry[i].name, registry[i].help ? registry[i].help : "",
+                     registry[i].name, type_names[registry[i].type]);
+        if(n < 0 || (size_t)n >= size - len)
+            return -1;
+        len += n;
+
+        for(j = i; j < count; j++) {
+            if(strcmp(registry[j].name, registry[i].name) != 0)
+                continue;
+            if((n = metric_samples(&registry[j], buffer + len, size - len)) < 0)
+                return -1;
+            len += n;
+        }
+    }
+
+    return len;
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Process wide registry of counters, gauges and histograms. Plugins register
+ * their metrics once, usually from their init function, and update them from
+ * any thread without locking. output_http serves the registry in the
+ * Prometheus text format at /metrics.
+ *
+ * A metric is identified by its name and its labels, e.g. name
+ * "mjpg_frames_published_total" and labels "input=\"0\"". Registering the
+ * same pair again returns the existing metric.
+ */
+#define METRICS_MAX 256
+
+/* bucket n of a histogram counts observations up to 2^n, the last one is +Inf */
+#define METRIC_BUCKETS 24
+
+typedef enum {
+    METRIC_COUNTER = 0,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+} metric_type;
+
+typedef struct _metric metric;
+struct _metric {
+    metric_type type;
+    char name[64];
+    char labels[96];
+    const char *help;
+
+    long long value;                             /* counter and gauge */
+
+    unsigned long long buckets[METRIC_BUCKETS];  /* histogram */
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+};
+
+metric *metric_counter(const char *name, const char *labels, const char *help);
+metric *metric_gauge(const char *name, const char *labels, const char *help);
+metric *metric_histogram(const char *name, const char *labels, const char *help);
+
+/* all updates accept NULL, so a failed registration only loses the metric */
+void metric_add(metric *m, long long delta);
+void metric_set(metric *m, long long value);
+void metric_observe(metric *m, unsigned long long value);
+
+#define metric_inc(m) metric_add((m), 1)
+#define metric_dec(m) metric_add((m), -1)
+
+unsigned long long metric_percentile(const metric *m, unsigned long long count, int permille);
+
+int metrics_text(char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -41,10 +41,24 @@
 
 #include "utils.h"
 #include "mjpg_streamer.h"
+#include "placement.h"
 
 /* globals */
 static globals global;
 
+/* set by SIGUSR1, the main thread prints the latency histograms */
+static volatile sig_atomic_t dump_latency = 0;
+
+/* --cpu, --sched, --nice and --mlock of every plugin */
+static placement in_placement[MAX_INPUT_PLUGINS];
+static placement out_placement[MAX_OUTPUT_PLUGINS];
+
+/* --watchdog of every input plugin in ms, 0 if not watched */
+static int in_watchdog[MAX_INPUT_PLUGINS];
+
+/* how long a stalled input may take to clean up before a restart is given up */
+#define WATCHDOG_STOP_TIMEOUT 1000
+
 /******************************************************************************
 Description.: Display a help message
 Input Value.: argv[0] is the program name and the parameter progname
@@ -60,6 +74,15 @@ static void help(char *progname)
             " [-v | --version ].....: display version information\n" \
             " [-b | --background]...: fork to the background, daemon mode\n", progname);
     fprintf(stderr, "-----------------------------------------------------------------------\n");
+    fprintf(stderr, "Every plugin additionally accepts these parameters for its threads:\n" \
+            " [--cpu <list>].........: run on these CPUs only, e.g. 3 or 0-2\n" \
+            " [--sched <policy>].....: fifo:<prio>, rr:<prio>, other, batch or idle\n" \
+            " [--nice <value>].......: nice value of the threads\n" \
+            " [--mlock]..............: lock the memory of the process into RAM\n");
+    fprintf(stderr, "Input plugins that can be restarted also accept:\n" \
+            " [--watchdog <ms>]......: restart the plugin if it publishes no frame\n" \
+            "                          for this long while an output needs frames\n");
+    fprintf(stderr, "-----------------------------------------------------------------------\n");
     fprintf(stderr, "Example #1:\n" \
             " To open an UVC webcam \"/dev/video1\" and stream it via HTTP:\n" \
             "  %s -i \"input_uvc.so -d /dev/video1\" -o \"output_http.so\"\n", progname);
@@ -102,6 +125,8 @@ static void signal_handler(int sig)
     /* clean up threads */
     LOG("force cancellation of threads and cleanup resources\n");
     for(i = 0; i < global.incnt; i++) {
+        /* nothing restarts the input anymore, its frames can go */
+        __atomic_store_n(&global.in[i].ring.watched, 0, __ATOMIC_RELEASE);
         global.in[i].stop(i);
         /*for (j = 0; j<MAX_PLUGIN_ARGUMENTS; j++) {
             if (global.in[i].param.argv[j] != NULL) {
@@ -112,8 +137,6 @@ static void signal_handler(int sig)
 
     for(i = 0; i < global.outcnt; i++) {
         global.out[i].stop(global.out[i].param.id);
-        pthread_cond_destroy(&global.in[i].db_update);
-        pthread_mutex_destroy(&global.in[i].db);
         /*for (j = 0; j<MAX_PLUGIN_ARGUMENTS; j++) {
             if (global.out[i].param.argv[j] != NULL)
                 free(global.out[i].param.argv[j]);
@@ -154,6 +177,37 @@ static void signal_handler(int sig)
     return;
 }
 
+/******************************************************************************
+Description.: SIGUSR1 requests a dump of the frame latency histograms, the
+              printing itself is left to the main thread
+Input Value.: sig tells us which signal was received
+Return Value: -
+******************************************************************************/
+static void latency_signal_handler(int sig)
+{
+    dump_latency = 1;
+}
+
+/******************************************************************************
+Description.: applies the placement of a plugin to the main thread right
+              before the plugin starts its threads, they inherit it
+Input Value.: * plugin is the name of the plugin for the log
+              * p is the placement of the plugin
+              * saved receives the settings to restore afterwards
+Return Value: -
+******************************************************************************/
+static void placement_start(const char *plugin, const placement *p, placement *saved)
+{
+    char description[256];
+
+    placement_describe(p, description, sizeof(description));
+    if(description[0] != '\0')
+        LOG("%s threads: %s\n", plugin, description);
+
+    if(placement_apply(p, saved) < 0)
+        LOG("%s runs with the default placement for the refused settings\n", plugin);
+}
+
 static int split_parameters(char *parameter_string, int *argc, char **argv)
 {
     int count = 1;
@@ -184,6 +238,157 @@ static int split_parameters(char *parameter_string, int *argc, char **argv)
     return 1;
 }
 
+/******************************************************************************
+Description.: removes --watchdog from the arguments of an input plugin
+Input Value.: * argc and argv are the plugin arguments, argv[0] is skipped
+              * timeout receives the value in ms, 0 if the option is missing
+Return Value: 0 if ok, -1 if the value is missing or invalid
+******************************************************************************/
+static int watchdog_parse(int *argc, char **argv, int *timeout)
+{
+    int i;
+
+    *timeout = 0;
+
+    for(i = 1; i < *argc; i++) {
+        /* the plugins use getopt_long_only(), so accept one or two dashes */
+        if(strcmp(argv[i], "-watchdog") != 0 && strcmp(argv[i], "--watchdog") != 0)
+            continue;
+
+        if(i + 1 >= *argc || (*timeout = atoi(argv[i + 1])) <= 0) {
+            LOG("option %s requires a time in ms\n", argv[i]);
+            return -1;
+        }
+
+        free(argv[i]);
+        free(argv[i + 1]);
+        memmove(&argv[i], &argv[i + 2], (*argc - i - 2) * sizeof(char *));
+        *argc -= 2;
+        argv[*argc] = NULL;
+        argv[*argc + 1] = NULL;
+        break;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: stops an input plugin and runs it again, the caller holds the
+              command lock of the input
+Input Value.: * in is the input plugin
+              * id is its number
+Return Value: 0 if ok, -1 if the plugin could not be restarted
+******************************************************************************/
+static int restart_locked(input *in, int id)
+{
+    placement saved;
+    int waited, rc;
+
+    /* a thread that left its loop on an error has already cleaned up */
+    if(!__atomic_load_n(&in->ring.stopped, __ATOMIC_ACQUIRE)) {
+        in->stop(id);
+        for(waited = 0; waited < WATCHDOG_STOP_TIMEOUT; waited += 10) {
+            if(__atomic_load_n(&in->ring.stopped, __ATOMIC_ACQUIRE))
+                break;
+            usleep(10 * 1000);
+        }
+        if(waited >= WATCHDOG_STOP_TIMEOUT) {
+            LOG("input plugin %d (%s) does not stop, can not restart it\n", id, in->plugin);
+            return -1;
+        }
+    }
+
+    __atomic_store_n(&in->ring.stopped, 0, __ATOMIC_RELEASE);
+
+    if(in->restart(id)) {
+        LOG("input_restart() of plugin %d (%s) failed\n", id, in->plugin);
+        return -1;
+    }
+
+    placement_start(in->plugin, &in_placement[id], &saved);
+    rc = in->run(id);
+    placement_restore(&saved);
+
+    return rc ? -1 : 0;
+}
+
+/******************************************************************************
+Description.: restarts an input plugin in place, the outputs keep their
+              clients and continue with the frames of the new run, no command
+              runs and no controls are read while it restarts
+Input Value.: id is the number of the input plugin
+Return Value: 0 if ok, -1 if the plugin could not be restarted
+******************************************************************************/
+static int restart_input(int id)
+{
+    input *in = &global.in[id];
+    int rc;
+
+    command_lock(in);
+    rc = restart_locked(in, id);
+    command_unlock(in);
+
+    return rc;
+}
+
+/******************************************************************************
+Description.: supervises the inputs that have a watchdog, an input counts as
+              stalled if it published nothing for its timeout while outputs
+              need frames, or if its thread has ended
+Input Value.: unused
+Return Value: unused, always NULL
+******************************************************************************/
+static void *watchdog_thread(void *arg)
+{
+    unsigned long long now, last;
+    int i, interval = 1000;
+
+    /* check four times per timeout, so a stall is caught soon after */
+    for(i = 0; i < global.incnt; i++) {
+        if(in_watchdog[i] > 0 && in_watchdog[i] / 4 < interval)
+            interval = MAX(in_watchdog[i] / 4, 10);
+    }
+
+    /* the inputs only start to count from now */
+    now = latency_now();
+    for(i = 0; i < global.incnt; i++)
+        __atomic_store_n(&global.in[i].ring.last_frame, now, __ATOMIC_RELAXED);
+
+    while(!global.stop) {
+        usleep(interval * 1000);
+
+        for(i = 0; i < global.incnt && !global.stop; i++) {
+            if(in_watchdog[i] == 0)
+                continue;
+
+            now = latency_now();
+            last = __atomic_load_n(&global.in[i].ring.last_frame, __ATOMIC_RELAXED);
+
+            /* an input idling for lack of demand is not stalled */
+            if(!__atomic_load_n(&global.in[i].ring.stopped, __ATOMIC_ACQUIRE) &&
+               frame_demand(&global.in[i]) == DEMAND_NONE) {
+                __atomic_store_n(&global.in[i].ring.last_frame, now, __ATOMIC_RELAXED);
+                continue;
+            }
+
+            if(now - last < in_watchdog[i] * 1000ULL)
+                continue;
+
+            LOG("input plugin %d (%s) published no frame for %llu ms, restarting it\n",
+                i, global.in[i].plugin, (now - last) / 1000);
+            metric_inc(global.in[i].ring.restarts);
+
+            if(restart_input(i) < 0)
+                LOG("restart of input plugin %d failed, trying again in %d ms\n", i, in_watchdog[i]);
+
+            /* give the new run a full timeout to deliver its first frame */
+            __atomic_store_n(&global.in[i].ring.last_frame, latency_now(), __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
 /******************************************************************************
 Description.:
 Input Value.:
@@ -194,8 +399,11 @@ int main(int argc, char *argv[])
     //char *input  = "input_uvc.so --resolution 640x480 --fps 5 --device /dev/video0";
     char *input[MAX_INPUT_PLUGINS];
     char *output[MAX_OUTPUT_PLUGINS];
-    int daemon = 0, i, j;
+    int daemon = 0, watched = 0, i, j, rc;
+    pthread_t watchdog;
     size_t tmp = 0;
+    placement saved;
+    sigset_t usr1_mask, wait_mask;
 
     output[0] = "output_http.so --port 8080";
     global.outcnt = 0;
@@ -269,6 +477,17 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    if(signal(SIGUSR1, latency_signal_handler) == SIG_ERR) {
+        LOG("could not register signal handler\n");
+        closelog();
+        exit(EXIT_FAILURE);
+    }
+
+    /* plugin threads inherit this mask, so SIGUSR1 always wakes up main() */
+    sigemptyset(&usr1_mask);
+    sigaddset(&usr1_mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &usr1_mask, &wait_mask);
+
     /*
      * messages like the following will only be visible on your terminal
      * if not running in daemon mode
@@ -302,8 +521,7 @@ int main(int argc, char *argv[])
         tmp = (size_t)(strchr(input[i], ' ') - input[i]);
         global.in[i].stop      = 0;
         global.in[i].context   = NULL;
-        global.in[i].buf       = NULL;
-        global.in[i].size      = 0;
+        frame_ring_init(&global.in[i], i);
         global.in[i].plugin = (tmp > 0) ? strndup(input[i], tmp) : strdup(input[i]);
         global.in[i].handle = dlopen(global.in[i].plugin, RTLD_LAZY);
         if(!global.in[i].handle) {
@@ -331,6 +549,7 @@ int main(int argc, char *argv[])
         }
         /* try to find optional command */
         global.in[i].cmd = dlsym(global.in[i].handle, "input_cmd");
+        global.in[i].restart = dlsym(global.in[i].handle, "input_restart");
 
         global.in[i].param.parameters = strchr(input[i], ' ');
 
@@ -339,14 +558,34 @@ int main(int argc, char *argv[])
         }
 
         split_parameters(global.in[i].param.parameters, &global.in[i].param.argc, global.in[i].param.argv);
+        if(placement_parse(&global.in[i].param.argc, global.in[i].param.argv, &in_placement[i]) < 0 ||
+           watchdog_parse(&global.in[i].param.argc, global.in[i].param.argv, &in_watchdog[i]) < 0) {
+            closelog();
+            exit(EXIT_FAILURE);
+        }
+        if(in_watchdog[i] > 0 && global.in[i].restart == NULL) {
+            LOG("input plugin %s can not be restarted, it does not take --watchdog\n", global.in[i].plugin);
+            closelog();
+            exit(EXIT_FAILURE);
+        }
         global.in[i].param.global = &global;
         global.in[i].param.id = i;
 
+        /* frame_ring_free() keeps the frames of inputs the watchdog may restart */
+        if(in_watchdog[i] > 0)
+            __atomic_store_n(&global.in[i].ring.watched, 1, __ATOMIC_RELEASE);
+
         if(global.in[i].init(&global.in[i].param, i)) {
             LOG("input_init() return value signals to exit\n");
             closelog();
             exit(0);
         }
+
+        if(command_queue_init(&global.in[i], i) < 0) {
+            LOG("could not start the command thread of input %d\n", i);
+            closelog();
+            exit(EXIT_FAILURE);
+        }
     }
 
     /* open output plugin */
@@ -387,6 +626,10 @@ int main(int argc, char *argv[])
             global.out[i].param.argv[j] = NULL;
         }
         split_parameters(global.out[i].param.parameters, &global.out[i].param.argc, global.out[i].param.argv);
+        if(placement_parse(&global.out[i].param.argc, global.out[i].param.argv, &out_placement[i]) < 0) {
+            closelog();
+            exit(EXIT_FAILURE);
+        }
 
         global.out[i].param.global = &global;
         global.out[i].param.id = i;
@@ -401,7 +644,10 @@ int main(int argc, char *argv[])
     DBG("starting %d input plugin\n", global.incnt);
     for(i = 0; i < global.incnt; i++) {
         syslog(LOG_INFO, "starting input plugin %s", global.in[i].plugin);
-        if(global.in[i].run(i)) {
+        placement_start(global.in[i].plugin, &in_placement[i], &saved);
+        rc = global.in[i].run(i);
+        placement_restore(&saved);
+        if(rc) {
             LOG("can not run input plugin %d: %s\n", i, global.in[i].plugin);
             closelog();
             return 1;
@@ -411,11 +657,35 @@ int main(int argc, char *argv[])
     DBG("starting %d output plugin(s)\n", global.outcnt);
     for(i = 0; i < global.outcnt; i++) {
         syslog(LOG_INFO, "starting output plugin: %s (ID: %02d)", global.out[i].plugin, global.out[i].param.id);
+        placement_start(global.out[i].plugin, &out_placement[i], &saved);
         global.out[i].run(global.out[i].param.id);
+        placement_restore(&saved);
+    }
+
+    /* watch the inputs that asked for it */
+    for(i = 0; i < global.incnt; i++) {
+        if(in_watchdog[i] > 0) {
+            LOG("watchdog of input %d....: %d ms\n", i, in_watchdog[i]);
+            watched = 1;
+        }
+    }
+    if(watched) {
+        if(pthread_create(&watchdog, NULL, watchdog_thread, NULL) != 0) {
+            LOG("could not start the watchdog\n");
+        } else {
+            pthread_detach(watchdog);
+        }
     }
 
     /* wait for signals */
-    pause();
+    while(!global.stop) {
+        sigsuspend(&wait_mask);
+
+        if(dump_latency) {
+            dump_latency = 0;
+            latency_dump(stderr, global.incnt);
+        }
+    }
 
     return 0;
 }
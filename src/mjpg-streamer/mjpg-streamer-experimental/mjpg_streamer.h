@@ -41,6 +41,11 @@
 
 #define LOG(...) { char _bf[1024] = {0}; snprintf(_bf, sizeof(_bf)-1, __VA_ARGS__); fprintf(stderr, "%s", _bf); syslog(LOG_INFO, "%s", _bf); }
 
+#include "latency.h"
+#include "metrics.h"
+#include "frame_ring.h"
+#include "frame_consumer.h"
+#include "command_queue.h"
 #include "plugins/input.h"
 #include "plugins/output.h"
 
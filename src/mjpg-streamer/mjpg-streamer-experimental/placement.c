@@ -0,0 +1,287 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "mjpg_streamer.h"
+#include "placement.h"
+
+/******************************************************************************
+Description.: parses a CPU list like "3", "2,3" or "0-2"
+Input Value.: * arg is the list
+              * set receives the CPUs
+Return Value: 0 if ok, -1 if the list is invalid
+******************************************************************************/
+static int parse_cpus(const char *arg, cpu_set_t *set)
+{
+    const char *s = arg;
+    char *end;
+    long first, last, cpu;
+
+    CPU_ZERO(set);
+
+    while(*s != '\0') {
+        first = strtol(s, &end, 10);
+        if(end == s || first < 0 || first >= CPU_SETSIZE)
+            return -1;
+
+        last = first;
+        if(*end == '-') {
+            s = end + 1;
+            last = strtol(s, &end, 10);
+            if(end == s || last < first || last >= CPU_SETSIZE)
+                return -1;
+        }
+
+        for(cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, set);
+
+        if(*end == ',')
+            end++;
+        else if(*end != '\0')
+            return -1;
+        s = end;
+    }
+
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+/******************************************************************************
+Description.: parses a scheduling policy like "fifo:50", "rr:10" or "other"
+Input Value.: * arg is the policy
+              * p receives policy and priority
+Return Value: 0 if ok, -1 if the policy is invalid
+******************************************************************************/
+static int parse_sched(const char *arg, placement *p)
+{
+    const char *prio = strchr(arg, ':');
+    size_t len = prio ? (size_t)(prio - arg) : strlen(arg);
+
+    if(len == 4 && strncmp(arg, "fifo", len) == 0) {
+        p->policy = SCHED_FIFO;
+    } else if(len == 2 && strncmp(arg, "rr", len) == 0) {
+        p->policy = SCHED_RR;
+    } else if(len == 5 && strncmp(arg, "other", len) == 0) {
+        p->policy = SCHED_OTHER;
+    } else if(len == 5 && strncmp(arg, "batch", len) == 0) {
+        p->policy = SCHED_BATCH;
+    } else if(len == 4 && strncmp(arg, "idle", len) == 0) {
+        p->policy = SCHED_IDLE;
+    } else {
+        return -1;
+    }
+
+    p->priority = prio ? atoi(prio + 1) : 0;
+
+    if(p->priority < sched_get_priority_min(p->policy) ||
+       p->priority > sched_get_priority_max(p->policy))
+        return -1;
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: removes the placement options from the arguments of a plugin
+Input Value.: * argc and argv are the plugin arguments, argv[0] is skipped
+              * p receives the options
+Return Value: 0 if ok, -1 if an option has an invalid or missing value
+******************************************************************************/
+int placement_parse(int *argc, char **argv, placement *p)
+{
+    int i = 1, used, rc = 0;
+    const char *name;
+
+    memset(p, 0, sizeof(*p));
+
+    while(i < *argc) {
+        /* the plugins use getopt_long_only(), so accept one or two dashes */
+        name = argv[i];
+        if(name[0] != '-') {
+            i++;
+            continue;
+        }
+        name += (name[1] == '-') ? 2 : 1;
+
+        used = 0;
+        if(strcmp(name, "mlock") == 0) {
+            p->mlock = 1;
+            used = 1;
+        } else if(strcmp(name, "cpu") == 0 || strcmp(name, "sched") == 0 || strcmp(name, "nice") == 0) {
+            used = 2;
+            if(i + 1 >= *argc) {
+                LOG("option %s requires a value\n", argv[i]);
+                rc = -1;
+                used = 1;
+            } else if(strcmp(name, "cpu") == 0) {
+                p->has_cpus = 1;
+                if(parse_cpus(argv[i + 1], &p->cpus) < 0) {
+                    LOG("invalid CPU list: %s\n", argv[i + 1]);
+                    rc = -1;
+                }
+            } else if(strcmp(name, "sched") == 0) {
+                p->has_sched = 1;
+                if(parse_sched(argv[i + 1], p) < 0) {
+                    LOG("invalid scheduling policy: %s\n", argv[i + 1]);
+                    rc = -1;
+                }
+            } else {
+                p->has_nice = 1;
+                p->nice = atoi(argv[i + 1]);
+            }
+        }
+
+        if(used == 0) {
+            i++;
+            continue;
+        }
+
+        /* drop the option and its value from the plugin arguments */
+        free(argv[i]);
+        if(used == 2)
+            free(argv[i + 1]);
+        memmove(&argv[i], &argv[i + used], (*argc - i - used) * sizeof(char *));
+        *argc -= used;
+        argv[*argc] = NULL;
+        if(used == 2)
+            argv[*argc + 1] = NULL;
+    }
+
+    return rc;
+}
+
+/******************************************************************************
+Description.: applies the options to the calling thread, threads it creates
+              afterwards inherit them
+Input Value.: * p are the options to apply
+              * saved receives the previous settings of the thread
+Return Value: 0 if everything was applied, -1 if something was refused, e.g.
+              real-time scheduling without the required privileges
+******************************************************************************/
+int placement_apply(const placement *p, placement *saved)
+{
+    pid_t tid = syscall(SYS_gettid);
+    struct sched_param param;
+    int rc = 0;
+
+    memset(saved, 0, sizeof(*saved));
+
+    if(p->has_cpus) {
+        saved->has_cpus = (pthread_getaffinity_np(pthread_self(), sizeof(saved->cpus), &saved->cpus) == 0);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(p->cpus), &p->cpus) != 0) {
+            LOG("could not set CPU affinity\n");
+            rc = -1;
+        }
+    }
+
+    if(p->has_sched) {
+        saved->has_sched = (pthread_getschedparam(pthread_self(), &saved->policy, &param) == 0);
+        saved->priority = param.sched_priority;
+
+        param.sched_priority = p->priority;
+        if((errno = pthread_setschedparam(pthread_self(), p->policy, &param)) != 0) {
+            LOG("could not set scheduling policy: %s\n", strerror(errno));
+            rc = -1;
+        }
+    }
+
+    if(p->has_nice) {
+        errno = 0;
+        saved->nice = getpriority(PRIO_PROCESS, tid);
+        saved->has_nice = (errno == 0);
+        if(setpriority(PRIO_PROCESS, tid, p->nice) != 0) {
+            LOG("could not set nice value %d: %s\n", p->nice, strerror(errno));
+            rc = -1;
+        }
+    }
+
+    if(p->mlock) {
+        if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            LOG("could not lock memory: %s\n", strerror(errno));
+            rc = -1;
+        }
+    }
+
+    return rc;
+}
+
+/******************************************************************************
+Description.: gives the calling thread back the settings placement_apply()
+              replaced
+Input Value.: saved was filled by placement_apply()
+Return Value: -
+******************************************************************************/
+void placement_restore(const placement *saved)
+{
+    struct sched_param param;
+
+    if(saved->has_cpus)
+        pthread_setaffinity_np(pthread_self(), sizeof(saved->cpus), &saved->cpus);
+
+    if(saved->has_sched) {
+        param.sched_priority = saved->priority;
+        pthread_setschedparam(pthread_self(), saved->policy, &param);
+    }
+
+    if(saved->has_nice)
+        setpriority(PRIO_PROCESS, syscall(SYS_gettid), saved->nice);
+}
+
+/******************************************************************************
+Description.: formats the options for the startup messages
+Input Value.: * p are the options
+              * buffer receives the text
+              * size is the size of buffer
+Return Value: -
+******************************************************************************/
+void placement_describe(const placement *p, char *buffer, size_t size)
+{
+    static const char *policies[] = { "other", "fifo", "rr", "batch", "", "idle" };
+    size_t len = 0;
+    int cpu;
+
+    buffer[0] = '\0';
+
+    if(p->has_cpus) {
+        len += snprintf(buffer + len, size - len, "cpu");
+        for(cpu = 0; cpu < CPU_SETSIZE && len < size; cpu++) {
+            if(CPU_ISSET(cpu, &p->cpus))
+                len += snprintf(buffer + len, size - len, " %d", cpu);
+        }
+    }
+    if(p->has_sched && len < size)
+        len += snprintf(buffer + len, size - len, "%ssched %s:%d", len ? ", " : "", policies[p->policy], p->priority);
+    if(p->has_nice && len < size)
+        len += snprintf(buffer + len, size - len, "%snice %d", len ? ", " : "", p->nice);
+    if(p->mlock && len < size)
+        snprintf(buffer + len, size - len, "%smlock", len ? ", " : "");
+}
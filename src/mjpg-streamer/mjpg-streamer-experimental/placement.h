@@ -0,0 +1,62 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+
+/*
+ * Options common to all plugins that control where and how their threads
+ * run. mjpg_streamer.c removes them from the plugin parameters before the
+ * plugin sees them and applies them to the main thread while the plugin
+ * starts, so every thread the plugin creates inherits them.
+ *
+ *   --cpu 3 | --cpu 2,3 | --cpu 0-1    CPU affinity
+ *   --sched fifo:50 | rr:10 | other    scheduling policy and priority
+ *   --nice -5                          nice value of the threads
+ *   --mlock                            lock all memory of the process
+ */
+typedef struct _placement placement;
+struct _placement {
+    int has_cpus;
+    cpu_set_t cpus;
+
+    int has_sched;
+    int policy;
+    int priority;
+
+    int has_nice;
+    int nice;
+
+    int mlock;
+};
+
+int placement_parse(int *argc, char **argv, placement *p);
+int placement_apply(const placement *p, placement *saved);
+void placement_restore(const placement *saved);
+void placement_describe(const placement *p, char *buffer, size_t size);
+
+#endif
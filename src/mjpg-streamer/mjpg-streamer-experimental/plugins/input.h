@@ -69,12 +69,11 @@ struct _input {
     pthread_mutex_t db;
     pthread_cond_t  db_update;
 
-    /* global JPG frame, this is more or less the "database" */
-    unsigned char *buf;
-    int size;
+    /* global JPG frames, this is more or less the "database" */
+    frame_ring ring;
 
-    /* v4l2_buffer timestamp */
-    struct timeval timestamp;
+    /* control commands waiting for input_cmd(), see command_queue.h */
+    command_queue commands;
 
     input_format *in_formats;
     int formatCount;
@@ -86,4 +85,8 @@ struct _input {
     int (*stop)(int);
     int (*run)(int);
     int (*cmd)(int plugin, unsigned int control_id, unsigned int group, int value, char *value_str);
+
+    /* optional, prepares a stopped plugin to run again without the parsing
+       and allocations of init, only plugins that have it take --watchdog */
+    int (*restart)(int);
 };
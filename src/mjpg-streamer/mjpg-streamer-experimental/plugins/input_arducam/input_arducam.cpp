@@ -0,0 +1,388 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "input_arducam.h"
+
+#include <RPi4.h>
+#include <CameraBus.h>
+
+#define INPUT_PLUGIN_NAME "ArduCAM input plugin"
+
+/*
+ * Every input loaded from this plugin is one camera on the same SPI bus. One
+ * thread drives the whole bus, so the exposures of all cameras overlap and
+ * only their FIFO readouts take turns. Stopping any of the inputs stops the
+ * bus, running any of them starts it again.
+ */
+class StreamInput : public CameraInput
+{
+  public:
+    explicit StreamInput(input *in) : in(in), next_due(0) {}
+
+    void publish(const char *frame, unsigned int length, const FrameTiming &timing) override;
+
+  private:
+    input *in;
+    unsigned long long next_due;
+};
+
+/* private functions and variables to this plugin */
+static globals *pglobal;
+static char plugin_name[] = INPUT_PLUGIN_NAME;
+
+/* everything below is protected by bus_lock */
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static CameraBus *bus = NULL;
+static StreamInput *streams[MAX_INPUT_PLUGINS];
+static Camera *cameras[MAX_INPUT_PLUGINS];
+static int resolutions[MAX_INPUT_PLUGINS];
+static unsigned long capture_timeout = CAPTURE_TIMEOUT_US;
+static pthread_t worker;
+static int running = 0, stopping = 0, initialized = 0;
+
+static void *worker_thread(void *);
+static void worker_cleanup(void *);
+
+/* resolutions the OV5642 register tables exist for */
+static const struct {
+    int width, height;
+    RESOLUTION res;
+} sensor_resolutions[] = {
+    {320, 240, RES_320x240},
+    {640, 480, RES_640x480},
+    {1024, 768, RES_1024x768},
+    {1280, 960, RES_1280x960},
+    {1600, 1200, RES_1600x1200},
+    {2048, 1536, RES_2048x1536},
+    {2592, 1944, RES_2592x1944}
+};
+
+static void help(void)
+{
+    fprintf(stderr,
+    " ---------------------------------------------------------------\n" \
+    " Help for input plugin..: " INPUT_PLUGIN_NAME "\n" \
+    " ---------------------------------------------------------------\n" \
+    " The following parameters can be passed to this plugin:\n\n" \
+    " [-c | --cs ]...........: GPIO pin of the chip-select line of the camera\n" \
+    " [-r | --resolution ]...: 320x240, 640x480, 1024x768, 1280x960,\n" \
+    "                          1600x1200, 2048x1536 or 2592x1944\n" \
+    " [-t | --timeout ]......: ms to wait for an exposure before the\n" \
+    "                          camera skips a cycle, applies to the bus\n" \
+    " ---------------------------------------------------------------\n" \
+    " Load the plugin once per camera, up to %d cameras share the bus\n" \
+    " ---------------------------------------------------------------\n\n", MAX_BUS_CAMERAS);
+}
+
+/******************************************************************************
+Description.: copies a frame the bus read out into the ring of its input
+Input Value.: * frame is the JPEG data, it is only valid during the call
+              * length is its size in bytes
+              * timing holds the stamps the camera took, they share
+                CLOCK_MONOTONIC with latency_now()
+Return Value: -
+******************************************************************************/
+void StreamInput::publish(const char *frame, unsigned int length, const FrameTiming &timing)
+{
+    frame_slot *slot;
+
+    /* the bus captures every camera at once, drop what no output needs */
+    if(length == 0 || !frame_wanted(this->in, &this->next_due))
+        return;
+
+    if((slot = frame_reserve(this->in, length)) == NULL)
+        return;
+
+    memcpy(slot->buf, frame, length);
+    slot->size = length;
+
+    slot->trace.trigger = timing.trigger;
+    slot->trace.capture_done = timing.captureDone;
+    slot->trace.drained = timing.drained;
+
+    /* signal fresh_frame */
+    frame_publish(this->in, slot);
+}
+
+/*** plugin interface functions ***/
+
+/******************************************************************************
+Description.: parses the parameters and adds the camera to the bus
+Input Value.: * param contains the command line string and a pointer to globals
+              * id is the number of this input plugin
+Return Value: 0 if everything is ok
+******************************************************************************/
+int input_init(input_parameter *param, int id)
+{
+    int cs = -1, width = 320, height = 240, timeout = -1, i;
+    RESOLUTION res = RES_320x240;
+    Camera *camera;
+
+    pglobal = param->global;
+    param->argv[0] = plugin_name;
+
+    /* show all parameters for DBG purposes */
+    for(i = 0; i < param->argc; i++) {
+        DBG("argv[%d]=%s\n", i, param->argv[i]);
+    }
+
+    reset_getopt();
+    while(1) {
+        int option_index = 0, c = 0;
+        static struct option long_options[] = {
+            {"h", no_argument, 0, 0},
+            {"help", no_argument, 0, 0},
+            {"c", required_argument, 0, 0},
+            {"cs", required_argument, 0, 0},
+            {"r", required_argument, 0, 0},
+            {"resolution", required_argument, 0, 0},
+            {"t", required_argument, 0, 0},
+            {"timeout", required_argument, 0, 0},
+            {0, 0, 0, 0}
+        };
+
+        c = getopt_long_only(param->argc, param->argv, "", long_options, &option_index);
+
+        /* no more options to parse */
+        if(c == -1) break;
+
+        /* unrecognized option */
+        if(c == '?') {
+            help();
+            return 1;
+        }
+
+        switch(option_index) {
+        /* h, help */
+        case 0:
+        case 1:
+            help();
+            return 1;
+        /* c, cs */
+        case 2:
+        case 3:
+            cs = atoi(optarg);
+            break;
+        /* r, resolution */
+        case 4:
+        case 5:
+            parse_resolution_opt(optarg, &width, &height);
+            break;
+        /* t, timeout */
+        case 6:
+        case 7:
+            timeout = atoi(optarg);
+            break;
+        default:
+            help();
+            return 1;
+        }
+    }
+
+    if(cs < 0) {
+        IPRINT("the chip-select pin of the camera is missing\n");
+        help();
+        return 1;
+    }
+
+    for(i = 0; i < (int)LENGTH_OF(sensor_resolutions); i++) {
+        if(sensor_resolutions[i].width == width && sensor_resolutions[i].height == height)
+            break;
+    }
+    if(i == (int)LENGTH_OF(sensor_resolutions)) {
+        IPRINT("the camera does not support %dx%d\n", width, height);
+        return 1;
+    }
+    res = sensor_resolutions[i].res;
+
+    IPRINT("chip-select pin...: %d\n", cs);
+    IPRINT("resolution........: %d x %d\n", width, height);
+
+    pthread_mutex_lock(&bus_lock);
+
+    if(timeout > 0)
+        capture_timeout = timeout * 1000UL;
+
+    if(bus == NULL)
+        bus = new CameraBus();
+
+    streams[id] = new StreamInput(&pglobal->in[id]);
+    if((camera = bus->addCamera(cs, streams[id])) == NULL) {
+        delete streams[id];
+        streams[id] = NULL;
+        pthread_mutex_unlock(&bus_lock);
+        IPRINT("at most %d cameras share the bus\n", MAX_BUS_CAMERAS);
+        return 1;
+    }
+    cameras[id] = camera;
+    resolutions[id] = res;
+
+    pthread_mutex_unlock(&bus_lock);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: stops the thread that drives the bus, and with it every
+              camera on the bus
+Input Value.: the number of the input plugin is not needed
+Return Value: 0
+******************************************************************************/
+int input_stop(int)
+{
+    pthread_mutex_lock(&bus_lock);
+    if(running && !stopping) {
+        DBG("will cancel the bus thread\n");
+        stopping = 1;
+        pthread_cancel(worker);
+    }
+    pthread_mutex_unlock(&bus_lock);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: prepares a restart by the watchdog, the camera stays on the bus
+              while the bus thread is stopped, so there is nothing to open
+Input Value.: id is the number of the input plugin
+Return Value: 0 if the camera is still on the bus, -1 otherwise
+******************************************************************************/
+int input_restart(int id)
+{
+    int rc;
+
+    pthread_mutex_lock(&bus_lock);
+    rc = streams[id] != NULL ? 0 : -1;
+    pthread_mutex_unlock(&bus_lock);
+
+    return rc;
+}
+
+/******************************************************************************
+Description.: starts the thread that drives the bus, unless an input loaded
+              from this plugin already did
+Input Value.: id is the number of the input plugin
+Return Value: 0
+******************************************************************************/
+int input_run(int id)
+{
+    pthread_mutex_lock(&bus_lock);
+
+    if(!running) {
+        if(pthread_create(&worker, 0, worker_thread, NULL) != 0) {
+            pthread_mutex_unlock(&bus_lock);
+            fprintf(stderr, "could not start the bus thread of input %d\n", id);
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(worker);
+        running = 1;
+    }
+
+    pthread_mutex_unlock(&bus_lock);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: initializes the board and the cameras once, then captures all
+              cameras together until it gets cancelled
+Input Value.: unused
+Return Value: unused, always NULL
+******************************************************************************/
+static void *worker_thread(void *)
+{
+    int i;
+
+    /* set cleanup handler to cleanup allocated resources */
+    pthread_cleanup_push(worker_cleanup, NULL);
+
+    pthread_mutex_lock(&bus_lock);
+    bus->setCaptureTimeout(capture_timeout);
+    pthread_mutex_unlock(&bus_lock);
+
+    /* Camera::init() waits for the sensor, that can take a while */
+    if(!initialized) {
+        RPi4Board::boardInit();
+        bus->init();
+        for(i = 0; i < MAX_INPUT_PLUGINS; i++) {
+            if(cameras[i] != NULL && resolutions[i] != RES_320x240)
+                cameras[i]->setResolution((RESOLUTION)resolutions[i]);
+        }
+        initialized = 1;
+    }
+
+    while(!pglobal->stop) {
+        /* a camera that misses the timeout only loses this cycle */
+        if(bus->captureAll() < bus->getCameraCount()) {
+            DBG("a camera did not finish its exposure in time\n");
+        }
+
+        /* captureAll() polls the bus without any cancellation point */
+        pthread_testcancel();
+    }
+
+    IPRINT("leaving input thread, calling cleanup function now\n");
+    pthread_cleanup_pop(1);
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: cleans up once the bus thread ends, the cameras stay on the bus
+              for the next run unless the whole process is stopping
+Input Value.: arg is unused
+Return Value: -
+******************************************************************************/
+static void worker_cleanup(void *)
+{
+    int i;
+
+    /* input_run() waits here, so a new thread never meets this cleanup */
+    pthread_mutex_lock(&bus_lock);
+
+    for(i = 0; i < MAX_INPUT_PLUGINS; i++) {
+        if(streams[i] != NULL)
+            frame_ring_free(&pglobal->in[i]);
+    }
+
+    if(pglobal->stop) {
+        delete bus;
+        bus = NULL;
+        for(i = 0; i < MAX_INPUT_PLUGINS; i++) {
+            delete streams[i];
+            streams[i] = NULL;
+            cameras[i] = NULL;
+        }
+        initialized = 0;
+    }
+
+    running = 0;
+    stopping = 0;
+
+    pthread_mutex_unlock(&bus_lock);
+}
@@ -0,0 +1,42 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef INPUT_ARDUCAM_H_
+#define INPUT_ARDUCAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../../mjpg_streamer.h"
+#include "../../utils.h"
+
+int input_init(input_parameter* param, int id);
+int input_stop(int id);
+int input_run(int id);
+int input_restart(int id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INPUT_ARDUCAM_H_ */
@@ -55,6 +55,9 @@ static char *folder = NULL;
 static char *filename = NULL;
 static int rm = 0;
 static int plugin_number;
+
+/* reset by input_run(), so the watchdog can restart the plugin */
+static unsigned char first_run = 1;
 static read_mode mode = NewFilesOnly;
 
 /* global variables for this plugin */
@@ -184,10 +187,15 @@ int input_stop(int id)
     return 0;
 }
 
-int input_run(int id)
+/* the options stay parsed, input_run() sets up the watch again */
+int input_restart(int id)
 {
-    pglobal->in[id].buf = NULL;
+    return 0;
+}
 
+int input_run(int id)
+{
+    first_run = 1;
     if (mode == NewFilesOnly) {
         rc = fd = inotify_init();
         if(rc == -1) {
@@ -210,7 +218,6 @@ int input_run(int id)
     }
 
     if(pthread_create(&worker, 0, worker_thread, NULL) != 0) {
-        free(pglobal->in[id].buf);
         fprintf(stderr, "could not start worker thread\n");
         exit(EXIT_FAILURE);
     }
@@ -247,6 +254,7 @@ void *worker_thread(void *arg)
     int currentFileNumber = 0;
     char hasJpgFile = 0;
     struct timeval timestamp;
+    frame_slot *slot;
 
     if (mode == ExistingFiles) {
         fileCount = scandir(folder, &fileList, 0, alphasort);
@@ -329,35 +337,22 @@ void *worker_thread(void *arg)
 
         filesize = stats.st_size;
 
-        /* copy frame from file to global buffer */
-        pthread_mutex_lock(&pglobal->in[plugin_number].db);
-
-        /* allocate memory for frame */
-        if(pglobal->in[plugin_number].buf != NULL)
-            free(pglobal->in[plugin_number].buf);
-
-        pglobal->in[plugin_number].buf = malloc(filesize + (1 << 16));
-
-        if(pglobal->in[plugin_number].buf == NULL) {
-            fprintf(stderr, "could not allocate memory\n");
-            break;
-        }
-
-        if((pglobal->in[plugin_number].size = read(file, pglobal->in[plugin_number].buf, filesize)) == -1) {
+        /* copy frame from file to a free slot of the frame ring */
+        if((slot = frame_reserve(&pglobal->in[plugin_number], filesize)) == NULL) {
+            DBG("no free frame slot, dropping %s\n", buffer);
+        } else if((slot->size = read(file, slot->buf, filesize)) == -1) {
             perror("could not read from file");
-            free(pglobal->in[plugin_number].buf); pglobal->in[plugin_number].buf = NULL; pglobal->in[plugin_number].size = 0;
-            pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+            frame_cancel(&pglobal->in[plugin_number], slot);
             close(file);
             break;
+        } else {
+            gettimeofday(&timestamp, NULL);
+            slot->timestamp = timestamp;
+            DBG("new frame copied (size: %d)\n", slot->size);
+            /* signal fresh_frame */
+            frame_publish(&pglobal->in[plugin_number], slot);
         }
 
-        gettimeofday(&timestamp, NULL);
-        pglobal->in[plugin_number].timestamp = timestamp;
-        DBG("new frame copied (size: %d)\n", pglobal->in[plugin_number].size);
-        /* signal fresh_frame */
-        pthread_cond_broadcast(&pglobal->in[plugin_number].db_update);
-        pthread_mutex_unlock(&pglobal->in[plugin_number].db);
-
         close(file);
 
         /* delete file if necessary */
@@ -387,8 +382,6 @@ thread_quit:
 
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
     if(!first_run) {
         DBG("already cleaned up resources\n");
         return;
@@ -397,7 +390,7 @@ void worker_cleanup(void *arg)
     first_run = 0;
     DBG("cleaning up resources allocated by input thread\n");
 
-    if(pglobal->in[plugin_number].buf != NULL) free(pglobal->in[plugin_number].buf);
+    frame_ring_free(&pglobal->in[plugin_number]);
 
     free(ev);
 
@@ -46,6 +46,9 @@ static globals     *pglobal;
 static pthread_mutex_t controls_mutex;
 static int plugin_number;
 
+/* reset by input_run(), so the watchdog can restart the plugin */
+static unsigned char first_run = 1;
+
 void *worker_thread(void *);
 void worker_cleanup(void *);
 
@@ -103,6 +106,23 @@ int input_stop(int id)
     return 0;
 }
 
+/******************************************************************************
+Description.: parses the host and port again, the cleanup of the last run
+              freed them
+Input Value.: id is the number of the input plugin
+Return Value: 0 if ok, -1 otherwise
+******************************************************************************/
+int input_restart(int id)
+{
+    init_mjpg_proxy(&proxy);
+
+    reset_getopt();
+    if(parse_cmd_line(&proxy, pglobal->in[id].param.argc, pglobal->in[id].param.argv))
+        return -1;
+
+    return 0;
+}
+
 /******************************************************************************
 Description.: starts the worker thread and allocates memory
 Input Value.: -
@@ -110,14 +130,8 @@ Return Value: 0
 ******************************************************************************/
 int input_run(int id)
 {
-    pglobal->in[id].buf = malloc(256 * 1024);
-    if(pglobal->in[id].buf == NULL) {
-        fprintf(stderr, "could not allocate memory\n");
-        exit(EXIT_FAILURE);
-    }
-
+    first_run = 1;
     if(pthread_create(&worker, 0, worker_thread, NULL) != 0) {
-        free(pglobal->in[id].buf);
         fprintf(stderr, "could not start worker thread\n");
         exit(EXIT_FAILURE);
     }
@@ -128,15 +142,17 @@ int input_run(int id)
 
 
 void on_image_received(char * data, int length){
-        /* copy JPG picture to global buffer */
-        pthread_mutex_lock(&pglobal->in[plugin_number].db);
+        frame_slot *slot;
+
+        /* copy JPG picture to a free slot of the frame ring */
+        if((slot = frame_reserve(&pglobal->in[plugin_number], length)) == NULL)
+            return;
 
-        pglobal->in[plugin_number].size = length;
-        memcpy(pglobal->in[plugin_number].buf, data, pglobal->in[plugin_number].size);
+        slot->size = length;
+        memcpy(slot->buf, data, slot->size);
 
         /* signal fresh_frame */
-        pthread_cond_broadcast(&pglobal->in[plugin_number].db_update);
-        pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+        frame_publish(&pglobal->in[plugin_number], slot);
 
 }
 
@@ -163,8 +179,6 @@ Return Value: -
 ******************************************************************************/
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
     if(!first_run) {
         DBG("already cleaned up resources\n");
         return;
@@ -173,7 +187,7 @@ void worker_cleanup(void *arg)
     first_run = 0;
     DBG("cleaning up resources allocated by input thread\n");
     close_mjpg_proxy(&proxy);
-    if(pglobal->in[plugin_number].buf != NULL) free(pglobal->in[plugin_number].buf);
+    frame_ring_free(&pglobal->in[plugin_number]);
 }
 
 
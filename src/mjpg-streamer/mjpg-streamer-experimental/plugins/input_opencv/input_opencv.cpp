@@ -66,6 +66,7 @@ typedef struct {
     filter_process_fn filter_process;
     filter_free_fn filter_free;
     
+    int ondemand;
 } context;
 
 
@@ -96,6 +97,7 @@ static void help() {
     fprintf(stderr,
     " [-f | --fps ]..........: frames per second\n" \
     " [-q | --quality ] .....: set quality of JPEG encoding\n" \
+    " [-ondemand ]...........: only read and encode frames while an output needs them\n" \
     " ---------------------------------------------------------------\n" \
     " Optional parameters (may not be supported by all cameras):\n\n"
     " [-br ].................: Set image brightness (integer)\n"\
@@ -180,6 +182,7 @@ int input_init(input_parameter *param, int plugin_no)
             {"ex", required_argument, 0, 0},
             {"filter", required_argument, 0, 0},
             {"fargs", required_argument, 0, 0},
+            {"ondemand", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
     
@@ -243,6 +246,11 @@ int input_init(input_parameter *param, int plugin_no)
             filter_args = optarg;
             break;
             
+        /* ondemand */
+        case 17:
+            pctx->ondemand = 1;
+            break;
+            
         default:
             help();
             return 1;
@@ -251,6 +259,8 @@ int input_init(input_parameter *param, int plugin_no)
 
     IPRINT("device........... : %s\n", device);
     IPRINT("Desired Resolution: %i x %i\n", width, height);
+    if (pctx->ondemand)
+        IPRINT("capture.......... : on demand\n");
     
     // need to allocate a VideoCapture object: default device is 0
     try {
@@ -361,9 +371,6 @@ int input_run(int id)
     input * in = &pglobal->in[id];
     context *pctx = (context*)in->context;
     
-    in->buf = NULL;
-    in->size = 0;
-    
     if(pthread_create(&pctx->worker, 0, worker_thread, in) != 0) {
         worker_cleanup(in);
         fprintf(stderr, "could not start worker thread\n");
@@ -414,6 +421,8 @@ void *worker_thread(void *arg)
     
     Mat src, dst;
     vector<uchar> jpeg_buffer;
+    frame_slot *slot;
+    unsigned long long next_due = 0;
     
     // this exists so that the numpy allocator can assign a custom allocator to
     // the mat, so that it doesn't need to copy the data each time
@@ -421,27 +430,43 @@ void *worker_thread(void *arg)
         src = pctx->filter_init_frame(pctx->filter_ctx);
     
     while (!pglobal->stop) {
+        if (pctx->ondemand) {
+            /* nobody needs frames, stop reading the camera until someone does */
+            if (frame_demand(in) == DEMAND_NONE) {
+                frame_wait_demand(in);
+                next_due = 0;
+            }
+            
+            /* keep the camera queue moving, but skip decoding and encoding */
+            if (!frame_wanted(in, &next_due)) {
+                if (!pctx->capture.grab())
+                    break;
+                continue;
+            }
+        }
+        
         if (!pctx->capture.read(src))
             break; // TODO
             
         // call the filter function
         pctx->filter_process(pctx->filter_ctx, src, dst);
             
-        /* copy JPG picture to global buffer */
-        pthread_mutex_lock(&in->db);
-        
         // take whatever Mat it returns, and write it to jpeg buffer
         imencode(".jpg", dst, jpeg_buffer, compression_params);
         
         // TODO: what to do if imencode returns an error?
         
+        /* copy JPG picture to a free slot of the frame ring */
+        slot = frame_reserve(in, jpeg_buffer.size());
+        if (slot == NULL)
+            continue;
+        
         // std::vector is guaranteed to be contiguous
-        in->buf = &jpeg_buffer[0];
-        in->size = jpeg_buffer.size();
+        slot->size = jpeg_buffer.size();
+        memcpy(slot->buf, &jpeg_buffer[0], slot->size);
         
         /* signal fresh_frame */
-        pthread_cond_broadcast(&in->db_update);
-        pthread_mutex_unlock(&in->db);
+        frame_publish(in, slot);
     }
     
     IPRINT("leaving input thread, calling cleanup function now\n");
@@ -458,6 +483,7 @@ Return Value: -
 void worker_cleanup(void *arg)
 {
     input * in = (input*)arg;
+    frame_ring_free(in);
     if (in->context != NULL) {
         context *pctx = (context*)in->context;
         
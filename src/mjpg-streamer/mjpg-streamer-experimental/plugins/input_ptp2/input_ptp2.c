@@ -208,7 +208,6 @@ int input_run(int id)
 	// starting thread
 	if(pthread_create(&thread, 0, capture, NULL) != 0)
 	{
-		free(global->in[id].buf);
 		IPRINT("could not start worker thread\n");
 		exit(EXIT_FAILURE);
 	}
@@ -222,14 +221,7 @@ void* capture(void* arg)
 	int res;
 	int i = 0;
 	CameraFile* file;
-
-	int jpeg_buffer_size = 256 * 1024;
-	global->in[plugin_id].buf = malloc(jpeg_buffer_size);
-	if(global->in[plugin_id].buf == NULL)
-	{
-		IPRINT(INPUT_PLUGIN_NAME " - could not allocate memory\n");
-		return NULL;
-	}
+	frame_slot *slot;
 
 	pthread_cleanup_push(cleanup, NULL);
 					while(!global->stop)
@@ -241,7 +233,6 @@ void* capture(void* arg)
 						CAMERA_CHECK_GP(res, "gp_file_new");
 						res = gp_camera_capture_preview(camera, file, context);
 						CAMERA_CHECK_GP(res, "gp_camera_capture_preview");
-						pthread_mutex_lock(&global->in[plugin_id].db);
 						res = gp_file_get_data_and_size(file, &xdata, &xsize);
 						if(xsize == 0)
 						{
@@ -261,26 +252,18 @@ void* capture(void* arg)
 							i = 0;
 						CAMERA_CHECK_GP(res, "gp_file_get_data_and_size");
 
-						if(jpeg_buffer_size <= xsize) {
-							jpeg_buffer_size = xsize + xsize * 10/100;
-							unsigned char *tmp_buff = realloc(global->in[plugin_id].buf,jpeg_buffer_size);
-							if(tmp_buff == NULL)
-							{
-								IPRINT(INPUT_PLUGIN_NAME " - could not allocate memory\n");
-								return NULL;
-							}
-							global->in[plugin_id].buf = tmp_buff;
+						/* copy JPG picture to a free slot of the frame ring */
+						slot = frame_reserve(&global->in[plugin_id], xsize);
+						if(slot != NULL)
+						{
+							memcpy(slot->buf, xdata, xsize);
+							slot->size = xsize;
+							DBG("Read %d bytes from camera.\n", slot->size);
+							frame_publish(&global->in[plugin_id], slot);
 						}
-
-
-						memcpy(global->in[plugin_id].buf, xdata, xsize);
 						res = gp_file_unref(file);
 						pthread_mutex_unlock(&control_mutex);
 						CAMERA_CHECK_GP(res, "gp_file_unref");
-						global->in[plugin_id].size = xsize;
-						DBG("Read %d bytes from camera.\n", global->in[plugin_id].size);
-						pthread_cond_broadcast(&global->in[plugin_id].db_update);
-						pthread_mutex_unlock(&global->in[plugin_id].db);
 						usleep(delay);
 					}
 					pthread_cleanup_pop(1);
@@ -317,7 +300,7 @@ void cleanup(void *arg)
 	gp_camera_exit(camera, context);
 	gp_camera_unref(camera);
 	gp_context_unref(context);
-	free(global->in[plugin_id].buf);
+	frame_ring_free(&global->in[plugin_id]);
 }
 
 int input_cmd(int plugin, unsigned int control_id, unsigned int group, int value)
@@ -50,11 +50,15 @@ static globals     *pglobal;
 static pthread_mutex_t controls_mutex;
 static int plugin_number;
 
+/* reset by input_run(), so the watchdog can restart the plugin */
+static unsigned char first_run = 1;
+
 void *worker_thread(void *);
 void worker_cleanup(void *);
 void help(void);
 
 static int delay = 1000;
+static int ondemand = 0;
 
 /* details of converted JPG pictures */
 struct pic {
@@ -112,6 +116,7 @@ int input_init(input_parameter *param, int plugin_no)
             {"delay", required_argument, 0, 0},
             {"r", required_argument, 0, 0},
             {"resolution", required_argument, 0, 0},
+            {"ondemand", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -154,6 +159,12 @@ int input_init(input_parameter *param, int plugin_no)
             }
             break;
 
+            /* ondemand */
+        case 6:
+            DBG("case 6\n");
+            ondemand = 1;
+            break;
+
         default:
             DBG("default case\n");
             help();
@@ -165,6 +176,7 @@ int input_init(input_parameter *param, int plugin_no)
 
     IPRINT("delay.............: %i\n", delay);
     IPRINT("resolution........: %s\n", pics->resolution);
+    IPRINT("capture...........: %s\n", ondemand ? "on demand" : "always");
 
     return 0;
 }
@@ -182,6 +194,16 @@ int input_stop(int id)
     return 0;
 }
 
+/******************************************************************************
+Description.: prepares a restart, the pictures and options are kept
+Input Value.: id is the number of the input plugin
+Return Value: 0
+******************************************************************************/
+int input_restart(int id)
+{
+    return 0;
+}
+
 /******************************************************************************
 Description.: starts the worker thread and allocates memory
 Input Value.: -
@@ -189,14 +211,8 @@ Return Value: 0
 ******************************************************************************/
 int input_run(int id)
 {
-    pglobal->in[id].buf = malloc(256 * 1024);
-    if(pglobal->in[id].buf == NULL) {
-        fprintf(stderr, "could not allocate memory\n");
-        exit(EXIT_FAILURE);
-    }
-
+    first_run = 1;
     if(pthread_create(&worker, 0, worker_thread, NULL) != 0) {
-        free(pglobal->in[id].buf);
         fprintf(stderr, "could not start worker thread\n");
         exit(EXIT_FAILURE);
     }
@@ -218,6 +234,7 @@ void help(void)
     " The following parameters can be passed to this plugin:\n\n" \
     " [-d | --delay ]........: delay to pause between frames\n" \
     " [-r | --resolution]....: can be 960x720, 640x480, 320x240, 160x120\n"
+    " [-ondemand ]...........: only produce frames while an output needs them\n"
     " ---------------------------------------------------------------\n");
 }
 
@@ -230,22 +247,35 @@ Return Value: NULL
 void *worker_thread(void *arg)
 {
     int i = 0;
+    unsigned long long next_due = 0;
+    frame_slot *slot;
 
     /* set cleanup handler to cleanup allocated resources */
     pthread_cleanup_push(worker_cleanup, NULL);
 
     while(!pglobal->stop) {
 
-        /* copy JPG picture to global buffer */
-        pthread_mutex_lock(&pglobal->in[plugin_number].db);
+        /* sleep until an output needs frames */
+        if(ondemand && frame_demand(&pglobal->in[plugin_number]) == DEMAND_NONE) {
+            frame_wait_demand(&pglobal->in[plugin_number]);
+            next_due = 0;
+        }
 
         i = (i + 1) % LENGTH_OF(pics->sequence);
-        pglobal->in[plugin_number].size = pics->sequence[i].size;
-        memcpy(pglobal->in[plugin_number].buf, pics->sequence[i].data, pglobal->in[plugin_number].size);
 
-        /* signal fresh_frame */
-        pthread_cond_broadcast(&pglobal->in[plugin_number].db_update);
-        pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+        if(ondemand && !frame_wanted(&pglobal->in[plugin_number], &next_due)) {
+            usleep(1000 * delay);
+            continue;
+        }
+
+        /* copy JPG picture to a free slot of the frame ring */
+        if((slot = frame_reserve(&pglobal->in[plugin_number], pics->sequence[i].size)) != NULL) {
+            slot->size = pics->sequence[i].size;
+            memcpy(slot->buf, pics->sequence[i].data, slot->size);
+
+            /* signal fresh_frame */
+            frame_publish(&pglobal->in[plugin_number], slot);
+        }
 
         usleep(1000 * delay);
     }
@@ -263,8 +293,6 @@ Return Value: -
 ******************************************************************************/
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
     if(!first_run) {
         DBG("already cleaned up resources\n");
         return;
@@ -273,7 +301,7 @@ void worker_cleanup(void *arg)
     first_run = 0;
     DBG("cleaning up resources allocated by input thread\n");
 
-    if(pglobal->in[plugin_number].buf != NULL) free(pglobal->in[plugin_number].buf);
+    frame_ring_free(&pglobal->in[plugin_number]);
 }
 
 
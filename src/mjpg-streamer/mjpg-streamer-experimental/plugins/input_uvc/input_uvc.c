@@ -76,6 +76,7 @@ static struct timeval timestamp;
 static int softfps = -1;
 static unsigned int timeout = 5;
 static unsigned int dv_timings = 0;
+static int ondemand = 0;
 
 static const struct {
   const char * k;
@@ -100,6 +101,7 @@ void *cam_thread(void *);
 void cam_cleanup(void *);
 void help(void);
 int input_cmd(int plugin, unsigned int control, unsigned int group, int value, char *value_string);
+int input_restart(int id);
 
 const char *get_name_by_tvnorm(v4l2_std_id vstd) {
 	int i;
@@ -215,6 +217,7 @@ int input_init(input_parameter *param, int id)
             {"softfps", required_argument, 0, 0},
             {"timeout", required_argument, 0, 0},
             {"dv_timings", no_argument, 0, 0},
+            {"ondemand", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -385,6 +388,10 @@ int input_init(input_parameter *param, int id)
             DBG("case 42\n");
             dv_timings = 1;
             break;
+        case 43:
+            DBG("case 43\n");
+            ondemand = 1;
+            break;
        default:
            DBG("default case\n");
            help();
@@ -449,10 +456,21 @@ int input_init(input_parameter *param, int id)
         exit(EXIT_FAILURE);
     }
 
+    pctx->device = dev;
+    pctx->width = width;
+    pctx->height = height;
+    pctx->fps = fps;
+    pctx->format = format;
+    pctx->tvnorm = tvnorm;
+
     if (softfps > 0) {
         IPRINT("Framedrop FPS.....: %d\n", softfps);
     }
 
+    if (ondemand) {
+        IPRINT("Capture...........: on demand\n");
+    }
+
     /*
      * recent linux-uvc driver (revision > ~#125) requires to use dynctrls
      * for pan/tilt/focus/...
@@ -491,12 +509,6 @@ int input_run(int id)
     input * in = &pglobal->in[id];
     context *pctx = (context*)in->context;
     
-    in->buf = malloc(pctx->videoIn->framesizeIn);
-    if(in->buf == NULL) {
-        fprintf(stderr, "could not allocate memory\n");
-        exit(EXIT_FAILURE);
-    }
-
     DBG("launching camera thread #%02d\n", id);
     /* create thread and pass context to thread function */
     pthread_create(&(pctx->threadID), NULL, cam_thread, in);
@@ -504,6 +516,38 @@ int input_run(int id)
     return 0;
 }
 
+/******************************************************************************
+Description.: opens the device again after the camera thread ended, the
+              formats and controls found by input_init() are kept
+Input Value.: id is the number of the input plugin
+Return Value: 0 if ok, -1 if the device could not be opened
+******************************************************************************/
+int input_restart(int id)
+{
+    input * in = &pglobal->in[id];
+    context *pctx = (context*)in->context;
+
+    DBG("reopening %s for input %d\n", pctx->device, id);
+    pctx->videoIn = calloc(1, sizeof(struct vdIn));
+    if(pctx->videoIn == NULL) {
+        IPRINT("not enough memory for videoIn\n");
+        return -1;
+    }
+
+    pctx->videoIn->dv_timings = dv_timings;
+    if(open_videoIn(pctx->videoIn, pctx->device, pctx->width, pctx->height, pctx->fps, pctx->format, 1, pctx->tvnorm) < 0) {
+        IPRINT("could not open %s again\n", pctx->device);
+        free(pctx->videoIn);
+        pctx->videoIn = NULL;
+        return -1;
+    }
+
+    if(dynctrls)
+        initDynCtrls(pctx->videoIn->fd);
+
+    return 0;
+}
+
 /*** private functions for this plugin below ***/
 /******************************************************************************
 Description.: print a help message to stderr
@@ -546,6 +590,8 @@ void help(void)
     "                          set your camera to its maximum fps to avoid stuttering\n" \
     " [-timeout] ............: Timeout for device querying (seconds)\n" \
     " [-dv_timings] .........: Enable DV timings queriyng and events processing\n" \
+    " [-ondemand] ...........: Stop the camera while no output needs frames and\n" \
+    "                          only encode as many frames as the outputs ask for\n" \
     " ---------------------------------------------------------------\n");
 
     fprintf(stderr, "\n"\
@@ -581,7 +627,20 @@ void *cam_thread(void *arg)
     
     unsigned int every_count = 0;
     int quality = settings->quality;
-    
+    frame_trace trace = {0};
+    struct timeval last_timestamp = {0};
+    unsigned long long next_due = 0;
+    frame_slot *slot;
+    #ifndef NO_LIBJPEG
+    char labels[32];
+    metric *encode_time;
+    unsigned long long encode_start;
+
+    snprintf(labels, sizeof(labels), "input=\"%d\"", pcontext->id);
+    encode_time = metric_histogram("mjpg_encode_microseconds", labels,
+                                   "Time spent compressing raw frames to JPEG.");
+    #endif
+
     /* set cleanup handler to cleanup allocated resources */
     pthread_cleanup_push(cam_cleanup, in);
     
@@ -653,10 +712,8 @@ void *cam_thread(void *arg)
             V4L_OPT_SET(V4L2_CID_HUE, cagc, "color balance")
         }
     }
-    
-    free(settings);
-    settings = NULL;
-    pcontext->init_settings = NULL;
+
+    /* the settings stay, a restart applies them to the device again */
 
     if (softfps > 0) {
         pcontext->videoIn->soft_framedrop = 1;
@@ -673,6 +730,18 @@ void *cam_thread(void *arg)
             usleep(1); // maybe not the best way so FIXME
         }
 
+        /* nobody watches or records, switch the camera off until someone does */
+        if (ondemand && frame_demand(in) == DEMAND_NONE) {
+            DBG("no demand for frames, stopping the stream\n");
+            if (video_pause(pcontext->videoIn) < 0)
+                goto endloop;
+            frame_wait_demand(in);
+            DBG("frames are needed again, restarting the stream\n");
+            if (video_resume(pcontext->videoIn) < 0)
+                goto endloop;
+            next_due = 0;
+        }
+
         fd_set rd_fds; // for capture
         fd_set ex_fds; // for capture
         fd_set wr_fds; // for output
@@ -719,6 +788,12 @@ void *cam_thread(void *arg)
                 goto endloop;
             }
 
+            /* the buffer timestamp is only comparable if the driver uses our clock */
+            trace.drained = latency_now();
+            trace.capture_done = 0;
+            if((pcontext->videoIn->buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+                trace.capture_done = latency_timeval(&pcontext->videoIn->buf.timestamp);
+
             if ( every_count < every - 1 ) {
                 DBG("dropping %d frame for every=%d\n", every_count + 1, every);
                 ++every_count;
@@ -751,8 +826,8 @@ void *cam_thread(void *arg)
 
             // use software frame dropping on low fps
             if (pcontext->videoIn->soft_framedrop == 1) {
-                unsigned long last = pglobal->in[pcontext->id].timestamp.tv_sec * 1000 +
-                                    (pglobal->in[pcontext->id].timestamp.tv_usec/1000); // convert to ms
+                unsigned long last = last_timestamp.tv_sec * 1000 +
+                                    (last_timestamp.tv_usec/1000); // convert to ms
                 unsigned long current = pcontext->videoIn->tmptimestamp.tv_sec * 1000 +
                                         pcontext->videoIn->tmptimestamp.tv_usec/1000; // convert to ms
 
@@ -764,8 +839,17 @@ void *cam_thread(void *arg)
                 DBG("Lagg: %ld\n", (current - last) - pcontext->videoIn->frame_period_time);
             }
 
-            /* copy JPG picture to global buffer */
-            pthread_mutex_lock(&pglobal->in[pcontext->id].db);
+            /* skip frames no output asks for before spending time on them */
+            if (ondemand && !frame_wanted(in, &next_due)) {
+                DBG("no output needs this frame\n");
+                goto other_select_handlers;
+            }
+
+            /* copy JPG picture to a free slot of the frame ring */
+            if((slot = frame_reserve(in, pcontext->videoIn->framesizeIn)) == NULL) {
+                DBG("no free frame slot, dropping frame\n");
+                goto other_select_handlers;
+            }
 
             /*
              * If capturing in YUV mode convert to JPEG now.
@@ -778,15 +862,17 @@ void *cam_thread(void *arg)
             (pcontext->videoIn->formatIn == V4L2_PIX_FMT_UYVY) ||
             (pcontext->videoIn->formatIn == V4L2_PIX_FMT_RGB565) ) {
                 DBG("compressing frame from input: %d\n", (int)pcontext->id);
-                pglobal->in[pcontext->id].size = compress_image_to_jpeg(pcontext->videoIn, pglobal->in[pcontext->id].buf, pcontext->videoIn->framesizeIn, quality);
+                encode_start = latency_now();
+                slot->size = compress_image_to_jpeg(pcontext->videoIn, slot->buf, pcontext->videoIn->framesizeIn, quality);
+                metric_observe(encode_time, latency_now() - encode_start);
                 /* copy this frame's timestamp to user space */
-                pglobal->in[pcontext->id].timestamp = pcontext->videoIn->tmptimestamp;
+                slot->timestamp = pcontext->videoIn->tmptimestamp;
             } else {
             #endif
                 DBG("copying frame from input: %d\n", (int)pcontext->id);
-                pglobal->in[pcontext->id].size = memcpy_picture(pglobal->in[pcontext->id].buf, pcontext->videoIn->tmpbuffer, pcontext->videoIn->tmpbytesused);
+                slot->size = memcpy_picture(slot->buf, pcontext->videoIn->tmpbuffer, pcontext->videoIn->tmpbytesused);
                 /* copy this frame's timestamp to user space */
-                pglobal->in[pcontext->id].timestamp = pcontext->videoIn->tmptimestamp;
+                slot->timestamp = pcontext->videoIn->tmptimestamp;
             #ifndef NO_LIBJPEG
             }
             #endif
@@ -799,9 +885,11 @@ void *cam_thread(void *arg)
             prev_size = global->size;
 #endif
 
+            slot->trace = trace;
+            last_timestamp = slot->timestamp;
+
             /* signal fresh_frame */
-            pthread_cond_broadcast(&pglobal->in[pcontext->id].db_update);
-            pthread_mutex_unlock(&pglobal->in[pcontext->id].db);
+            frame_publish(in, slot);
         }
 
 other_select_handlers:
@@ -847,9 +935,7 @@ void cam_cleanup(void *arg)
         pctx->videoIn = NULL;
     }
     
-    free(in->buf);
-    in->buf = NULL;
-    in->size = 0;
+    frame_ring_free(in);
 }
 
 /******************************************************************************
@@ -868,6 +954,13 @@ int input_cmd(int plugin_number, unsigned int control_id, unsigned int group, in
     int ret = -1;
     int i = 0;
     DBG("Requested cmd (id: %d) for the %d plugin. Group: %d value: %d\n", control_id, plugin_number, group, value);
+
+    /* the camera thread ended and the watchdog did not open the device yet */
+    if(pctx->videoIn == NULL && group != IN_CMD_GENERIC) {
+        DBG("the device of input %d is closed\n", plugin_number);
+        return -1;
+    }
+
     switch(group) {
     case IN_CMD_GENERIC: {
             int i;
@@ -902,6 +995,8 @@ int input_cmd(int plugin_number, unsigned int control_id, unsigned int group, in
         ret = setResolution(pctx->videoIn, width, height);
         if(ret == 0) {
             in->in_formats[in->currentFormat].currentResolution = value;
+            pctx->width = width;
+            pctx->height = height;
         }
         return ret;
     } break;
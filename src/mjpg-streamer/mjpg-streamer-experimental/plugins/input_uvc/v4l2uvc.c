@@ -90,8 +90,11 @@ static int init_v4l2(struct vdIn *vd);
 static int init_framebuffer(struct vdIn *vd);
 static void free_framebuffer(struct vdIn *vd);
 
-int init_videoIn(struct vdIn *vd, char *device, int width,
-                 int height, int fps, int format, int grabmethod, globals *pglobal, int id, v4l2_std_id vstd)
+/* opens the device and allocates the buffers, it does not touch the input
+ * plugin so it may run again once close_v4l2() closed the device
+ */
+int open_videoIn(struct vdIn *vd, char *device, int width,
+                 int height, int fps, int format, int grabmethod, v4l2_std_id vstd)
 {
     if(vd == NULL || device == NULL)
         return -1;
@@ -121,6 +124,29 @@ int init_videoIn(struct vdIn *vd, char *device, int width,
         goto error;
     }
 
+    if (init_framebuffer(vd) < 0) {
+        goto error;
+    }
+
+    return 0;
+error:
+    free_framebuffer(vd);
+    free(vd->videodevice);
+    free(vd->status);
+    free(vd->pictName);
+    vd->videodevice = NULL;
+    vd->status = NULL;
+    vd->pictName = NULL;
+    CLOSE_VIDEO(vd->fd);
+    return -1;
+}
+
+int init_videoIn(struct vdIn *vd, char *device, int width,
+                 int height, int fps, int format, int grabmethod, globals *pglobal, int id, v4l2_std_id vstd)
+{
+    if(open_videoIn(vd, device, width, height, fps, format, grabmethod, vstd) < 0)
+        return -1;
+
     // getting the name of the input source
     struct v4l2_input in_struct;
     memset(&in_struct, 0, sizeof(struct v4l2_input));
@@ -212,19 +238,7 @@ int init_videoIn(struct vdIn *vd, char *device, int width,
         }
     }
 
-    if (init_framebuffer(vd) < 0) {
-        goto error;
-    }
-
     return 0;
-error:
-    free_framebuffer(vd);
-    free(pglobal->in[id].in_parameters);
-    free(vd->videodevice);
-    free(vd->status);
-    free(vd->pictName);
-    CLOSE_VIDEO(vd->fd);
-    return -1;
 }
 
 static int init_framebuffer(struct vdIn *vd) {
@@ -509,6 +523,34 @@ static int video_disable(struct vdIn *vd, streaming_state disabledState)
     return 0;
 }
 
+/*
+ * Stops the stream while no output needs frames. STREAMOFF hands all
+ * buffers back, so video_resume() has to queue them again.
+ */
+int video_pause(struct vdIn *vd)
+{
+    return video_disable(vd, STREAMING_OFF);
+}
+
+int video_resume(struct vdIn *vd)
+{
+    int i, ret;
+
+    for(i = 0; i < NB_BUFFER; ++i) {
+        memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
+        vd->buf.index = i;
+        vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        vd->buf.memory = V4L2_MEMORY_MMAP;
+        ret = xioctl(vd->fd, VIDIOC_QBUF, &vd->buf);
+        if(ret < 0) {
+            perror("Unable to queue buffer");
+            return ret;
+        }
+    }
+
+    return video_enable(vd);
+}
+
 int video_set_dv_timings(struct vdIn *vd)
 {
     struct v4l2_dv_timings timings;
@@ -681,8 +723,20 @@ err:
 
 int close_v4l2(struct vdIn *vd)
 {
+    int i;
+
     if(vd->streamingState == STREAMING_ON)
         video_disable(vd, STREAMING_OFF);
+
+    /* release the buffers of the driver, so the device can be opened again */
+    for(i = 0; i < NB_BUFFER; i++) {
+        if(vd->mem[i] != NULL && vd->mem[i] != MAP_FAILED)
+            munmap(vd->mem[i], vd->buf.length);
+        vd->mem[i] = NULL;
+    }
+    CLOSE_VIDEO(vd->fd);
+    vd->fd = -1;
+
     free_framebuffer(vd);
     free(vd->videodevice);
     free(vd->status);
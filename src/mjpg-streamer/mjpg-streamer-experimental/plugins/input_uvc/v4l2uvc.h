@@ -144,8 +144,14 @@ typedef struct {
     pthread_mutex_t controls_mutex;
     struct vdIn *videoIn;
     context_settings *init_settings;
+
+    /* what the device was opened with, input_restart() opens it again */
+    char *device;
+    int width, height, fps, format;
+    v4l2_std_id tvnorm;
 } context;
 
+int open_videoIn(struct vdIn *vd, char *device, int width, int height, int fps, int format, int grabmethod, v4l2_std_id vstd);
 int init_videoIn(struct vdIn *vd, char *device, int width, int height, int fps, int format, int grabmethod, globals *pglobal, int id, v4l2_std_id vstd);
 void enumerateControls(struct vdIn *vd, globals *pglobal, int id);
 void control_readed(struct vdIn *vd, struct v4l2_queryctrl *ctrl, globals *pglobal, int id);
@@ -156,6 +162,8 @@ int uvcGrab(struct vdIn *vd);
 int close_v4l2(struct vdIn *vd);
 
 int video_enable(struct vdIn *vd);
+int video_pause(struct vdIn *vd);
+int video_resume(struct vdIn *vd);
 int video_set_dv_timings(struct vdIn *vd);
 int video_handle_event(struct vdIn *vd);
 
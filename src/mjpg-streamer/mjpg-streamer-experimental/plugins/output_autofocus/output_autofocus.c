@@ -49,7 +49,7 @@
 static pthread_t worker;
 static globals *pglobal;
 static int fd, delay;
-static unsigned char *frame = NULL;
+static frame_consumer consumer;
 static int input_number;
 
 /******************************************************************************
@@ -84,7 +84,7 @@ void worker_cleanup(void *arg)
     first_run = 0;
     OPRINT("cleaning up resources allocated by worker thread\n");
 
-    free(frame);
+    consumer_free(&consumer);
     close(fd);
 }
 
@@ -99,27 +99,25 @@ Return Value:
 void *worker_thread(void *arg)
 {
     int frame_size = 0;
+    unsigned char *frame;
     double sv = -1.0, max_sv = 100.0, delta = 500;
     int focus = 255, step = 10, max_focus = 100, search_focus = 1;
 
-    if((frame = malloc(256 * 1024)) == NULL) {
-        OPRINT("not enough memory for worker thread\n");
-        exit(EXIT_FAILURE);
-    }
+    consumer_init(&consumer, &pglobal->in[input_number], CONSUME_LATEST, 0);
 
     /* set cleanup handler to cleanup allocated resources */
     pthread_cleanup_push(worker_cleanup, NULL);
 
     while(!pglobal->stop) {
         DBG("waiting for fresh frame\n");
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        if(consumer_next(&consumer) < 0) {
+            OPRINT("not enough memory for worker thread\n");
+            exit(EXIT_FAILURE);
+        }
 
         /* read buffer */
-        frame_size = pglobal->in[input_number].size;
-        memcpy(frame, pglobal->in[input_number].buf, frame_size);
-
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
+        frame = consumer.buf;
+        frame_size = consumer.size;
 
         /* process frame */
         sv = getFrameSharpnessValue(frame, frame_size);
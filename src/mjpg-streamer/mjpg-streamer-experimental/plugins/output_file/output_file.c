@@ -46,13 +46,16 @@
 
 static pthread_t worker;
 static globals *pglobal;
-static int fd, delay, ringbuffer_size = -1, ringbuffer_exceed = 0, max_frame_size;
+static int fd, delay, ringbuffer_size = -1, ringbuffer_exceed = 0;
 static char *folder = "/tmp";
-static unsigned char *frame = NULL;
+static frame_consumer consumer;
+static consumer_policy policy = CONSUME_LATEST;
+static int policy_param = 0;
 static char *command = NULL;
 static int input_number = 0;
 static char *mjpgFileName = NULL;
 static char *linkFileName = NULL;
+static int dedup = 0;
 
 /******************************************************************************
 Description.: print a help message
@@ -70,7 +73,10 @@ void help(void)
             " [-l | --link ]..........: link the last picture in ringbuffer as this fixed named file\n" \
             " [-d | --delay ].........: delay after saving pictures in ms\n" \
             " [-i | --input ].........: read frames from the specified input plugin\n" \
+            " [--policy ].............: latest, every[:queue length] or fps:rate\n" \
             " The following arguments are takes effect only if the current mode is not MJPG\n" \
+            " [--dedup ]..............: do not save unchanged frames again, link the\n" \
+            "                           previous picture instead\n" \
             " [-s | --size ]..........: size of ring buffer (max number of pictures to hold)\n" \
             " [-e | --exceed ]........: allow ringbuffer to exceed limit by this amount\n" \
             " [-c | --command ].......: execute command after saving picture\n"\
@@ -98,9 +104,7 @@ void worker_cleanup(void *arg)
     first_run = 0;
     OPRINT("cleaning up resources allocated by worker thread\n");
 
-    if(frame != NULL) {
-        free(frame);
-    }
+    consumer_free(&consumer);
     close(fd);
 }
 
@@ -203,12 +207,14 @@ Return Value:
 ******************************************************************************/
 void *worker_thread(void *arg)
 {
-    int ok = 1, frame_size = 0, rc = 0;
-    char buffer1[1024] = {0}, buffer2[1024] = {0};
-    unsigned long long counter = 0;
+    int ok = 1, frame_size = 0, rc = 0, last_size = -1;
+    char buffer1[1024] = {0}, buffer2[1024] = {0}, last_file[1024] = {0};
+    unsigned long long counter = 0, last_hash = 0;
     time_t t;
     struct tm *now;
-    unsigned char *tmp_framebuffer = NULL;
+    unsigned char *frame;
+
+    consumer_init(&consumer, &pglobal->in[input_number], policy, policy_param);
 
     /* set cleanup handler to cleanup allocated resources */
     pthread_cleanup_push(worker_cleanup, NULL);
@@ -216,31 +222,12 @@ void *worker_thread(void *arg)
     while(ok >= 0 && !pglobal->stop) {
         DBG("waiting for fresh frame\n");
 
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
-
-        /* read buffer */
-        frame_size = pglobal->in[input_number].size;
-
-        /* check if buffer for frame is large enough, increase it if necessary */
-        if(frame_size > max_frame_size) {
-            DBG("increasing buffer size to %d\n", frame_size);
-
-            max_frame_size = frame_size + (1 << 16);
-            if((tmp_framebuffer = realloc(frame, max_frame_size)) == NULL) {
-                pthread_mutex_unlock(&pglobal->in[input_number].db);
-                LOG("not enough memory\n");
-                return NULL;
-            }
-
-            frame = tmp_framebuffer;
+        if(consumer_next(&consumer) < 0) {
+            LOG("not enough memory\n");
+            return NULL;
         }
-
-        /* copy frame to our local buffer now */
-        memcpy(frame, pglobal->in[input_number].buf, frame_size);
-
-        /* allow others to access the global buffer again */
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
+        frame = consumer.buf;
+        frame_size = consumer.size;
 
         if (mjpgFileName == NULL) { // single files with ringbuffer mode
             /* prepare filename */
@@ -258,7 +245,6 @@ void *worker_thread(void *arg)
             /* prepare string, add time and date values */
             if(strftime(buffer1, sizeof(buffer1), "%%s/%Y_%m_%d_%H_%M_%S_picture_%%09llu.jpg", now) == 0) {
                 OPRINT("strftime returned 0\n");
-                free(frame); frame = NULL;
                 return NULL;
             }
 
@@ -267,23 +253,31 @@ void *worker_thread(void *arg)
 
             counter++;
 
-            DBG("writing file: %s\n", buffer2);
+            /* an unchanged frame only gets another name for the picture saved
+               before, unless that is gone or the filesystem has no links */
+            if(dedup && FRAME_SAME(consumer.hash, frame_size, last_hash, last_size) &&
+               link(last_file, buffer2) == 0) {
+                DBG("linking file: %s to %s\n", buffer2, last_file);
+            } else {
+                DBG("writing file: %s\n", buffer2);
+
+                /* open file for write */
+                if((fd = open(buffer2, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
+                    OPRINT("could not open the file %s\n", buffer2);
+                    return NULL;
+                }
 
-            /* open file for write */
-            if((fd = open(buffer2, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
-                OPRINT("could not open the file %s\n", buffer2);
-                return NULL;
-            }
+                /* save picture to file */
+                if(write(fd, frame, frame_size) < 0) {
+                    OPRINT("could not write to file %s\n", buffer2);
+                    perror("write()");
+                    close(fd);
+                    return NULL;
+                }
 
-            /* save picture to file */
-            if(write(fd, frame, frame_size) < 0) {
-                OPRINT("could not write to file %s\n", buffer2);
-                perror("write()");
                 close(fd);
-                return NULL;
             }
-
-            close(fd);
+            snprintf(last_file, sizeof(last_file), "%s", buffer2);
 
             /* link the picture as fixed name file */
             if (linkFileName) {
@@ -323,7 +317,7 @@ void *worker_thread(void *arg)
                 DBG("counter: %llu, will clean-up now\n", counter);
                 maintain_ringbuffer(ringbuffer_size);
             }
-        } else { // recording to MJPG file
+        } else { // recording to MJPG file, every frame keeps its place in time
             /* save picture to file */
             if(write(fd, frame, frame_size) < 0) {
                 OPRINT("could not write to file %s\n", buffer2);
@@ -332,6 +326,8 @@ void *worker_thread(void *arg)
                 return NULL;
             }
         }
+        last_hash = consumer.hash;
+        last_size = frame_size;
 
         /* if specified, wait now */
         if(delay > 0) {
@@ -390,6 +386,8 @@ int output_init(output_parameter *param, int id)
             {"link", required_argument, 0, 0},
             {"c", required_argument, 0, 0},
             {"command", required_argument, 0, 0},
+            {"policy", required_argument, 0, 0},
+            {"dedup", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -467,6 +465,20 @@ int output_init(output_parameter *param, int id)
             DBG("case 16,17\n");
             command = strdup(optarg);
             break;
+            /* policy */
+        case 18:
+            DBG("case 18\n");
+            if(consumer_parse_policy(optarg, &policy, &policy_param) < 0) {
+                OPRINT("invalid policy %s\n", optarg);
+                help();
+                return 1;
+            }
+            break;
+            /* dedup */
+        case 19:
+            DBG("case 19\n");
+            dedup = 1;
+            break;
         }
     }
 
@@ -478,7 +490,9 @@ int output_init(output_parameter *param, int id)
     OPRINT("output folder.....: %s\n", folder);
     OPRINT("input plugin.....: %d: %s\n", input_number, pglobal->in[input_number].plugin);
     OPRINT("delay after save..: %d\n", delay);
+    OPRINT("frame policy......: %s\n", consumer_policy_name(policy));
     if  (mjpgFileName == NULL) {
+        OPRINT("unchanged frames..: %s\n", dedup ? "not saved again" : "saved");
         if(ringbuffer_size > 0) {
             OPRINT("ringbuffer size...: %d to %d\n", ringbuffer_size, ringbuffer_size + ringbuffer_exceed);
         } else {
@@ -489,6 +503,10 @@ int output_init(output_parameter *param, int id)
         sprintf(fnBuffer, "%s/%s", folder, mjpgFileName);
 
         OPRINT("output file.......: %s\n", fnBuffer);
+
+        /* the file has no timestamps, a left out frame would shorten it */
+        if(dedup)
+            OPRINT("unchanged frames..: saved, --dedup only applies to single pictures\n");
         if((fd = open(fnBuffer, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
             OPRINT("could not open the file %s\n", fnBuffer);
             free(fnBuffer);
@@ -574,35 +592,14 @@ int output_cmd(int plugin_id, unsigned int control_id, unsigned int group, int v
 					switch(control_id) {
                             case OUT_FILE_CMD_TAKE: {
                                 if (valueStr != NULL) {
-                                    int frame_size = 0;
-                                    unsigned char *tmp_framebuffer = NULL;
+                                    frame_slot *slot;
 
-                                    if(pthread_mutex_lock(&pglobal->in[input_number].db)) {
-                                        DBG("Unable to lock mutex\n");
+                                    /* take the current frame, there is no need to wait for the next one */
+                                    slot = wait_for_frame(&pglobal->in[input_number], 0, 0);
+                                    if(slot == NULL) {
+                                        OPRINT("no frame available yet\n");
                                         return -1;
                                     }
-                                    /* read buffer */
-                                    frame_size = pglobal->in[input_number].size;
-
-                                    /* check if buffer for frame is large enough, increase it if necessary */
-                                    if(frame_size > max_frame_size) {
-                                        DBG("increasing buffer size to %d\n", frame_size);
-
-                                        max_frame_size = frame_size + (1 << 16);
-                                        if((tmp_framebuffer = realloc(frame, max_frame_size)) == NULL) {
-                                            pthread_mutex_unlock(&pglobal->in[input_number].db);
-                                            LOG("not enough memory\n");
-                                            return -1;
-                                        }
-
-                                        frame = tmp_framebuffer;
-                                    }
-
-                                    /* copy frame to our local buffer now */
-                                    memcpy(frame, pglobal->in[input_number].buf, frame_size);
-
-                                    /* allow others to access the global buffer again */
-                                    pthread_mutex_unlock(&pglobal->in[input_number].db);
 
                                     DBG("writing file: %s\n", valueStr);
 
@@ -610,17 +607,20 @@ int output_cmd(int plugin_id, unsigned int control_id, unsigned int group, int v
                                     /* open file for write */
                                     if((fd = open(valueStr, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
                                         OPRINT("could not open the file %s\n", valueStr);
+                                        frame_unref(&pglobal->in[input_number], slot);
                                         return -1;
                                     }
 
-                                    /* save picture to file */
-                                    if(write(fd, frame, frame_size) < 0) {
+                                    /* save picture to file, straight from the pinned slot */
+                                    if(write(fd, slot->buf, slot->size) < 0) {
                                         OPRINT("could not write to file %s\n", valueStr);
                                         perror("write()");
+                                        frame_unref(&pglobal->in[input_number], slot);
                                         close(fd);
                                         return -1;
                                     }
 
+                                    frame_unref(&pglobal->in[input_number], slot);
                                     close(fd);
                                 } else {
                                     DBG("No filename specified\n");
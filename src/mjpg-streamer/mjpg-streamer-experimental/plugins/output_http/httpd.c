@@ -30,7 +30,16 @@
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <netdb.h>
@@ -45,6 +54,7 @@
 #include "../../utils.h"
 
 #include "httpd.h"
+#include "jpeg_scale.h"
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,32)
 #define V4L2_CTRL_TYPE_STRING_SUPPORTED
@@ -57,16 +67,13 @@ static globals *pglobal;
 extern context servers[MAX_OUTPUT_PLUGINS];
 int piggy_fine = 2; // FIXME make it command line parameter
 
-/******************************************************************************
-Description.: initializes the iobuffer structure properly
-Input Value.: pointer to already allocated iobuffer
-Return Value: iobuf
-******************************************************************************/
-void init_iobuffer(iobuffer *iobuf)
-{
-    memset(iobuf->buffer, 0, sizeof(iobuf->buffer));
-    iobuf->level = 0;
-}
+/* the JSON of the controls, rebuilt when their version moved */
+static pthread_mutex_t controls_mutex = PTHREAD_MUTEX_INITIALIZER;
+static control_json input_controls[MAX_INPUT_PLUGINS];
+static control_json output_controls[MAX_OUTPUT_PLUGINS];
+
+/* output plugins run their commands at once, these count them */
+static unsigned long long output_versions[MAX_OUTPUT_PLUGINS];
 
 /******************************************************************************
 Description.: initializes the request structure properly
@@ -79,121 +86,20 @@ void init_request(request *req)
     req->parameter   = NULL;
     req->client      = NULL;
     req->credentials = NULL;
-}
-
-/******************************************************************************
-Description.: If strings were assigned to the different members free them
-              This will fail if strings are static, so always use strdup().
-Input Value.: req: pointer to request structure
-Return Value: -
-******************************************************************************/
-void free_request(request *req)
-{
-    if(req->parameter != NULL) free(req->parameter);
-    if(req->client != NULL) free(req->client);
-    if(req->credentials != NULL) free(req->credentials);
-    if(req->query_string != NULL) free(req->query_string);
-}
-
-/******************************************************************************
-Description.: read with timeout, implemented without using signals
-              tries to read len bytes and returns if enough bytes were read
-              or the timeout was triggered. In case of timeout the return
-              value may differ from the requested bytes "len".
-Input Value.: * fd.....: fildescriptor to read from
-              * iobuf..: iobuffer that allows to use this functions from multiple
-                         threads because the complete context is the iobuffer.
-              * buffer.: The buffer to store values at, will be set to zero
-                         before storing values.
-              * len....: the length of buffer
-              * timeout: seconds to wait for an answer
-Return Value: * buffer.: will become filled with bytes read
-              * iobuf..: May get altered to save the context for future calls.
-              * func().: bytes copied to buffer or -1 in case of error
-******************************************************************************/
-int _read(int fd, iobuffer *iobuf, void *buffer, size_t len, int timeout)
-{
-    int copied = 0, rc, i;
-    fd_set fds;
-    struct timeval tv;
-
-    memset(buffer, 0, len);
-
-    while((copied < len)) {
-        i = MIN(iobuf->level, len - copied);
-        memcpy(buffer + copied, iobuf->buffer + IO_BUFFER - iobuf->level, i);
-
-        iobuf->level -= i;
-        copied += i;
-        if(copied >= len)
-            return copied;
-
-        /* select will return in case of timeout or new data arrived */
-        tv.tv_sec = timeout;
-        tv.tv_usec = 0;
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        if((rc = select(fd + 1, &fds, NULL, NULL, &tv)) <= 0) {
-            if(rc < 0)
-                exit(EXIT_FAILURE);
-
-            /* this must be a timeout */
-            return copied;
-        }
-
-        init_iobuffer(iobuf);
-
-        /*
-         * there should be at least one byte, because select signalled it.
-         * But: It may happen (very seldomly), that the socket gets closed remotly between
-         * the select() and the following read. That is the reason for not relying
-         * on reading at least one byte.
-         */
-        if((iobuf->level = read(fd, &iobuf->buffer, IO_BUFFER)) <= 0) {
-            /* an error occured */
-            return -1;
-        }
-
-        /* align data to the end of the buffer if less than IO_BUFFER bytes were read */
-        memmove(iobuf->buffer + (IO_BUFFER - iobuf->level), iobuf->buffer, iobuf->level);
-    }
-
-    return 0;
-}
-
-/******************************************************************************
-Description.: Read a single line from the provided fildescriptor.
-              This funtion will return under two conditions:
-              * line end was reached
-              * timeout occured
-Input Value.: * fd.....: fildescriptor to read from
-              * iobuf..: iobuffer that allows to use this functions from multiple
-                         threads because the complete context is the iobuffer.
-              * buffer.: The buffer to store values at, will be set to zero
-                         before storing values.
-              * len....: the length of buffer
-              * timeout: seconds to wait for an answer
-Return Value: * buffer.: will become filled with bytes read
-              * iobuf..: May get altered to save the context for future calls.
-              * func().: bytes copied to buffer or -1 in case of error
-******************************************************************************/
-/* read just a single line or timeout */
-int _readline(int fd, iobuffer *iobuf, void *buffer, size_t len, int timeout)
-{
-    char c = '\0', *out = buffer;
-    int i;
-
-    memset(buffer, 0, len);
-
-    for(i = 0; i < len && c != '\n'; i++) {
-        if(_read(fd, iobuf, &c, 1, timeout) <= 0) {
-            /* timeout or error occured */
-            return -1;
-        }
-        *out++ = c;
-    }
-
-    return i;
+    req->query_string = NULL;
+    req->http11      = 0;
+    req->keep_alive  = 0;
+    req->etag        = NULL;
+    req->gzip        = 0;
+    req->wait        = 0;
+    req->fps         = 0;
+    req->scale       = 0;
+    req->poll        = 0;
+    req->version     = 0;
+    req->ws_key      = NULL;
+    req->ws_version  = 0;
+    req->upgrade     = 0;
+    req->ack         = 0;
 }
 
 /******************************************************************************
@@ -342,6 +248,8 @@ client_info *add_client(char *address)
 
     strcpy(current_client_info->address, address);
     memset(&(current_client_info->last_take_time), 0, sizeof(struct timeval)); // set last time to zero
+    current_client_info->frames = 0;
+    current_client_info->dropped = 0;
 
     client_infos.infos = realloc(client_infos.infos, (client_infos.client_count + 1) * sizeof(client_info*));
     client_infos.infos[client_infos.client_count] = current_client_info;
@@ -392,242 +300,758 @@ void update_client_timestamp(client_info *client)
     memcpy(&client->last_take_time, &tim, sizeof(struct timeval));
     pthread_mutex_unlock(&client_infos.mutex);
 }
-#endif
 
 /******************************************************************************
-Description.: Send a complete HTTP response and a single JPG-frame.
-Input Value.: fildescriptor fd to send the answer to
+Description.: Counts a stream frame sent to a client and the frames it missed
+              before, since the previous frame it got
+Input Value.: * client is the client information of the address
+              * dropped is the number of missed frames
 Return Value: -
 ******************************************************************************/
-void send_snapshot(cfd *context_fd, int input_number)
+void update_client_frames(client_info *client, unsigned long long dropped)
 {
-    unsigned char *frame = NULL;
-    int frame_size = 0;
-    char buffer[BUFFER_SIZE] = {0};
-    struct timeval timestamp;
+    pthread_mutex_lock(&client_infos.mutex);
+    client->frames++;
+    client->dropped += dropped;
+    pthread_mutex_unlock(&client_infos.mutex);
+}
+#endif
 
-    /* wait for a fresh frame */
-    pthread_mutex_lock(&pglobal->in[input_number].db);
-    pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+/******************************************************************************
+Description.: Waits until a non-blocking socket takes more data
+Input Value.: fd is the socket
+Return Value: 0 if it does, -1 if the client took nothing for SEND_TIMEOUT
+******************************************************************************/
+static int wait_writable(int fd)
+{
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+    int rc;
 
-    /* read buffer */
-    frame_size = pglobal->in[input_number].size;
+    while((rc = poll(&pfd, 1, SEND_TIMEOUT)) < 0 && errno == EINTR);
 
-    /* allocate a buffer for this single frame */
-    if((frame = malloc(frame_size + 1)) == NULL) {
-        free(frame);
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
-        send_error(context_fd->fd, 500, "not enough memory");
-        return;
+    if(rc <= 0) {
+        DBG("client took nothing for %d ms\n", SEND_TIMEOUT);
+        return -1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: Writes a buffer completely to a non-blocking socket
+Input Value.: * fd is the socket
+              * buf, len is the data
+Return Value: 0 if everything was written, -1 otherwise
+******************************************************************************/
+static int write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while(len > 0) {
+        if((n = write(fd, buf, len)) < 0) {
+            if(errno == EINTR)
+                continue;
+            if((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(fd) == 0)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: Writes a header and a body completely to a non-blocking socket,
+              with a single call as long as the socket takes them
+Input Value.: * fd is the socket
+              * header, len is the header
+              * body, body_len is the body
+Return Value: 0 if everything was written, -1 otherwise
+******************************************************************************/
+static int send_all(int fd, const char *header, size_t len, const void *body, size_t body_len)
+{
+    struct iovec iov[2];
+    ssize_t n;
+
+    iov[0].iov_base = (void *)header;
+    iov[0].iov_len = len;
+    iov[1].iov_base = (void *)body;
+    iov[1].iov_len = body_len;
+
+    if((n = writev(fd, iov, 2)) < 0) {
+        if(errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+            return -1;
+        n = 0;
+    }
+
+    if((size_t)n < len) {
+        if(write_all(fd, header + n, len - n) < 0)
+            return -1;
+        n = len;
+    }
+
+    return write_all(fd, (const char *)body + (n - len), body_len - (n - len));
+}
+
+/******************************************************************************
+Description.: Copies a range of a file completely to a non-blocking socket
+Input Value.: * fd is the socket
+              * file is the file
+              * offset, len is the range
+Return Value: 0 if everything was sent, -1 otherwise
+******************************************************************************/
+static int sendfile_all(int fd, int file, off_t offset, size_t len)
+{
+    ssize_t n;
+
+    while(len > 0) {
+        if((n = sendfile(fd, file, &offset, len)) <= 0) {
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(fd) == 0)
+                continue;
+            return -1;
+        }
+        len -= n;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: Appends the headers telling whether the connection persists
+              and the empty line ending the header
+Input Value.: * header, size is the buffer
+              * keep_alive is set if the connection persists
+Return Value: number of characters appended
+******************************************************************************/
+static int connection_header(char *header, size_t size, int keep_alive)
+{
+    if(keep_alive)
+        return snprintf(header, size, "Connection: keep-alive\r\n" \
+                        "Keep-Alive: timeout=%d\r\n\r\n", KEEPALIVE_TIMEOUT / 1000);
+
+    return snprintf(header, size, "Connection: close\r\n\r\n");
+}
+
+/******************************************************************************
+Description.: Send a complete HTTP response and a single JPG-frame. The latest
+              frame is sent right away from the ring, only "wait=1" waits for
+              the next one. The ETag names the frame, a matching If-None-Match
+              is answered with 304.
+Input Value.: * context_fd is the filedescriptor to send the answer to
+              * input_number is the input plugin
+              * req is the request, NULL to send the latest frame
+              * keep_alive is set if the client wants the connection to persist
+Return Value: 1 if the connection may serve the next request, 0 otherwise
+******************************************************************************/
+int send_snapshot(cfd *context_fd, int input_number, request *req, int keep_alive)
+{
+    input *in = &pglobal->in[input_number];
+    frame_slot *slot = NULL;
+    frame_interest interest;
+    unsigned long long last_seq = 0;
+    char buffer[BUFFER_SIZE], etag[48];
+    int len, http11 = req != NULL && req->http11;
+
+    if(req != NULL && req->wait) {
+        last_seq = frame_seq(in);
+    } else if((slot = wait_for_frame(in, 0, 0)) != NULL &&
+              frame_demand(in) == DEMAND_NONE &&
+              latency_now() - slot->trace.published > SNAPSHOT_MAX_AGE * 1000ULL) {
+        /* an idle input only holds an old frame, wake it up and wait for a new one */
+        last_seq = slot->seq;
+        frame_unref(in, slot);
+        slot = NULL;
     }
-    /* copy v4l2_buffer timeval to user space */
-    timestamp = pglobal->in[input_number].timestamp;
 
-    memcpy(frame, pglobal->in[input_number].buf, frame_size);
-    DBG("got frame (size: %d kB)\n", frame_size / 1024);
+    if(slot == NULL) {
+        frame_interest_add(in, &interest, DEMAND_ALL);
+        slot = wait_for_frame(in, last_seq, SNAPSHOT_TIMEOUT);
+        frame_interest_remove(in, &interest);
+    }
 
-    pthread_mutex_unlock(&pglobal->in[input_number].db);
+    if(slot == NULL) {
+        send_error(context_fd->fd, 500, "no frame available");
+        return 0;
+    }
+    DBG("got frame (size: %d kB)\n", slot->size / 1024);
 
     #ifdef MANAGMENT
     update_client_timestamp(context_fd->client);
     #endif
 
+    snprintf(etag, sizeof(etag), "\"%d-%llu-%llx\"", input_number, slot->seq, slot->hash);
+
+    if(req != NULL && req->etag != NULL && strstr(req->etag, etag) != NULL) {
+        frame_unref(in, slot);
+        len = snprintf(buffer, sizeof(buffer), "HTTP/1.%d 304 Not Modified\r\n" \
+                       "Access-Control-Allow-Origin: *\r\n" \
+                       "ETag: %s\r\n" \
+                       "Cache-Control: no-cache\r\n", http11, etag);
+        len += connection_header(buffer + len, sizeof(buffer) - len, keep_alive);
+        return write_all(context_fd->fd, buffer, len) < 0 ? 0 : keep_alive;
+    }
+
     /* write the response */
-    sprintf(buffer, "HTTP/1.0 200 OK\r\n" \
-            "Access-Control-Allow-Origin: *\r\n" \
-            STD_HEADER \
-            "Content-type: image/jpeg\r\n" \
-            "X-Timestamp: %d.%06d\r\n" \
-            "\r\n", (int) timestamp.tv_sec, (int) timestamp.tv_usec);
+    len = snprintf(buffer, sizeof(buffer), "HTTP/1.%d 200 OK\r\n" \
+                   "Access-Control-Allow-Origin: *\r\n" \
+                   "Server: MJPG-Streamer/0.2\r\n" \
+                   "Cache-Control: no-cache\r\n" \
+                   "Content-type: image/jpeg\r\n" \
+                   "Content-Length: %d\r\n" \
+                   "ETag: %s\r\n" \
+                   "X-Timestamp: %d.%06d\r\n", http11, slot->size, etag,
+                   (int) slot->timestamp.tv_sec, (int) slot->timestamp.tv_usec);
+    len += connection_header(buffer + len, sizeof(buffer) - len, keep_alive);
 
     /* send header and image now */
-    if (write(context_fd->fd, buffer, strlen(buffer)) < 0 ||
-        write(context_fd->fd, frame, frame_size) < 0) {
-        free(frame);
+    if(send_all(context_fd->fd, buffer, len, slot->buf, slot->size) < 0)
+        keep_alive = 0;
+    else
+        metric_add(context_fd->pc->bytes_sent, len + slot->size);
+
+    frame_unref(in, slot);
+
+    return keep_alive;
+}
+
+/******************************************************************************
+Description.: drops a reference to a part of a stream, the last one frees it
+              and its frame
+Input Value.: part is the part
+Return Value: -
+******************************************************************************/
+static void part_unref(stream_part *part)
+{
+    if(__atomic_sub_fetch(&part->refs, 1, __ATOMIC_ACQ_REL) > 0)
         return;
-    }
 
-    free(frame);
+    if(part->frame != NULL)
+        part_unref(part->frame);
+    free(part->data);
+    free(part);
 }
 
 /******************************************************************************
-Description.: Send a complete HTTP response and a stream of JPG-frames.
-Input Value.: fildescriptor fd to send the answer to
+Description.: fills in the frame of a part and the headers in front of it
+Input Value.: * part is the part, its body is set
+              * slot is the original frame
 Return Value: -
 ******************************************************************************/
-void send_stream(cfd *context_fd, int input_number)
+static void part_frame(stream_part *part, frame_slot *slot)
 {
-    unsigned char *frame = NULL, *tmp = NULL;
-    int frame_size = 0, max_frame_size = 0;
-    char buffer[BUFFER_SIZE] = {0};
-    struct timeval timestamp;
+    unsigned long long usec = slot->timestamp.tv_sec * 1000000ULL + slot->timestamp.tv_usec;
+    unsigned char *info;
+    int i;
 
-    DBG("preparing header\n");
-    sprintf(buffer, "HTTP/1.0 200 OK\r\n" \
-            "Access-Control-Allow-Origin: *\r\n" \
-            STD_HEADER \
-            "Content-Type: multipart/x-mixed-replace;boundary=" BOUNDARY "\r\n" \
-            "\r\n" \
-            "--" BOUNDARY "\r\n");
+    part->seq = slot->seq;
+    part->hash = slot->hash;
+    part->frame_size = slot->size;
+    part->trace = slot->trace;
 
-    if(write(context_fd->fd, buffer, strlen(buffer)) < 0) {
-        free(frame);
-        return;
+    /*
+     * print the individual mimetype and the length
+     * sending the content-length fixes random stream disruption observed
+     * with firefox
+     */
+    part->head_len = sprintf(part->head, "Content-Type: image/jpeg\r\n" \
+                             "Content-Length: %d\r\n" \
+                             "X-Timestamp: %d.%06d\r\n" \
+                             "\r\n", part->body_len, (int)slot->timestamp.tv_sec, (int)slot->timestamp.tv_usec);
+    part->tail = "\r\n--" BOUNDARY "\r\n";
+    part->tail_len = strlen(part->tail);
+
+    /* a WebSocket message holds the sequence number and the capture time in
+       microseconds, both big endian, followed by the frame */
+    part->ws_head_len = ws_header(part->ws_head, WS_BINARY, WS_FRAME_INFO + part->body_len);
+    info = part->ws_head + part->ws_head_len;
+    for(i = 0; i < 8; i++) {
+        info[i] = slot->seq >> (56 - i * 8);
+        info[8 + i] = usec >> (56 - i * 8);
     }
+    part->ws_head_len += WS_FRAME_INFO;
+}
 
-    DBG("Headers send, sending stream now\n");
+/******************************************************************************
+Description.: scales a frame for the stream clients that asked for a smaller
+              picture, runs in the watch thread of the input. A frame libjpeg
+              can not scale is copied in its original size, so only this
+              frame reaches those clients unscaled.
+Input Value.: * input_number is the input plugin
+              * slot is a referenced frame, it stays referenced
+              * scale is the index of the scale, the frame shrinks by 1/2^scale
+Return Value: the part with one reference, NULL if there is not enough memory
+******************************************************************************/
+static stream_part *scaled_part(int input_number, frame_slot *slot, int scale)
+{
+    stream_part *part;
+    unsigned char *jpeg;
+    unsigned long size;
 
-    while(!pglobal->stop) {
+    if(jpeg_scale(slot->buf, slot->size, 1 << scale, SCALE_QUALITY, &jpeg, &size) < 0) {
+        DBG("could not scale frame %llu by 1/%d\n", slot->seq, 1 << scale);
+        if((jpeg = malloc(slot->size)) == NULL)
+            return NULL;
+        memcpy(jpeg, slot->buf, slot->size);
+        size = slot->size;
+    }
 
-        /* wait for fresh frames */
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+    if((part = calloc(1, sizeof(stream_part))) == NULL) {
+        free(jpeg);
+        return NULL;
+    }
 
-        /* read buffer */
-        frame_size = pglobal->in[input_number].size;
+    part->refs = 1;
+    part->input = input_number;
+    part->data = jpeg;
+    part->body = jpeg;
+    part->body_len = size;
+    part_frame(part, slot);
 
-        /* check if framebuffer is large enough, increase it if necessary */
-        if(frame_size > max_frame_size) {
-            DBG("increasing buffer size to %d\n", frame_size);
+    return part;
+}
 
-            max_frame_size = frame_size + TEN_K;
-            if((tmp = realloc(frame, max_frame_size)) == NULL) {
-                free(frame);
-                pthread_mutex_unlock(&pglobal->in[input_number].db);
-                send_error(context_fd->fd, 500, "not enough memory");
-                return;
-            }
+/******************************************************************************
+Description.: arms or disarms EPOLLOUT for a connection of the event loop
+Input Value.: * c is the connection
+              * on is 1 while data for the client waits for the socket
+Return Value: -
+******************************************************************************/
+static void want_write(connection *c, int on)
+{
+    struct epoll_event ev;
 
-            frame = tmp;
-        }
+    if(c->want_write == on)
+        return;
 
-        /* copy v4l2_buffer timeval to user space */
-        timestamp = pglobal->in[input_number].timestamp;
+    ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    if(epoll_ctl(c->lcfd.pc->epfd, EPOLL_CTL_MOD, c->ev.fd, &ev) == 0)
+        c->want_write = on;
+}
 
-        memcpy(frame, pglobal->in[input_number].buf, frame_size);
-        DBG("got frame (size: %d kB)\n", frame_size / 1024);
+/******************************************************************************
+Description.: removes a connection from the event loop, the socket stays open.
+              Events for it may still wait in the batch epoll_wait() returned,
+              so it is only freed by conn_reap() after the batch.
+Input Value.: c is the connection
+Return Value: -
+******************************************************************************/
+static void conn_release(connection *c)
+{
+    context *pc = c->lcfd.pc;
 
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
+    epoll_ctl(pc->epfd, EPOLL_CTL_DEL, c->ev.fd, NULL);
 
-        #ifdef MANAGMENT
-        update_client_timestamp(context_fd->client);
-        #endif
+    if(c->prev != NULL)
+        c->prev->next = c->next;
+    else
+        pc->conns = c->next;
+    if(c->next != NULL)
+        c->next->prev = c->prev;
 
-        /*
-         * print the individual mimetype and the length
-         * sending the content-length fixes random stream disruption observed
-         * with firefox
-         */
-        sprintf(buffer, "Content-Type: image/jpeg\r\n" \
-                "Content-Length: %d\r\n" \
-                "X-Timestamp: %d.%06d\r\n" \
-                "\r\n", frame_size, (int)timestamp.tv_sec, (int)timestamp.tv_usec);
-        DBG("sending intemdiate header\n");
-        if(write(context_fd->fd, buffer, strlen(buffer)) < 0) break;
+    c->released = 1;
+    c->next = pc->released;
+    pc->released = c;
+}
 
-        DBG("sending frame\n");
-        if(write(context_fd->fd, frame, frame_size) < 0) break;
+/******************************************************************************
+Description.: frees the connections released while the events of the last
+              epoll_wait() were handled
+Input Value.: pc is the server-context
+Return Value: -
+******************************************************************************/
+static void conn_reap(context *pc)
+{
+    connection *c;
 
-        DBG("sending boundary\n");
-        sprintf(buffer, "\r\n--" BOUNDARY "\r\n");
-        if(write(context_fd->fd, buffer, strlen(buffer)) < 0) break;
+    while((c = pc->released) != NULL) {
+        pc->released = c->next;
+        free(c->head);
+        free(c);
     }
-
-    free(frame);
 }
 
-#ifdef WXP_COMPAT
 /******************************************************************************
-Description.: Sends a mjpg stream in the same format as the WebcamXP does
-Input Value.: fildescriptor fd to send the answer to
+Description.: closes a connection of the event loop, a stream stops here
+Input Value.: c is the connection
 Return Value: -
 ******************************************************************************/
-void send_stream_wxp(cfd *context_fd, int input_number)
+static void conn_close(connection *c)
 {
-    unsigned char *frame = NULL, *tmp = NULL;
-    int frame_size = 0, max_frame_size = 0;
-    char buffer[BUFFER_SIZE] = {0};
-    struct timeval timestamp;
+    context *pc = c->lcfd.pc;
+    int fd = c->ev.fd;
 
-    DBG("preparing header\n");
+    if(c->state == CONN_STREAM) {
+        if(c->stream_prev != NULL)
+            c->stream_prev->stream_next = c->stream_next;
+        else
+            pc->streaming[c->input] = c->stream_next;
+        if(c->stream_next != NULL)
+            c->stream_next->stream_prev = c->stream_prev;
+
+        DBG("stream client leaves after %llu frames, %llu dropped\n", c->frames, c->dropped);
+        if(c->scale > 0 && --pc->scaled_clients[c->input][c->scale] == 0)
+            __atomic_and_fetch(&pc->watch[c->input].scales, ~(1 << c->scale), __ATOMIC_RELAXED);
+        if(c->part != NULL)
+            part_unref(c->part);
+        frame_interest_remove(&pglobal->in[c->input], &c->interest);
+        metric_dec(pc->streams);
+    }
 
-    time_t curDate, expiresDate;
-    curDate = time(NULL);
-    expiresDate = curDate - 1380; // teh expires date is before the current date with 23 minute (1380) sec
+    conn_release(c);
+    close(fd);
+}
 
-    char curDateBuffer[80];
-    char expDateBuffer[80];
+/******************************************************************************
+Description.: returns the multipart part of a frame, it is built for the
+              first client that needs it and shared with all others. The
+              frame is copied once, so the slot goes back to the ring right
+              away however long the clients take to send it.
+Input Value.: * pc is the server-context
+              * input_number is the input plugin
+              * slot is a referenced frame, the reference is dropped
+Return Value: referenced part, or NULL if there is not enough memory
+******************************************************************************/
+static stream_part *part_of_frame(context *pc, int input_number, frame_slot *slot)
+{
+    stream_part *part = pc->parts[input_number];
 
-    strftime(curDateBuffer, 80, "%a, %d %b %Y %H:%M:%S %Z", localtime(&curDate));
-    strftime(expDateBuffer, 80, "%a, %d %b %Y %H:%M:%S %Z", localtime(&expiresDate));
-    sprintf(buffer, "HTTP/1.1 200 OK\r\n" \
-                    "Connection: keep-alive\r\n" \
-                    "Content-Type: multipart/x-mixed-replace; boundary=--myboundary\r\n" \
-                    "Content-Length: 9999999\r\n" \
-                    "Cache-control: no-cache, must revalidate\r\n" \
-                    "Date: %s\r\n" \
-                    "Expires: %s\r\n" \
-                    "Pragma: no-cache\r\n" \
-                    "Server: webcamXP\r\n"
-                    "\r\n",
-                    curDateBuffer,
-                    expDateBuffer);
-
-    if(write(context_fd->fd, buffer, strlen(buffer)) < 0) {
-        free(frame);
-        return;
+    if(part != NULL && part->seq == slot->seq) {
+        frame_unref(&pglobal->in[input_number], slot);
+        __atomic_add_fetch(&part->refs, 1, __ATOMIC_RELAXED);
+        return part;
     }
 
-    DBG("Headers send, sending stream now\n");
+    if((part = calloc(1, sizeof(stream_part))) == NULL ||
+       (part->data = malloc(slot->size)) == NULL) {
+        free(part);
+        frame_unref(&pglobal->in[input_number], slot);
+        return NULL;
+    }
 
-    while(!pglobal->stop) {
+    part->refs = 2;     /* the cache and the caller */
+    part->input = input_number;
+    memcpy(part->data, slot->buf, slot->size);
+    part->body = part->data;
+    part->body_len = slot->size;
+    part_frame(part, slot);
+    frame_unref(&pglobal->in[input_number], slot);
 
-        /* wait for fresh frames */
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+    if(pc->parts[input_number] != NULL)
+        part_unref(pc->parts[input_number]);
+    pc->parts[input_number] = part;
 
-        /* read buffer */
-        frame_size = pglobal->in[input_number].size;
+    return part;
+}
+
+/******************************************************************************
+Description.: prepares the next part of a stream if the input has a frame the
+              client did not get yet
+Input Value.: c is a streaming connection that is not busy
+Return Value: 1 if a part is ready to be sent, 0 if the client is up to date
+******************************************************************************/
+static int stream_next(connection *c)
+{
+    context *pc = c->lcfd.pc;
+    input *in = &pglobal->in[c->input];
+    frame_watch *w = &pc->watch[c->input];
+    unsigned long long missed, now = latency_now(), period;
+    frame_slot *slot = NULL;
+    stream_part *part, *frame;
+
+    /* a client with a frame rate skips the frames until one is due */
+    if(c->fps > 0 && now < c->next_due)
+        return 0;
+
+    /* a WebSocket client that acks waits until it showed the last frame */
+    if(c->ack && !c->ready)
+        return 0;
+
+    if(c->scale > 0) {
+        pthread_mutex_lock(&w->lock);
+        if((part = w->scaled[c->scale]) != NULL)
+            __atomic_add_fetch(&part->refs, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&w->lock);
+
+        if(part == NULL)
+            return 0;
+        if(part->seq == c->last_seq) {
+            part_unref(part);
+            return 0;
+        }
+    } else {
+        frame_lock(in);
+        slot = frame_ref_latest(in);
+        pthread_mutex_unlock(&in->db);
+
+        if(slot == NULL)
+            return 0;
+        if(slot->seq == c->last_seq) {
+            frame_unref(in, slot);
+            return 0;
+        }
 
-        /* check if framebuffer is large enough, increase it if necessary */
-        if(frame_size > max_frame_size) {
-            DBG("increasing buffer size to %d\n", frame_size);
+        if((part = part_of_frame(pc, c->input, slot)) == NULL)
+            return 0;
 
-            max_frame_size = frame_size + TEN_K;
-            if((tmp = realloc(frame, max_frame_size)) == NULL) {
-                free(frame);
-                pthread_mutex_unlock(&pglobal->in[input_number].db);
-                send_error(context_fd->fd, 500, "not enough memory");
-                return;
+        /* the WebcamXP format sends the same copy behind its own header */
+        if(c->type == A_STREAM_WXP) {
+            frame = part;
+            if((part = calloc(1, sizeof(stream_part))) == NULL) {
+                part_unref(frame);
+                return 0;
+            }
+            part->refs = 1;
+            part->input = c->input;
+            part->frame = frame;
+            part->body = frame->body;
+            part->body_len = frame->body_len;
+            part->seq = frame->seq;
+            part->hash = frame->hash;
+            part->frame_size = frame->frame_size;
+            part->trace = frame->trace;
+            sprintf(part->head, "mjpeg %07d12345", frame->body_len);
+            part->head_len = 50;
+            part->tail_len = 0;
+        }
+    }
+
+    /* a client that was still busy with an older frame only gets the newest
+       one, the frames in between are dropped for it */
+    missed = c->fps > 0 ? 0 : FRAMES_MISSED(c->last_seq, part->seq);
+    if(missed > 0) {
+        DBG("client missed %llu frames\n", missed);
+        c->dropped += missed;
+        metric_add(pc->dropped, missed);
+    }
+    c->last_seq = part->seq;
+    DBG("got frame (size: %d kB)\n", part->body_len / 1024);
+
+    /* the client already shows this picture, resend it now and then
+       so players do not time out */
+    if(pc->conf.dedup > 0 &&
+       FRAME_SAME(part->hash, part->frame_size, c->last_hash, c->last_size) &&
+       now - c->last_sent < pc->conf.dedup * 1000ULL) {
+        metric_inc(pc->duplicates);
+        part_unref(part);
+        return 0;
+    }
+    c->last_hash = part->hash;
+    c->last_size = part->frame_size;
+    c->last_sent = now;
+
+    /* keep the rate on average, but do not catch up after a pause */
+    if(c->fps > 0) {
+        period = 1000000ULL / c->fps;
+        c->next_due = (now - c->next_due < period) ? c->next_due + period : now + period;
+    }
+
+    c->frames++;
+
+    #ifdef MANAGMENT
+    update_client_timestamp(c->lcfd.client);
+    update_client_frames(c->lcfd.client, missed);
+    #endif
+
+    c->part = part;
+    c->sent = 0;
+    c->ready = 0;
+
+    return 1;
+}
+
+/******************************************************************************
+Description.: writes as much of the current part of a stream as the socket
+              takes and goes on with newer frames until the client is up to
+              date
+Input Value.: c is a streaming connection
+Return Value: -
+******************************************************************************/
+static void stream_flush(connection *c)
+{
+    stream_part *p;
+    struct iovec iov[3];
+    size_t total, off;
+    ssize_t n;
+    char *head;
+    int cnt, head_len, tail_len;
+
+    while(c->part != NULL) {
+        p = c->part;
+
+        /* a WebSocket client gets the frame as one binary message */
+        if(c->type == A_WEBSOCKET && p->body_len > 0) {
+            head = (char *)p->ws_head;
+            head_len = p->ws_head_len;
+            tail_len = 0;
+        } else {
+            head = p->head;
+            head_len = p->head_len;
+            tail_len = p->tail_len;
+        }
+        total = head_len + (p->body_len > 0 ? p->body_len + tail_len : 0);
+
+        while(c->sent < total) {
+            /* the pieces of the part that are not written yet */
+            cnt = 0;
+            off = c->sent;
+            if(off < (size_t)head_len) {
+                iov[cnt].iov_base = head + off;
+                iov[cnt++].iov_len = head_len - off;
+                off = 0;
+            } else {
+                off -= head_len;
+            }
+            if(p->body_len > 0) {
+                if(off < (size_t)p->body_len) {
+                    iov[cnt].iov_base = (void *)(p->body + off);
+                    iov[cnt++].iov_len = p->body_len - off;
+                    off = 0;
+                } else {
+                    off -= p->body_len;
+                }
+                if(tail_len > 0) {
+                    iov[cnt].iov_base = (char *)p->tail + off;
+                    iov[cnt++].iov_len = tail_len - off;
+                }
             }
 
-            frame = tmp;
+            if((n = writev(c->ev.fd, iov, cnt)) < 0) {
+                if(errno == EINTR)
+                    continue;
+                if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                    want_write(c, 1);
+                    return;
+                }
+                DBG("stream client is gone\n");
+                conn_close(c);
+                return;
+            }
+            c->sent += n;
         }
 
-        /* copy v4l2_buffer timeval to user space */
-        timestamp = pglobal->in[input_number].timestamp;
+        metric_add(c->lcfd.pc->bytes_sent, total);
+        if(p->body_len > 0)
+            latency_delivered(&p->trace, c->input);
+        part_unref(p);
+        c->part = NULL;
 
-        #ifdef MANAGMENT
-        update_client_timestamp(context_fd->client);
-        #endif
+        stream_next(c);
+    }
+
+    want_write(c, 0);
+}
 
-        memcpy(frame, pglobal->in[input_number].buf, frame_size);
-        DBG("got frame (size: %d kB)\n", frame_size / 1024);
+/******************************************************************************
+Description.: turns a connection into a stream of JPG-frames, either as
+              multipart HTTP response, in the format of the WebcamXP or as
+              binary messages of a WebSocket
+Input Value.: * c is the connection, its request was read
+              * req is the request, of type A_STREAM, A_STREAM_WXP or
+                A_WEBSOCKET
+              * input_number is the input plugin to stream
+Return Value: -
+******************************************************************************/
+static void stream_start(connection *c, request *req, int input_number)
+{
+    context *pc = c->lcfd.pc;
+    stream_part *part;
+    answer_t type = req->type;
+    int fps = req->fps, scale = req->scale;
+    int lowat = STREAM_LOWAT;
+    time_t curDate, expiresDate;
+    char curDateBuffer[80];
+    char expDateBuffer[80];
+    char accept[WS_ACCEPT_LEN];
+
+    /* the request points into the buffer, a WebSocket client sends its
+       messages there later */
+    if(type == A_WEBSOCKET) {
+        ws_accept(req->ws_key, accept);
+        c->head_len = 0;
+        c->ack = req->ack;
+        c->ready = 1;
+    } else {
+        free(c->head);
+        c->head = NULL;
+    }
 
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
+    if((part = calloc(1, sizeof(stream_part))) == NULL) {
+        conn_close(c);
+        return;
+    }
 
-        memset(buffer, 0, 50*sizeof(char));
-        sprintf(buffer, "mjpeg %07d12345", frame_size);
-        DBG("sending intemdiate header\n");
-        if(write(context_fd->fd, buffer, 50) < 0) break;
+    c->state = CONN_STREAM;
+    c->type = type;
+    c->input = input_number;
+    c->fps = fps;
+    c->scale = scale;
+    c->stream_prev = NULL;
+    c->stream_next = pc->streaming[input_number];
+    if(c->stream_next != NULL)
+        c->stream_next->stream_prev = c;
+    pc->streaming[input_number] = c;
 
-        DBG("sending frame\n");
-        if(write(context_fd->fd, frame, frame_size) < 0) break;
+    DBG("preparing header\n");
+    part->refs = 1;
+    part->input = input_number;
+    if(type == A_STREAM_WXP) {
+        curDate = time(NULL);
+        expiresDate = curDate - 1380; // teh expires date is before the current date with 23 minute (1380) sec
+
+        strftime(curDateBuffer, 80, "%a, %d %b %Y %H:%M:%S %Z", localtime(&curDate));
+        strftime(expDateBuffer, 80, "%a, %d %b %Y %H:%M:%S %Z", localtime(&expiresDate));
+        part->head_len = sprintf(part->head, "HTTP/1.1 200 OK\r\n" \
+                                 "Connection: keep-alive\r\n" \
+                                 "Content-Type: multipart/x-mixed-replace; boundary=--myboundary\r\n" \
+                                 "Content-Length: 9999999\r\n" \
+                                 "Cache-control: no-cache, must revalidate\r\n" \
+                                 "Date: %s\r\n" \
+                                 "Expires: %s\r\n" \
+                                 "Pragma: no-cache\r\n" \
+                                 "Server: webcamXP\r\n"
+                                 "\r\n",
+                                 curDateBuffer,
+                                 expDateBuffer);
+    } else if(type == A_WEBSOCKET) {
+        part->head_len = sprintf(part->head, "HTTP/1.1 101 Switching Protocols\r\n" \
+                                 "Upgrade: websocket\r\n" \
+                                 "Connection: Upgrade\r\n" \
+                                 "Sec-WebSocket-Accept: %s\r\n" \
+                                 "Server: MJPG-Streamer/0.2\r\n" \
+                                 "\r\n", accept);
+    } else {
+        part->head_len = sprintf(part->head, "HTTP/1.0 200 OK\r\n" \
+                                 "Access-Control-Allow-Origin: *\r\n" \
+                                 STD_HEADER \
+                                 "Content-Type: multipart/x-mixed-replace;boundary=" BOUNDARY "\r\n" \
+                                 "\r\n" \
+                                 "--" BOUNDARY "\r\n");
     }
+    c->part = part;
+    c->sent = 0;
+    c->last_size = -1;
+
+    #ifdef TCP_NOTSENT_LOWAT
+    if(setsockopt(c->ev.fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat)) < 0)
+        DBG("could not limit the unsent data of the stream socket\n");
+    #else
+    (void)lowat;
+    #endif
+
+    /* the watch thread starts to scale the frames for the first client */
+    if(scale > 0 && pc->scaled_clients[input_number][scale]++ == 0)
+        __atomic_or_fetch(&pc->watch[input_number].scales, 1 << scale, __ATOMIC_RELAXED);
 
-    free(frame);
+    frame_interest_add(&pglobal->in[input_number], &c->interest, fps > 0 ? fps : DEMAND_ALL);
+    metric_inc(pc->streams);
+
+    stream_flush(c);
 }
-#endif
 
 /******************************************************************************
 Description.: Send error messages and headers.
@@ -676,6 +1100,14 @@ void send_error(int fd, int which, char *message)
                 "\r\n" \
                 "403: Forbidden!\r\n" \
                 "%s", message);
+    } else if (which == 426) {
+        sprintf(buffer, "HTTP/1.1 426 Upgrade Required\r\n" \
+                "Content-type: text/plain\r\n" \
+                STD_HEADER \
+                "Sec-WebSocket-Version: 13\r\n" \
+                "\r\n" \
+                "426: Upgrade Required!\r\n" \
+                "%s", message);
     } else {
         sprintf(buffer, "HTTP/1.0 501 Not Implemented\r\n" \
                 "Content-type: text/plain\r\n" \
@@ -764,13 +1196,10 @@ void send_file(int id, int fd, char *parameter)
             "\r\n", mimetype);
     i = strlen(buffer);
 
-    /* first transmit HTTP-header, afterwards transmit content of file */
-    do {
-        if(write(fd, buffer, i) < 0) {
-            close(lfd);
-            return;
-        }
-    } while((i = read(lfd, buffer, sizeof(buffer))) > 0);
+    /* first transmit HTTP-header, afterwards let the kernel copy the file */
+    if(write(fd, buffer, i) >= 0) {
+        while(sendfile(fd, lfd, NULL, 1 << 20) > 0);
+    }
 
     /* close file, job done */
     close(lfd);
@@ -856,21 +1285,99 @@ void execute_cgi(int id, int fd, char *parameter, char *query_string)
 
 
 /******************************************************************************
-Description.: Perform a command specified by parameter. Send response to fd.
-Input Value.: * fd.......: filedescriptor to send HTTP response to.
-              * parameter: contains the command and value as string.
-              * id.......: specifies which server-context to choose.
+Description.: tells the version of the controls of a plugin, it moves
+              whenever a command may have changed them
+Input Value.: * type is A_INPUT_JSON or A_OUTPUT_JSON
+              * plugin is the number of the plugin
+Return Value: the version
+******************************************************************************/
+static unsigned long long controls_version(answer_t type, int plugin)
+{
+    if(type == A_OUTPUT_JSON)
+        return __atomic_load_n(&output_versions[plugin], __ATOMIC_RELAXED);
+
+    return command_version(&pglobal->in[plugin]);
+}
+
+/******************************************************************************
+Description.: wakes the event loop of every server, clients waiting for the
+              controls of an output plugin are answered then
+Input Value.: -
 Return Value: -
 ******************************************************************************/
-void command(int id, int fd, char *parameter)
+static void controls_changed(void)
 {
-    char buffer[BUFFER_SIZE] = {0};
-    char *command = NULL, *svalue = NULL, *value, *command_id_string;
-    int res = 0, ivalue = 0, command_id = -1,  len = 0;
+    unsigned long long one = 1;
+    int i;
 
-    DBG("parameter is: %s\n", parameter);
+    for(i = 0; i < MAX_OUTPUT_PLUGINS; i++) {
+        if(servers[i].control_ev.kind != EV_CONTROL)
+            continue;
+        if(write(servers[i].control_ev.fd, &one, sizeof(one)) < 0) {
+            DBG("could not wake the event loop\n");
+        }
+    }
+}
 
-    /* sanity check of parameter-string */
+/******************************************************************************
+Description.: Report whether a queued command of an input plugin completed
+Input Value.: * fd.......: filedescriptor to send HTTP response to.
+              * parameter: contains the plugin number as string.
+              * ticket...: was handed out when the command was queued.
+Return Value: -
+******************************************************************************/
+void command_poll(int fd, char *parameter, unsigned long long ticket)
+{
+    char buffer[BUFFER_SIZE] = {0};
+    char *value;
+    int plugin_no = 0, res = 0, status;
+
+    if((value = strstr(parameter, "plugin=")) != NULL)
+        plugin_no = atoi(value + strlen("plugin="));
+
+    if(plugin_no < 0 || plugin_no >= pglobal->incnt) {
+        send_error(fd, 404, "no such input plugin");
+        return;
+    }
+
+    status = command_status(&pglobal->in[plugin_no], ticket, &res);
+    if(status == COMMAND_UNKNOWN) {
+        send_error(fd, 404, "unknown or expired ticket");
+        return;
+    }
+
+    sprintf(buffer, "HTTP/1.0 200 OK\r\n" \
+            "Content-type: application/x-javascript\r\n" \
+            STD_HEADER \
+            "\r\n" \
+            "{\"plugin\": %d, \"ticket\": %llu, \"state\": \"%s\"",
+            plugin_no, ticket, status == COMMAND_DONE ? "done" : "pending");
+    if(status == COMMAND_DONE)
+        sprintf(buffer + strlen(buffer), ", \"result\": %d", res);
+    strcat(buffer, "}\n");
+
+    if(write(fd, buffer, strlen(buffer)) < 0) {
+        DBG("write failed, done anyway\n");
+    }
+}
+
+/******************************************************************************
+Description.: Perform a command specified by parameter. Send response to fd.
+Input Value.: * fd.......: filedescriptor to send HTTP response to.
+              * parameter: contains the command and value as string.
+              * id.......: specifies which server-context to choose.
+Return Value: -
+******************************************************************************/
+void command(int id, int fd, char *parameter)
+{
+    char buffer[BUFFER_SIZE] = {0};
+    char *command = NULL, *svalue = NULL, *value, *command_id_string;
+    int res = 0, ivalue = 0, command_id = -1,  len = 0;
+    unsigned long long ticket;
+
+    DBG("parameter is: %s\n", parameter);
+
+    /* sanity check of parameter-string */
     if(parameter == NULL || strlen(parameter) >= 255 || strlen(parameter) == 0) {
         DBG("parameter string looks bad\n");
         send_error(fd, 400, "Parameter-string of command does not look valid.");
@@ -885,7 +1392,16 @@ void command(int id, int fd, char *parameter)
         id: the control id
         group: the control's group eg. V4L2 control, jpg control, etc. This is optional
         value: value the control
+        wait: 1 to answer once the input plugin ran the command, optional
+
+       commands for input plugins are queued and answered with a ticket
+       right away, the outcome can be polled with
+        ?action=command&plugin=0&ticket=1
     */
+    if((value = strstr(parameter, "ticket=")) != NULL) {
+        command_poll(fd, parameter, strtoull(value + strlen("ticket="), NULL, 10));
+        return;
+    }
 
     /* search for required variable "command" */
     if((command = strstr(parameter, "id=")) == NULL) {
@@ -988,8 +1504,31 @@ void command(int id, int fd, char *parameter)
 
     switch(dest) {
     case Dest_Input:
-        if(plugin_no < pglobal->incnt) {
-            res = pglobal->in[plugin_no].cmd(plugin_no, command_id, group, ivalue, value);
+        if(plugin_no >= 0 && plugin_no < pglobal->incnt) {
+            ticket = command_submit(&pglobal->in[plugin_no], command_id, group, ivalue, value);
+            if(ticket == 0) {
+                send_error(fd, 500, pglobal->in[plugin_no].cmd == NULL ?
+                           "the input plugin does not accept commands" :
+                           "too many commands waiting for the input plugin");
+                free(command);
+                if(svalue != NULL) free(svalue);
+                return;
+            }
+            if(strstr(parameter, "wait=1") == NULL) {
+                sprintf(buffer, "HTTP/1.0 202 Accepted\r\n" \
+                        "Content-type: application/x-javascript\r\n" \
+                        STD_HEADER \
+                        "\r\n" \
+                        "{\"id\": \"%s\", \"plugin\": %d, \"ticket\": %llu, \"state\": \"pending\"}\n",
+                        command, plugin_no, ticket);
+                if(write(fd, buffer, strlen(buffer)) < 0) {
+                    DBG("write failed, done anyway\n");
+                }
+                free(command);
+                if(svalue != NULL) free(svalue);
+                return;
+            }
+            command_wait(&pglobal->in[plugin_no], ticket, &res);
         } else {
             DBG("Invalid plugin number: %d because only %d input plugins loaded", plugin_no,  pglobal->incnt-1);
         }
@@ -997,6 +1536,8 @@ void command(int id, int fd, char *parameter)
     case Dest_Output:
         if(plugin_no < pglobal->outcnt) {
             res = pglobal->out[plugin_no].cmd(plugin_no, command_id, group, ivalue, value);
+            __atomic_add_fetch(&output_versions[plugin_no], 1, __ATOMIC_RELAXED);
+            controls_changed();
         } else {
             DBG("Invalid plugin number: %d because only %d output plugins loaded", plugin_no,  pglobal->incnt-1);
         }
@@ -1023,49 +1564,62 @@ void command(int id, int fd, char *parameter)
 }
 
 /******************************************************************************
-Description.: Serve a connected TCP-client. This thread function is called
-              for each connect of a HTTP client like a webbrowser. It determines
-              if it is a valid HTTP request and dispatches between the different
-              response options.
-Input Value.: arg is the filedescriptor and server-context of the connected TCP
-              socket. It must have been allocated so it is freeable by this
-              thread function.
-Return Value: always NULL
+Description.: Tests if a string starts with a prefix
+Input Value.: * s is the string
+              * prefix is the prefix
+Return Value: 1 if it does, 0 otherwise
 ******************************************************************************/
-/* thread for clients that connected to this server */
-void *client_thread(void *arg)
+static int starts_with(const char *s, const char *prefix)
+{
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+/******************************************************************************
+Description.: Parse the request header of a client. It determines if it is a
+              valid HTTP request and which response is wanted. The strings
+              of the request point into head, which is modified.
+Input Value.: * lcfd.........: filedescriptor and server-context of the client
+              * head.........: the complete request header
+              * preq.........: receives the request
+              * pinput_number: receives the plugin number of the request
+Return Value: 0 if the request should be answered, -1 if an error was sent
+              already and the connection should just be closed
+******************************************************************************/
+static int parse_request(cfd lcfd, char *head, request *preq, int *pinput_number)
 {
-    int cnt;
     char query_suffixed = 0;
     int input_number = 0;
-    char buffer[BUFFER_SIZE] = {0}, *pb = buffer;
-    iobuffer iobuf;
+    char *pb, suffix = '\0';
+    int get, post, i, rc;
+    int upgrade_websocket = 0, connection_upgrade = 0;
+    request_head h;
     request req;
-    cfd lcfd; /* local-connected-file-descriptor */
-
-    /* we really need the fildescriptor and it must be freeable by us */
-    if(arg != NULL) {
-        memcpy(&lcfd, arg, sizeof(cfd));
-        free(arg);
-    } else
-        return NULL;
 
     /* initializes the structures */
-    init_iobuffer(&iobuf);
     init_request(&req);
 
-    /* What does the client want to receive? Read the request. */
-    memset(buffer, 0, sizeof(buffer));
-    if((cnt = _readline(lcfd.fd, &iobuf, buffer, sizeof(buffer) - 1, 5)) == -1) {
-        close(lcfd.fd);
-        return NULL;
+    /* What does the client want to receive? Split the request. */
+    if((rc = split_head(head, &h)) < 0) {
+        DBG("HTTP request seems to be malformed\n");
+        send_error(lcfd.fd, 400, rc == -2 ? "Too many header fields" : "Malformed HTTP request");
+        return -1;
     }
 
-    req.query_string = NULL;
+    get = strcmp(h.method, "GET") == 0;
+    post = strcmp(h.method, "POST") == 0;
+
+    /* the parameters are cut out of the target in place, look at the suffix first */
+    if((pb = strchr(h.target, '_')) != NULL)
+        suffix = pb[1];
+
+    /* HTTP/1.1 connections persist unless the client closes them */
+    req.http11 = strcmp(h.version, "HTTP/1.1") == 0;
+    req.keep_alive = req.http11;
 
     /* determine what to deliver */
-    if(strstr(buffer, "GET /?action=snapshot") != NULL) {
+    if(get && starts_with(h.target, "/?action=snapshot")) {
         req.type = A_SNAPSHOT;
+        req.wait = strstr(h.target, "wait=1") != NULL;
         query_suffixed = 255;
         #ifdef MANAGMENT
         if (check_client_status(lcfd.client)) {
@@ -1076,7 +1630,7 @@ void *client_thread(void *arg)
         }
         #endif
     #ifdef WXP_COMPAT
-    } else if((strstr(buffer, "GET /cam") != NULL) && (strstr(buffer, ".jpg") != NULL)) {
+    } else if(get && starts_with(h.target, "/cam") && strstr(h.target, ".jpg") != NULL) {
         req.type = A_SNAPSHOT_WXP;
         query_suffixed = 255;
         #ifdef MANAGMENT
@@ -1088,7 +1642,7 @@ void *client_thread(void *arg)
         }
         #endif
     #endif
-    } else if(strstr(buffer, "POST /stream") != NULL) {
+    } else if(post && starts_with(h.target, "/stream")) {
         req.type = A_STREAM;
         query_suffixed = 255;
         #ifdef MANAGMENT
@@ -1099,9 +1653,20 @@ void *client_thread(void *arg)
             query_suffixed = 0;
         }
         #endif
-    } else if(strstr(buffer, "GET /?action=stream") != NULL) {
+    } else if(get && starts_with(h.target, "/?action=stream")) {
         req.type = A_STREAM;
         query_suffixed = 255;
+
+        /* a client may ask for fewer or smaller frames */
+        if((pb = strstr(h.target, "fps=")) != NULL)
+            req.fps = MAX(atoi(pb + strlen("fps=")), 0);
+        if((pb = strstr(h.target, "scale=1/")) != NULL) {
+            switch(atoi(pb + strlen("scale=1/"))) {
+            case 2: req.scale = 1; break;
+            case 4: req.scale = 2; break;
+            case 8: req.scale = 3; break;
+            }
+        }
         #ifdef MANAGMENT
         if (check_client_status(lcfd.client)) {
             req.type = A_UNKNOWN;
@@ -1111,7 +1676,7 @@ void *client_thread(void *arg)
         }
         #endif
     #ifdef WXP_COMPAT
-    } else if((strstr(buffer, "GET /cam") != NULL) && (strstr(buffer, ".mjpg") != NULL)) {
+    } else if(get && starts_with(h.target, "/cam") && strstr(h.target, ".mjpg") != NULL) {
         req.type = A_STREAM_WXP;
         query_suffixed = 255;
         #ifdef MANAGMENT
@@ -1123,125 +1688,118 @@ void *client_thread(void *arg)
         }
         #endif
     #endif
-    } else if(strstr(buffer, "GET /?action=take") != NULL) {
-        int len;
+    } else if(get && starts_with(h.target, "/?action=websocket")) {
+        req.type = A_WEBSOCKET;
+        query_suffixed = 255;
+        req.ack = strstr(h.target, "ack=1") != NULL;
+
+        /* a client may ask for fewer or smaller frames */
+        if((pb = strstr(h.target, "fps=")) != NULL)
+            req.fps = MAX(atoi(pb + strlen("fps=")), 0);
+        if((pb = strstr(h.target, "scale=1/")) != NULL) {
+            switch(atoi(pb + strlen("scale=1/"))) {
+            case 2: req.scale = 1; break;
+            case 4: req.scale = 2; break;
+            case 8: req.scale = 3; break;
+            }
+        }
+        #ifdef MANAGMENT
+        if (check_client_status(lcfd.client)) {
+            req.type = A_UNKNOWN;
+            lcfd.client->last_take_time.tv_sec += piggy_fine;
+            send_error(lcfd.fd, 403, "frame already sent");
+            query_suffixed = 0;
+        }
+        #endif
+    } else if(get && starts_with(h.target, "/?action=take")) {
         req.type = A_TAKE;
         query_suffixed = 255;
 
         /* advance by the length of known string */
-        if((pb = strstr(buffer, "GET /?action=take")) == NULL) {
-            DBG("HTTP request seems to be malformed\n");
-            send_error(lcfd.fd, 400, "Malformed HTTP request");
-            close(lcfd.fd);
-            query_suffixed = 0;
-            return NULL;
-        }
-        pb += strlen("GET /?action=take"); // a pb points to thestring after the first & after command
+        pb = h.target + strlen("/?action=take");
 
         /* only accept certain characters */
-        len = MIN(MAX(strspn(pb, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_-=&1234567890%./"), 0), 100);
-        req.parameter = malloc(len + 1);
-        if(req.parameter == NULL) {
-            exit(EXIT_FAILURE);
-        }
-        memset(req.parameter, 0, len + 1);
-        strncpy(req.parameter, pb, len);
+        pb[MIN(strspn(pb, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_-=&1234567890%./"), 100)] = '\0';
+        req.parameter = pb;
 
         if(unescape(req.parameter) == -1) {
-            free(req.parameter);
             send_error(lcfd.fd, 500, "could not properly unescape command parameter string");
             LOG("could not properly unescape command parameter string\n");
-            close(lcfd.fd);
-            return NULL;
+            return -1;
         }
-    } else if((strstr(buffer, "GET /input") != NULL) && (strstr(buffer, ".json") != NULL)) {
+    } else if(get && starts_with(h.target, "/input") && strstr(h.target, ".json") != NULL) {
         req.type = A_INPUT_JSON;
         query_suffixed = 255;
-    } else if((strstr(buffer, "GET /output") != NULL) && (strstr(buffer, ".json") != NULL)) {
+    } else if(get && starts_with(h.target, "/output") && strstr(h.target, ".json") != NULL) {
         req.type = A_OUTPUT_JSON;
         query_suffixed = 255;
-    } else if(strstr(buffer, "GET /program.json") != NULL) {
+    } else if(get && starts_with(h.target, "/program.json")) {
         req.type = A_PROGRAM_JSON;
+    } else if(get && starts_with(h.target, "/latency.json")) {
+        req.type = A_LATENCY_JSON;
+    } else if(get && starts_with(h.target, "/metrics")) {
+        req.type = A_METRICS;
     #ifdef MANAGMENT
-    } else if(strstr(buffer, "GET /clients.json") != NULL) {
+    } else if(get && starts_with(h.target, "/clients.json")) {
         req.type = A_CLIENTS_JSON;
     #endif
-    } else if(strstr(buffer, "GET /?action=command") != NULL) {
-        int len;
+    } else if(get && starts_with(h.target, "/?action=command")) {
         req.type = A_COMMAND;
 
         /* advance by the length of known string */
-        if((pb = strstr(buffer, "GET /?action=command")) == NULL) {
-            DBG("HTTP request seems to be malformed\n");
-            send_error(lcfd.fd, 400, "Malformed HTTP request");
-            close(lcfd.fd);
-            return NULL;
-        }
-        pb += strlen("GET /?action=command"); // a pb points to thestring after the first & after command
+        pb = h.target + strlen("/?action=command");
 
         /* only accept certain characters */
-        len = MIN(MAX(strspn(pb, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_-=&1234567890%./"), 0), 100);
-
-        req.parameter = malloc(len + 1);
-        if(req.parameter == NULL) {
-            exit(EXIT_FAILURE);
-        }
-        memset(req.parameter, 0, len + 1);
-        strncpy(req.parameter, pb, len);
+        pb[MIN(strspn(pb, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_-=&1234567890%./"), 100)] = '\0';
+        req.parameter = pb;
 
         if(unescape(req.parameter) == -1) {
-            free(req.parameter);
             send_error(lcfd.fd, 500, "could not properly unescape command parameter string");
             LOG("could not properly unescape command parameter string\n");
-            close(lcfd.fd);
-            return NULL;
+            return -1;
         }
 
-        DBG("command parameter (len: %d): \"%s\"\n", len, req.parameter);
+        DBG("command parameter: \"%s\"\n", req.parameter);
     } else {
+        char *query;
         int len;
 
         DBG("try to serve a file\n");
         req.type = A_FILE;
 
-        if((pb = strstr(buffer, "GET /")) == NULL) {
+        if(!get || h.target[0] != '/') {
             DBG("HTTP request seems to be malformed\n");
             send_error(lcfd.fd, 400, "Malformed HTTP request");
-            close(lcfd.fd);
-            return NULL;
-        }
-
-        pb += strlen("GET /");
-        len = MIN(MAX(strspn(pb, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ._-1234567890"), 0), 100);
-        req.parameter = malloc(len + 1);
-        if(req.parameter == NULL) {
-            exit(EXIT_FAILURE);
+            return -1;
         }
 
-        memset(req.parameter, 0, len + 1);
-        strncpy(req.parameter, pb, len);
+        pb = h.target + 1;
+        len = MIN(strspn(pb, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ._-1234567890"), 100);
+        query = strchr(pb, '?');
 
         if (strstr(pb, ".cgi") != NULL) {
             req.type = A_CGI;
-            pb = strchr(pb, '?');
-            if (pb != NULL) {
-                pb++; // skip the ?
-                len = strspn(pb, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ._-1234567890=&");
-                req.query_string = malloc(len + 1);
-                if (req.query_string == NULL)
-                    exit(EXIT_FAILURE);
-                memset(req.query_string, 0, len + 1);
-                strncpy(req.query_string, pb, len);
+            if (query != NULL) {
+                query++; // skip the ?
+                query[strspn(query, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ._-1234567890=&")] = '\0';
+                req.query_string = query;
             } else {
-                req.query_string = malloc(2);
-                if (req.query_string == NULL)
-                    exit(EXIT_FAILURE);
-                sprintf(req.query_string, " ");
+                req.query_string = " ";
             }
         }
+
+        pb[len] = '\0';
+        req.parameter = pb;
         DBG("parameter (len: %d): \"%s\"\n", len, req.parameter);
     }
 
+    /* a client knowing a version of the controls waits for the next one */
+    if((req.type == A_INPUT_JSON || req.type == A_OUTPUT_JSON) &&
+       (pb = strstr(h.target, "version=")) != NULL) {
+        req.poll = 1;
+        req.version = strtoull(pb + strlen("version="), NULL, 10);
+    }
+
     /*
      * Since when we are working with multiple input plugins
      * there are some url which could have a _[plugin number suffix]
@@ -1249,13 +1807,9 @@ void *client_thread(void *arg)
      * generated from the 0. input plugin
      */
     if(query_suffixed) {
-        char *sch = strchr(buffer, '_');
-        if(sch != NULL) {  // there is an _ in the url so the input number should be present
-            DBG("Suffix character: %s\n", sch + 1); // FIXME if more than 10 input plugin is added
-            char numStr[3];
-            memset(numStr, 0, 3);
-            strncpy(numStr, sch + 1, 1);
-            input_number = atoi(numStr);
+        if(suffix != '\0') {  // there is an _ in the url so the input number should be present
+            DBG("Suffix character: %c\n", suffix); // FIXME if more than 10 input plugin is added
+            input_number = isdigit((unsigned char)suffix) ? suffix - '0' : 0;
 
             if ((req.type == A_SNAPSHOT_WXP) || (req.type == A_STREAM_WXP)) { // webcamxp adds offset to the camera number
                 input_number--;
@@ -1264,41 +1818,76 @@ void *client_thread(void *arg)
         DBG("plugin_no: %d\n", input_number);
     }
 
-    /*
-     * parse the rest of the HTTP-request
-     * the end of the request-header is marked by a single, empty line with "\r\n"
-     */
-    do {
-        memset(buffer, 0, sizeof(buffer));
-
-        if((cnt = _readline(lcfd.fd, &iobuf, buffer, sizeof(buffer) - 1, 5)) == -1) {
-            free_request(&req);
-            close(lcfd.fd);
-            return NULL;
-        }
+    /* the header fields that matter */
+    for(i = 0; i < h.count; i++) {
+        const char *name = h.fields[i].name;
+        char *value = h.fields[i].value;
 
-        if(strcasestr(buffer, "User-Agent: ") != NULL) {
-            req.client = strdup(buffer + strlen("User-Agent: "));
-        } else if(strcasestr(buffer, "Authorization: Basic ") != NULL) {
-            req.credentials = strdup(buffer + strlen("Authorization: Basic "));
+        if(strcasecmp(name, "User-Agent") == 0) {
+            req.client = value;
+        } else if(strcasecmp(name, "Authorization") == 0 && strncmp(value, "Basic ", strlen("Basic ")) == 0) {
+            req.credentials = value + strlen("Basic ");
             decodeBase64(req.credentials);
             DBG("username:password: %s\n", req.credentials);
+        } else if(strcasecmp(name, "Connection") == 0) {
+            if(strcasestr(value, "close") != NULL)
+                req.keep_alive = 0;
+            else if(strcasestr(value, "keep-alive") != NULL)
+                req.keep_alive = 1;
+            if(strcasestr(value, "upgrade") != NULL)
+                connection_upgrade = 1;
+        } else if(strcasecmp(name, "Upgrade") == 0) {
+            upgrade_websocket = strcasestr(value, "websocket") != NULL;
+        } else if(strcasecmp(name, "If-None-Match") == 0) {
+            req.etag = value;
+        } else if(strcasecmp(name, "Accept-Encoding") == 0) {
+            req.gzip = strstr(value, "gzip") != NULL;
+        } else if(strcasecmp(name, "Sec-WebSocket-Key") == 0) {
+            req.ws_key = value;
+        } else if(strcasecmp(name, "Sec-WebSocket-Version") == 0) {
+            req.ws_version = atoi(value);
+        } else if(strcasecmp(name, "Content-Length") == 0) {
+            /* a body is never read, it must not be taken for the next request */
+            if(atoi(value) > 0)
+                req.keep_alive = 0;
         }
-
-    } while(cnt > 2 && !(buffer[0] == '\r' && buffer[1] == '\n'));
+    }
+    req.upgrade = upgrade_websocket && connection_upgrade;
 
     /* check for username and password if parameter -c was given */
     if(lcfd.pc->conf.credentials != NULL) {
         if(req.credentials == NULL || strcmp(lcfd.pc->conf.credentials, req.credentials) != 0) {
             DBG("access denied\n");
             send_error(lcfd.fd, 401, "username and password do not match to configuration");
-            close(lcfd.fd);
-            free_request(&req);
-            return NULL;
+            return -1;
         }
         DBG("access granted\n");
     }
 
+    /* a handshake needs all of its fields, and only version 13 of the
+       protocol is spoken */
+    if(req.type == A_WEBSOCKET) {
+        if(!req.http11 || !req.upgrade || req.ws_key == NULL) {
+            DBG("WebSocket request without a complete handshake\n");
+            send_error(lcfd.fd, 400, "Not a WebSocket handshake");
+            return -1;
+        }
+        if(req.ws_version != 13) {
+            DBG("WebSocket version %d is not supported\n", req.ws_version);
+            send_error(lcfd.fd, 426, "only WebSocket version 13 is supported");
+            return -1;
+        }
+    }
+
+#ifdef NO_LIBJPEG
+    /* without libjpeg frames are only sent the way the input published them */
+    if(req.scale > 0) {
+        DBG("scaling frames needs libjpeg\n");
+        send_error(lcfd.fd, 501, "this server can not scale frames");
+        return -1;
+    }
+#endif
+
     /* now it's time to answer */
     if (query_suffixed) {
         if (req.type == A_OUTPUT_JSON) {
@@ -1316,22 +1905,29 @@ void *client_thread(void *arg)
         }
     }
 
+    *preq = req;
+    *pinput_number = input_number;
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: Answer a parsed request of a client, runs in a worker thread
+              and may block. Streams are sent by the event loop instead.
+Input Value.: * lcfd........: filedescriptor to write the answer to and
+                              server-context of the client
+              * req.........: the request
+              * input_number: plugin number of the request
+Return Value: -
+******************************************************************************/
+static void serve_request(cfd lcfd, request req, int input_number)
+{
     switch(req.type) {
     case A_SNAPSHOT_WXP:
     case A_SNAPSHOT:
         DBG("Request for snapshot from input: %d\n", input_number);
-        send_snapshot(&lcfd, input_number);
-        break;
-    case A_STREAM:
-        DBG("Request for stream from input: %d\n", input_number);
-        send_stream(&lcfd, input_number);
-        break;
-    #ifdef WXP_COMPAT
-    case A_STREAM_WXP:
-        DBG("Request for WXP compat stream from input: %d\n", input_number);
-        send_stream_wxp(&lcfd, input_number);
+        send_snapshot(&lcfd, input_number, &req, 0);
         break;
-    #endif
     case A_COMMAND:
         if(lcfd.pc->conf.nocommands) {
             send_error(lcfd.fd, 501, "this server is configured to not accept commands");
@@ -1341,16 +1937,24 @@ void *client_thread(void *arg)
         break;
     case A_INPUT_JSON:
         DBG("Request for the Input plugin descriptor JSON file\n");
-        send_input_JSON(lcfd.fd, input_number);
+        send_input_JSON(lcfd.fd, input_number, &req);
         break;
     case A_OUTPUT_JSON:
         DBG("Request for the Output plugin descriptor JSON file\n");
-        send_output_JSON(lcfd.fd, input_number);
+        send_output_JSON(lcfd.fd, input_number, &req);
         break;
     case A_PROGRAM_JSON:
         DBG("Request for the program descriptor JSON file\n");
         send_program_JSON(lcfd.fd);
         break;
+    case A_LATENCY_JSON:
+        DBG("Request for the latency histogram JSON file\n");
+        send_latency_JSON(lcfd.fd);
+        break;
+    case A_METRICS:
+        DBG("Request for the metrics\n");
+        send_metrics(lcfd.fd);
+        break;
     #ifdef MANAGMENT
     case A_CLIENTS_JSON:
         DBG("Request for the clients JSON file\n");
@@ -1400,30 +2004,776 @@ void *client_thread(void *arg)
             }
         }
 
-        if (found == 0) {
-            LOG("FILE CHANGE TEST output plugin not loaded\n");
-            send_error(lcfd.fd, 404, "FILE output plugin not loaded, taking snapshot not possible");
-        } else {
-            if (ret == 0) {
-                send_snapshot(&lcfd, input_number);
-            } else {
-                send_error(lcfd.fd, 404, "Taking snapshot failed!");
+        if (found == 0) {
+            LOG("FILE CHANGE TEST output plugin not loaded\n");
+            send_error(lcfd.fd, 404, "FILE output plugin not loaded, taking snapshot not possible");
+        } else {
+            if (ret == 0) {
+                send_snapshot(&lcfd, input_number, NULL, 0);
+            } else {
+                send_error(lcfd.fd, 404, "Taking snapshot failed!");
+            }
+        }
+        } break;
+    case A_CGI:
+        DBG("cgi script: %s requested\n", req.parameter);
+        execute_cgi(lcfd.pc->id, lcfd.fd, req.parameter, req.query_string);
+        break;
+    default:
+        DBG("unknown request\n");
+    }
+}
+
+/******************************************************************************
+Description.: Sends a file of the www folder without copying it through
+              the worker, from the cache or with sendfile(). The ETag is
+              made of size and modification time, a matching If-None-Match
+              is answered with 304.
+Input Value.: * pc is the server-context
+              * fd is the socket of the client
+              * req is the request
+              * keep_alive is set if the client wants the connection to persist
+Return Value: 1 if the connection may serve the next request, 0 if it must
+              be closed, -1 if the file could not be sent and send_file()
+              has to answer
+******************************************************************************/
+static int send_static(context *pc, int fd, request *req, int keep_alive)
+{
+    char path[BUFFER_SIZE], header[BUFFER_SIZE], etag[48];
+    const char *name = req->parameter, *extension, *mimetype = NULL;
+    const unsigned char *body = NULL;
+    size_t body_len = 0;
+    struct stat st;
+    www_file *f;
+    int i, len, lfd = -1, gzip = 0, ok;
+
+    if(pc->conf.www_folder == NULL)
+        return -1;
+
+    if(name == NULL || name[0] == '\0')
+        name = "index.html";
+
+    if((extension = strrchr(name, '.')) == NULL || extension == name)
+        return -1;
+
+    for(i = 0; i < LENGTH_OF(mimetypes); i++) {
+        if(strcmp(mimetypes[i].dot_extension, extension) == 0) {
+            mimetype = mimetypes[i].mimetype;
+            break;
+        }
+    }
+    if(mimetype == NULL)
+        return -1;
+
+    snprintf(path, sizeof(path), "%s%s", pc->conf.www_folder, name);
+    if(stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+        return -1;
+
+    snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)st.st_size, (unsigned long long)st.st_mtime);
+
+    if(req->etag != NULL && strstr(req->etag, etag) != NULL) {
+        len = snprintf(header, sizeof(header), "HTTP/1.%d 304 Not Modified\r\n" \
+                       "ETag: %s\r\n" \
+                       "Cache-Control: no-cache\r\n", req->http11, etag);
+        len += connection_header(header + len, sizeof(header) - len, keep_alive);
+        return write_all(fd, header, len) < 0 ? 0 : keep_alive;
+    }
+
+    /* a file changed since startup is read from the disk */
+    f = www_cache_find(&pc->cache, name);
+    if(f != NULL && f->size == st.st_size && f->mtime == st.st_mtime) {
+        if(req->gzip && f->gzip != NULL) {
+            body = f->gzip;
+            body_len = f->gzip_size;
+            gzip = 1;
+        } else {
+            body = f->data;
+            body_len = f->size;
+        }
+    } else {
+        if((lfd = open(path, O_RDONLY)) < 0)
+            return -1;
+        body_len = st.st_size;
+    }
+
+    len = snprintf(header, sizeof(header), "HTTP/1.%d 200 OK\r\n" \
+                   "Content-type: %s\r\n" \
+                   "Content-Length: %zu\r\n" \
+                   "ETag: %s\r\n" \
+                   "Server: MJPG-Streamer/0.2\r\n" \
+                   "Cache-Control: no-cache\r\n" \
+                   "%s%s", req->http11, mimetype, body_len, etag,
+                   f != NULL && f->gzip != NULL ? "Vary: Accept-Encoding\r\n" : "",
+                   gzip ? "Content-Encoding: gzip\r\n" : "");
+    len += connection_header(header + len, sizeof(header) - len, keep_alive);
+
+    if(lfd >= 0) {
+        ok = write_all(fd, header, len) == 0 && sendfile_all(fd, lfd, 0, body_len) == 0;
+        close(lfd);
+    } else {
+        ok = send_all(fd, header, len, body, body_len) == 0;
+    }
+
+    return ok ? keep_alive : 0;
+}
+
+/******************************************************************************
+Description.: Sends an answer that was written to memory to the client. The
+              header gets the version of the request, the length of the body
+              and tells whether the connection persists.
+Input Value.: * fd is the socket of the client
+              * mfd is the memory file holding the answer
+              * http11 is set if the client asked with HTTP/1.1
+              * keep_alive is set if the client wants the connection to persist
+Return Value: 1 if the connection may serve the next request, 0 otherwise
+******************************************************************************/
+static int send_response(int fd, int mfd, int http11, int keep_alive)
+{
+    char header[HEADER_MAX], *data, *line, *eol, *end;
+    off_t size, body;
+    size_t len = 0;
+
+    if((size = lseek(mfd, 0, SEEK_END)) <= 0)
+        return 0;
+
+    if((data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, mfd, 0)) == MAP_FAILED) {
+        sendfile_all(fd, mfd, 0, size);
+        return 0;
+    }
+
+    /* the output of CGI scripts has no status line, it ends with the connection */
+    end = memmem(data, MIN(size, HEADER_MAX - 256), "\r\n\r\n", 4);
+    if(end == NULL || strncmp(data, "HTTP/1.", 7) != 0) {
+        munmap(data, size);
+        sendfile_all(fd, mfd, 0, size);
+        return 0;
+    }
+    end += 2;
+
+    for(line = data; line < end; line = eol + 2) {
+        eol = memmem(line, end - line, "\r\n", 2);
+
+        if(line == data) {
+            memcpy(header, http11 ? "HTTP/1.1" : "HTTP/1.0", 8);
+            memcpy(header + 8, line + 8, eol + 2 - line - 8);
+            len = eol + 2 - line;
+        } else if(strncasecmp(line, "Connection:", 11) != 0 &&
+                  strncasecmp(line, "Keep-Alive:", 11) != 0 &&
+                  strncasecmp(line, "Content-Length:", 15) != 0) {
+            memcpy(header + len, line, eol + 2 - line);
+            len += eol + 2 - line;
+        }
+    }
+
+    body = end + 2 - data;
+    munmap(data, size);
+
+    len += snprintf(header + len, sizeof(header) - len, "Content-Length: %lld\r\n", (long long)(size - body));
+    len += connection_header(header + len, sizeof(header) - len, keep_alive);
+
+    if(write_all(fd, header, len) < 0 || sendfile_all(fd, mfd, body, size - body) < 0)
+        return 0;
+
+    return keep_alive;
+}
+
+/******************************************************************************
+Description.: Answers a queued request. Files of the www folder and snapshots
+              are sent directly, other answers are written to memory first to learn
+              their length. A persistent connection returns to the event loop.
+Input Value.: * pcontext is the server-context
+              * j is the job, it is freed or handed back
+Return Value: -
+******************************************************************************/
+static void serve_job(context *pcontext, job *j)
+{
+    cfd lcfd = j->lcfd;
+    int http11 = j->req.http11, keep_alive = j->req.keep_alive;
+    unsigned long long one = 1;
+
+    if(j->req.type == A_FILE)
+        j->keep_alive = send_static(pcontext, j->lcfd.fd, &j->req, keep_alive);
+    else if(j->req.type == A_SNAPSHOT || j->req.type == A_SNAPSHOT_WXP)
+        j->keep_alive = send_snapshot(&j->lcfd, j->input, &j->req, keep_alive);
+    else
+        j->keep_alive = -1;
+
+    if(j->keep_alive >= 0) {
+        /* answered directly */
+    } else if((lcfd.fd = memfd_create("response", MFD_CLOEXEC)) < 0) {
+        /* the answer is written to the socket piece by piece, which only
+           works blocking, the connection closes behind it */
+        lcfd.fd = j->lcfd.fd;
+        fcntl(lcfd.fd, F_SETFL, fcntl(lcfd.fd, F_GETFL) & ~O_NONBLOCK);
+        serve_request(lcfd, j->req, j->input);
+        j->keep_alive = 0;
+    } else {
+        serve_request(lcfd, j->req, j->input);
+        j->keep_alive = send_response(j->lcfd.fd, lcfd.fd, http11, keep_alive);
+        close(lcfd.fd);
+    }
+
+    if(!j->keep_alive || pglobal->stop) {
+        close(j->lcfd.fd);
+        free(j->head);
+        free(j);
+        return;
+    }
+
+    pthread_mutex_lock(&pcontext->jobs_mutex);
+    j->next = pcontext->returned;
+    pcontext->returned = j;
+    pthread_mutex_unlock(&pcontext->jobs_mutex);
+
+    if(write(pcontext->returned_ev.fd, &one, sizeof(one)) < 0) {
+        DBG("could not wake the event loop\n");
+    }
+}
+
+/******************************************************************************
+Description.: A worker thread, it answers the requests the event loop queued
+              one after the other
+Input Value.: arg is the server-context
+Return Value: never returns
+******************************************************************************/
+static void *worker_thread(void *arg)
+{
+    context *pcontext = arg;
+    job *j;
+
+    while(1) {
+        pthread_mutex_lock(&pcontext->jobs_mutex);
+        while(pcontext->jobs == NULL)
+            pthread_cond_wait(&pcontext->jobs_cond, &pcontext->jobs_mutex);
+
+        j = pcontext->jobs;
+        pcontext->jobs = j->next;
+        if(pcontext->jobs == NULL)
+            pcontext->jobs_tail = NULL;
+        pthread_mutex_unlock(&pcontext->jobs_mutex);
+
+        serve_job(pcontext, j);
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: Waits for the frames of an input and wakes the event loop for
+              each of them through an eventfd. The clients of the original
+              size are woken first, then the frame is scaled once to every
+              size stream clients asked for and the loop is woken again.
+Input Value.: arg is the frame_watch of the input
+Return Value: never returns
+******************************************************************************/
+static void *watch_thread(void *arg)
+{
+    frame_watch *w = arg;
+    input *in = &pglobal->in[w->input];
+    unsigned long long seq = 0, one = 1;
+    frame_slot *slot;
+    stream_part *part, *old;
+    int scales, i;
+
+    while(1) {
+        slot = wait_for_frame(in, seq, -1);
+        seq = slot->seq;
+
+        if(write(w->ev.fd, &one, sizeof(one)) < 0) {
+            DBG("could not wake the event loop\n");
+        }
+
+        scales = __atomic_load_n(&w->scales, __ATOMIC_RELAXED);
+        if(scales == 0) {
+            frame_unref(in, slot);
+            continue;
+        }
+
+        /* only the wait may be cancelled, a scaled frame is never half stored */
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        for(i = 1; i < STREAM_SCALES; i++) {
+            if(!(scales & (1 << i)))
+                continue;
+
+            /* without memory the clients of this size skip the frame */
+            if((part = scaled_part(w->input, slot, i)) == NULL)
+                continue;
+
+            pthread_mutex_lock(&w->lock);
+            old = w->scaled[i];
+            w->scaled[i] = part;
+            pthread_mutex_unlock(&w->lock);
+
+            if(old != NULL)
+                part_unref(old);
+        }
+        frame_unref(in, slot);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+
+        if(write(w->ev.fd, &one, sizeof(one)) < 0) {
+            DBG("could not wake the event loop\n");
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: Waits for the commands an input runs and wakes the event loop
+              for each of them through an eventfd
+Input Value.: arg is the control_watch of the input
+Return Value: never returns
+******************************************************************************/
+static void *control_thread(void *arg)
+{
+    control_watch *w = arg;
+    input *in = &pglobal->in[w->input];
+    unsigned long long version = command_version(in), one = 1;
+
+    while(1) {
+        version = command_wait_version(in, version);
+
+        if(write(w->fd, &one, sizeof(one)) < 0) {
+            DBG("could not wake the event loop\n");
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: Adds a non-blocking socket to the event loop to read a request
+Input Value.: * lcfd is the socket and its server-context
+              * head is the buffer for the request, NULL to allocate one
+              * timeout is the time in ms the request may take to arrive
+Return Value: the connection, NULL if it could not be added, the socket and
+              head are freed then
+******************************************************************************/
+static connection *conn_add(cfd lcfd, char *head, int timeout)
+{
+    context *pcontext = lcfd.pc;
+    struct epoll_event ev;
+    connection *c;
+
+    if((c = calloc(1, sizeof(connection))) == NULL ||
+       (head == NULL && (head = malloc(HEADER_MAX + 1)) == NULL)) {
+        fprintf(stderr, "failed to allocate (a very small amount of) memory\n");
+        free(c);
+        free(head);
+        close(lcfd.fd);
+        return NULL;
+    }
+
+    c->ev.kind = EV_CLIENT;
+    c->ev.fd = lcfd.fd;
+    c->lcfd = lcfd;
+    c->head = head;
+    c->state = CONN_REQUEST;
+    c->since = latency_now();
+    c->timeout = timeout;
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    if(epoll_ctl(pcontext->epfd, EPOLL_CTL_ADD, lcfd.fd, &ev) < 0) {
+        DBG("could not watch the client: %s\n", strerror(errno));
+        free(c->head);
+        free(c);
+        close(lcfd.fd);
+        return NULL;
+    }
+
+    c->next = pcontext->conns;
+    if(c->next != NULL)
+        c->next->prev = c;
+    pcontext->conns = c;
+
+    return c;
+}
+
+/******************************************************************************
+Description.: Accepts all pending connections of a listening socket and adds
+              them to the event loop
+Input Value.: * pcontext is the server-context
+              * sd is the listening socket
+Return Value: -
+******************************************************************************/
+static void accept_clients(context *pcontext, int sd)
+{
+    struct sockaddr_storage client_addr;
+    socklen_t addr_len;
+    char name[NI_MAXHOST];
+    cfd lcfd;
+    int fd;
+
+    while(1) {
+        addr_len = sizeof(client_addr);
+        if((fd = accept4(sd, (struct sockaddr *)&client_addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                DBG("accept failed: %s\n", strerror(errno));
+            return;
+        }
+        metric_inc(pcontext->connections);
+
+        name[0] = '\0';
+        if(getnameinfo((struct sockaddr *)&client_addr, addr_len, name, sizeof(name), NULL, 0, NI_NUMERICHOST) == 0) {
+            DBG("serving client: %s\n", name);
+        }
+
+        memset(&lcfd, 0, sizeof(lcfd));
+        lcfd.fd = fd;
+        lcfd.pc = pcontext;
+        #if defined(MANAGMENT)
+        lcfd.client = add_client(name);
+        #endif
+        conn_add(lcfd, NULL, REQUEST_TIMEOUT);
+    }
+}
+
+/******************************************************************************
+Description.: Finds the end of a request header
+Input Value.: head is the received data, terminated by a zero
+Return Value: the first byte behind the empty line, NULL if it is incomplete
+******************************************************************************/
+static char *header_end(char *head)
+{
+    char *crlf = strstr(head, "\r\n\r\n"), *lf = strstr(head, "\n\n");
+
+    if(crlf != NULL && (lf == NULL || crlf < lf))
+        return crlf + 4;
+    if(lf != NULL)
+        return lf + 2;
+    return NULL;
+}
+
+/******************************************************************************
+Description.: Queues a parsed request for the workers, they own the socket
+              from now on
+Input Value.: * c is the connection, it is released
+              * req is the request
+              * input_number is the plugin of the request
+              * rest is the offset of the bytes behind the request in c->head
+Return Value: -
+******************************************************************************/
+static void conn_dispatch(connection *c, request *req, int input_number, int rest)
+{
+    context *pcontext = c->lcfd.pc;
+    job *j;
+
+    if((j = malloc(sizeof(job))) == NULL) {
+        conn_close(c);
+        return;
+    }
+    j->lcfd = c->lcfd;
+    j->req = *req;
+    j->input = input_number;
+    j->head = c->head;
+    j->rest = rest;
+    j->rest_len = c->head_len - j->rest;
+    j->next = NULL;
+
+    /* the worker owns the socket now, it stays non-blocking so a client
+       that stops reading only holds the worker for SEND_TIMEOUT */
+    c->head = NULL;
+    conn_release(c);
+
+    pthread_mutex_lock(&pcontext->jobs_mutex);
+    if(pcontext->jobs_tail != NULL)
+        pcontext->jobs_tail->next = j;
+    else
+        pcontext->jobs = j;
+    pcontext->jobs_tail = j;
+    pthread_cond_signal(&pcontext->jobs_cond);
+    pthread_mutex_unlock(&pcontext->jobs_mutex);
+}
+
+/******************************************************************************
+Description.: Parks a request for the controls of a plugin until their
+              version moves past the one the client knows. Only the client
+              leaving is watched, pipelined requests wait in the buffer.
+Input Value.: * c is the connection
+              * req is the request
+              * plugin is the number of the plugin
+              * rest is the offset of the bytes behind the request in c->head
+Return Value: -
+******************************************************************************/
+static void conn_poll(connection *c, request *req, int plugin, int rest)
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLRDHUP;
+    ev.data.ptr = c;
+    if(epoll_ctl(c->lcfd.pc->epfd, EPOLL_CTL_MOD, c->ev.fd, &ev) < 0) {
+        conn_dispatch(c, req, plugin, rest);
+        return;
+    }
+
+    c->state = CONN_POLL;
+    c->req = *req;
+    c->plugin = plugin;
+    c->rest = rest;
+    c->since = latency_now();
+    c->timeout = CONTROL_POLL_TIMEOUT;
+}
+
+/******************************************************************************
+Description.: Dispatches a complete request header, streams and clients
+              waiting for the controls to change stay in the event loop,
+              everything else is queued for the workers
+Input Value.: * c is the connection
+              * end is the first byte behind the request header in c->head
+Return Value: -
+******************************************************************************/
+static void handle_request(connection *c, char *end)
+{
+    int input_number, rc;
+    char next;
+    request req;
+
+    metric_inc(c->lcfd.pc->requests);
+
+    /* pipelined requests behind this one wait in the buffer */
+    next = *end;
+    *end = '\0';
+    rc = parse_request(c->lcfd, c->head, &req, &input_number);
+    *end = next;
+
+    if(rc < 0) {
+        conn_close(c);
+        return;
+    }
+
+    if(req.type == A_STREAM || req.type == A_STREAM_WXP || req.type == A_WEBSOCKET) {
+        DBG("Request for stream from input: %d\n", input_number);
+        stream_start(c, &req, input_number);
+        return;
+    }
+
+    if(req.poll && controls_version(req.type, input_number) <= req.version) {
+        DBG("client waits for the controls of plugin %d to change\n", input_number);
+        conn_poll(c, &req, input_number, end - c->head);
+        return;
+    }
+
+    conn_dispatch(c, &req, input_number, end - c->head);
+}
+
+/******************************************************************************
+Description.: Answers the clients waiting for controls that changed
+Input Value.: pcontext is the server-context
+Return Value: -
+******************************************************************************/
+static void controls_event(context *pcontext)
+{
+    unsigned long long count;
+    connection *c, *next;
+
+    if(read(pcontext->control_ev.fd, &count, sizeof(count)) < 0) {
+        DBG("spurious control event\n");
+    }
+
+    for(c = pcontext->conns; c != NULL; c = next) {
+        next = c->next;
+        if(c->state == CONN_POLL && controls_version(c->req.type, c->plugin) > c->req.version)
+            conn_dispatch(c, &c->req, c->plugin, c->rest);
+    }
+}
+
+/******************************************************************************
+Description.: Reads the messages of a WebSocket client, every data message
+              acks the frame sent last and a close ends the stream
+Input Value.: c is a WebSocket connection
+Return Value: 0 if ok, -1 if the connection has to be closed
+******************************************************************************/
+static int ws_read(connection *c)
+{
+    unsigned char pong[WS_HEADER_MAX + 125];
+    ws_frame f;
+    ssize_t n;
+    int used, len, off = 0;
+
+    n = read(c->ev.fd, c->head + c->head_len, HEADER_MAX - c->head_len);
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    if(n <= 0)
+        return -1;
+    c->head_len += n;
+
+    while((used = ws_parse((unsigned char *)c->head + off, c->head_len - off, &f)) > 0) {
+        off += used;
+
+        switch(f.opcode) {
+        case WS_CLOSE:
+            /* answer the close unless a frame is half written */
+            if(c->part == NULL && write(c->ev.fd, "\x88\x00", 2) < 0) {
+                DBG("could not answer the close of the client\n");
+            }
+            return -1;
+        case WS_PING:
+            /* a pong can not go between the bytes of a frame, it is left out then */
+            if(c->part == NULL && f.len <= 125) {
+                len = ws_header(pong, WS_PONG, f.len);
+                memcpy(pong + len, f.payload, f.len);
+                if(write(c->ev.fd, pong, len + f.len) < 0) {
+                    DBG("could not answer the ping of the client\n");
+                }
+            }
+            break;
+        case WS_PONG:
+            break;
+        default:
+            if(f.fin)
+                c->ready = 1;
+        }
+    }
+    if(used < 0)
+        return -1;
+
+    memmove(c->head, c->head + off, c->head_len - off);
+    c->head_len -= off;
+
+    /* a message that does not fit the buffer is not one a viewer sends */
+    return c->head_len == HEADER_MAX ? -1 : 0;
+}
+
+/******************************************************************************
+Description.: Handles an epoll event of a client connection
+Input Value.: * c is the connection
+              * events are the epoll events
+Return Value: -
+******************************************************************************/
+static void conn_event(connection *c, unsigned int events)
+{
+    char discard[BUFFER_SIZE], *end;
+    ssize_t n;
+    int from;
+
+    if(c->state == CONN_STREAM) {
+        if(events & (EPOLLERR | EPOLLHUP)) {
+            conn_close(c);
+            return;
+        }
+
+        /* a WebSocket client acks frames, the next one may go then */
+        if((events & EPOLLIN) && c->type == A_WEBSOCKET) {
+            if(ws_read(c) < 0) {
+                conn_close(c);
+                return;
+            }
+            if(c->part == NULL) {
+                if(stream_next(c))
+                    stream_flush(c);
+                return;
             }
         }
-        } break;
-    case A_CGI:
-        DBG("cgi script: %s requested\n", req.parameter);
-        execute_cgi(lcfd.pc->id, lcfd.fd, req.parameter, req.query_string);
-        break;
-    default:
-        DBG("unknown request\n");
+
+        /* another stream client has nothing to say, only notice it leaving */
+        if((events & EPOLLIN) && c->type != A_WEBSOCKET) {
+            n = read(c->ev.fd, discard, sizeof(discard));
+            if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                conn_close(c);
+                return;
+            }
+        }
+
+        if(events & EPOLLOUT)
+            stream_flush(c);
+        return;
+    }
+
+    /* a client waiting for the controls only tells that it left */
+    if(c->state == CONN_POLL) {
+        conn_close(c);
+        return;
+    }
+
+    n = read(c->ev.fd, c->head + c->head_len, HEADER_MAX - c->head_len);
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return;
+    if(n <= 0) {
+        conn_close(c);
+        return;
     }
 
-    close(lcfd.fd);
-    free_request(&req);
+    /* an idle persistent connection starts the next request */
+    if(c->head_len == 0 && c->timeout != REQUEST_TIMEOUT) {
+        c->since = latency_now();
+        c->timeout = REQUEST_TIMEOUT;
+    }
 
-    DBG("leaving HTTP client thread\n");
-    return NULL;
+    /* the bytes read before did not hold the empty line, only look at the
+       new ones and the line end they may complete */
+    from = MAX(c->head_len - 3, 0);
+    c->head_len += n;
+    c->head[c->head_len] = '\0';
+
+    /* the end of the request-header is marked by a single, empty line */
+    if((end = header_end(c->head + from)) != NULL) {
+        handle_request(c, end);
+    } else if(c->head_len == HEADER_MAX) {
+        send_error(c->ev.fd, 400, "Request header too long");
+        conn_close(c);
+    }
+}
+
+/******************************************************************************
+Description.: Takes back the persistent connections the workers answered and
+              starts on the requests already pipelined behind
+Input Value.: pcontext is the server-context
+Return Value: -
+******************************************************************************/
+static void adopt_connections(context *pcontext)
+{
+    unsigned long long count;
+    connection *c;
+    job *j, *next;
+    char *end;
+
+    if(read(pcontext->returned_ev.fd, &count, sizeof(count)) < 0) {
+        DBG("spurious return event\n");
+    }
+
+    pthread_mutex_lock(&pcontext->jobs_mutex);
+    j = pcontext->returned;
+    pcontext->returned = NULL;
+    pthread_mutex_unlock(&pcontext->jobs_mutex);
+
+    for(; j != NULL; j = next) {
+        next = j->next;
+
+        memmove(j->head, j->head + j->rest, j->rest_len);
+        j->head[j->rest_len] = '\0';
+
+        c = conn_add(j->lcfd, j->head, j->rest_len > 0 ? REQUEST_TIMEOUT : KEEPALIVE_TIMEOUT);
+        if(c != NULL) {
+            c->head_len = j->rest_len;
+            if((end = header_end(c->head)) != NULL)
+                handle_request(c, end);
+        }
+        free(j);
+    }
+}
+
+/******************************************************************************
+Description.: Closes the connections that did not send a complete request in
+              time and the persistent ones idle for too long, clients that
+              waited long enough for the controls get the unchanged ones
+Input Value.: pcontext is the server-context
+Return Value: -
+******************************************************************************/
+static void expire_requests(context *pcontext)
+{
+    unsigned long long now = latency_now();
+    connection *c, *next;
+
+    for(c = pcontext->conns; c != NULL; c = next) {
+        next = c->next;
+        if(c->state == CONN_REQUEST && now - c->since > c->timeout * 1000ULL) {
+            DBG("client did not send a request in time\n");
+            conn_close(c);
+        } else if(c->state == CONN_POLL && now - c->since > c->timeout * 1000ULL) {
+            conn_dispatch(c, &c->req, c->plugin, c->rest);
+        }
+    }
 }
 
 /******************************************************************************
@@ -1440,30 +2790,105 @@ void server_cleanup(void *arg)
 
     for(i = 0; i < MAX_SD_LEN; i++)
         close(pcontext->sd[i]);
+
+    if(pcontext->epfd < 0)
+        return;
+
+    for(i = 0; i < pglobal->incnt; i++) {
+        pthread_cancel(pcontext->watch[i].thread);
+        close(pcontext->watch[i].ev.fd);
+    }
+
+    if(pcontext->control_ev.kind == EV_CONTROL) {
+        for(i = 0; i < pglobal->incnt; i++)
+            pthread_cancel(pcontext->controls[i].thread);
+        pcontext->control_ev.kind = EV_LISTEN;     /* no longer woken */
+        close(pcontext->control_ev.fd);
+    }
+
+    for(i = 0; i < pglobal->incnt; i++) {
+        stream_part *scaled[STREAM_SCALES];
+        int s;
+
+        pthread_mutex_lock(&pcontext->watch[i].lock);
+        memcpy(scaled, pcontext->watch[i].scaled, sizeof(scaled));
+        memset(pcontext->watch[i].scaled, 0, sizeof(scaled));
+        pthread_mutex_unlock(&pcontext->watch[i].lock);
+
+        for(s = 0; s < STREAM_SCALES; s++) {
+            if(scaled[s] != NULL)
+                part_unref(scaled[s]);
+        }
+    }
+
+    while(pcontext->conns != NULL)
+        conn_close(pcontext->conns);
+    conn_reap(pcontext);
+
+    www_cache_free(&pcontext->cache);
+
+    pthread_mutex_lock(&pcontext->jobs_mutex);
+    while(pcontext->returned != NULL) {
+        job *j = pcontext->returned;
+        pcontext->returned = j->next;
+        close(j->lcfd.fd);
+        free(j->head);
+        free(j);
+    }
+    pthread_mutex_unlock(&pcontext->jobs_mutex);
+    close(pcontext->returned_ev.fd);
+
+    for(i = 0; i < pglobal->incnt; i++) {
+        if(pcontext->parts[i] != NULL)
+            part_unref(pcontext->parts[i]);
+        pcontext->parts[i] = NULL;
+    }
+
+    close(pcontext->epfd);
+    pcontext->epfd = -1;
 }
 
 /******************************************************************************
-Description.: Open a TCP socket and wait for clients to connect. If clients
-              connect, start a new thread for each accepted connection.
+Description.: Open a TCP socket and wait for clients to connect. Connected
+              clients are served by an epoll loop in this thread, requests
+              that may block are handed to a pool of worker threads.
 Input Value.: arg is a pointer to the globals struct
 Return Value: always NULL, will only return on exit
 ******************************************************************************/
 void *server_thread(void *arg)
 {
     int on;
-    pthread_t client;
     struct addrinfo *aip, *aip2;
     struct addrinfo hints;
-    struct sockaddr_storage client_addr;
-    socklen_t addr_len = sizeof(struct sockaddr_storage);
-    fd_set selectfds;
-    int max_fds = 0;
+    struct epoll_event ev, events[MAX_EVENTS];
+    event_source *src;
+    unsigned long long count, last_expiry = 0;
+    struct rlimit limit;
     char name[NI_MAXHOST];
     int err;
-    int i;
+    int i, n;
 
     context *pcontext = arg;
     pglobal = pcontext->pglobal;
+    pcontext->epfd = -1;
+
+    /* only the wait for events may be cancelled, the connections are
+       consistent there */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    snprintf(name, sizeof(name), "output=\"%d\"", pcontext->id);
+    pcontext->connections = metric_counter("mjpg_http_connections_total", name,
+                                           "TCP connections accepted by the HTTP server.");
+    pcontext->requests = metric_counter("mjpg_http_requests_total", name,
+                                        "HTTP requests received, persistent connections serve several.");
+    pcontext->streams = metric_gauge("mjpg_http_streams", name,
+                                     "Clients currently receiving a stream.");
+    pcontext->bytes_sent = metric_counter("mjpg_http_bytes_sent_total", name,
+                                          "Bytes of snapshots and streams sent to the clients.");
+    pcontext->duplicates = metric_counter("mjpg_http_frames_deduplicated_total", name,
+                                          "Unchanged frames not sent to stream clients.");
+    pcontext->dropped = metric_counter("mjpg_http_frames_dropped_total", name,
+                                       "Frames stream clients missed because they were too slow.");
 
     /* set cleanup handler to cleanup resources */
     pthread_cleanup_push(server_cleanup, pcontext);
@@ -1521,7 +2946,7 @@ void *server_thread(void *arg)
             continue;
         }
 
-        if(listen(pcontext->sd[i], 10) < 0) {
+        if(listen(pcontext->sd[i], SOMAXCONN) < 0) {
             perror("listen");
             pcontext->sd[i] = -1;
         } else {
@@ -1542,63 +2967,148 @@ void *server_thread(void *arg)
         exit(EXIT_FAILURE);
     }
 
-    /* create a child for every client that connects */
-    while(!pglobal->stop) {
-        //int *pfd = (int *)malloc(sizeof(int));
-        cfd *pcfd = malloc(sizeof(cfd));
+    /* every client costs a descriptor instead of a thread now */
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    /* every socket of the event loop is non-blocking */
+    if((pcontext->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
 
-        if(pcfd == NULL) {
-            fprintf(stderr, "failed to allocate (a very small amount of) memory\n");
+    for(i = 0; i < pcontext->sd_len; i++) {
+        fcntl(pcontext->sd[i], F_SETFL, fcntl(pcontext->sd[i], F_GETFL) | O_NONBLOCK);
+        pcontext->listeners[i].kind = EV_LISTEN;
+        pcontext->listeners[i].fd = pcontext->sd[i];
+        ev.events = EPOLLIN;
+        ev.data.ptr = &pcontext->listeners[i];
+        if(epoll_ctl(pcontext->epfd, EPOLL_CTL_ADD, pcontext->sd[i], &ev) < 0) {
+            perror("epoll_ctl");
             exit(EXIT_FAILURE);
         }
+    }
+
+    for(i = 0; i < pglobal->incnt; i++) {
+        pcontext->watch[i].ev.kind = EV_FRAME;
+        pcontext->watch[i].input = i;
+        pthread_mutex_init(&pcontext->watch[i].lock, NULL);
+        if((pcontext->watch[i].ev.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+            perror("eventfd");
+            exit(EXIT_FAILURE);
+        }
+        ev.events = EPOLLIN;
+        ev.data.ptr = &pcontext->watch[i];
+        if(epoll_ctl(pcontext->epfd, EPOLL_CTL_ADD, pcontext->watch[i].ev.fd, &ev) < 0 ||
+           pthread_create(&pcontext->watch[i].thread, NULL, watch_thread, &pcontext->watch[i]) != 0) {
+            OPRINT("could not watch input %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(pcontext->watch[i].thread);
+    }
 
-        DBG("waiting for clients to connect\n");
+    if(pcontext->conf.www_folder != NULL) {
+        n = www_cache_load(&pcontext->cache, pcontext->conf.www_folder);
+        OPRINT("www files cached.....: %d (%zu bytes)\n", n < 0 ? 0 : n, pcontext->cache.bytes);
+    }
 
-        do {
-            FD_ZERO(&selectfds);
+    pthread_mutex_init(&pcontext->jobs_mutex, NULL);
+    pthread_cond_init(&pcontext->jobs_cond, NULL);
+    pcontext->returned_ev.kind = EV_RETURN;
+    if((pcontext->returned_ev.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = &pcontext->returned_ev;
+    if(epoll_ctl(pcontext->epfd, EPOLL_CTL_ADD, pcontext->returned_ev.fd, &ev) < 0) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
 
-            for(i = 0; i < MAX_SD_LEN; i++) {
-                if(pcontext->sd[i] != -1) {
-                    FD_SET(pcontext->sd[i], &selectfds);
+    if((pcontext->control_ev.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = &pcontext->control_ev;
+    if(epoll_ctl(pcontext->epfd, EPOLL_CTL_ADD, pcontext->control_ev.fd, &ev) < 0) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+    for(i = 0; i < pglobal->incnt; i++) {
+        pcontext->controls[i].input = i;
+        pcontext->controls[i].fd = pcontext->control_ev.fd;
+        if(pthread_create(&pcontext->controls[i].thread, NULL, control_thread, &pcontext->controls[i]) != 0) {
+            OPRINT("could not watch the controls of input %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(pcontext->controls[i].thread);
+    }
+    pcontext->control_ev.kind = EV_CONTROL;
+    for(i = 0; i < pcontext->conf.workers; i++) {
+        if(pthread_create(&pcontext->workers[i], NULL, worker_thread, pcontext) != 0) {
+            OPRINT("could not start worker thread %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(pcontext->workers[i]);
+    }
 
-                    if(pcontext->sd[i] > max_fds)
-                        max_fds = pcontext->sd[i];
-                }
-            }
+    while(!pglobal->stop) {
+        DBG("waiting for events\n");
 
-            err = select(max_fds + 1, &selectfds, NULL, NULL, NULL);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        n = epoll_wait(pcontext->epfd, events, MAX_EVENTS, 1000);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
 
-            if(err < 0 && errno != EINTR) {
-                perror("select");
-                exit(EXIT_FAILURE);
-            }
-        } while(err <= 0);
+        if(n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            exit(EXIT_FAILURE);
+        }
 
-        for(i = 0; i < max_fds + 1; i++) {
-            if(pcontext->sd[i] != -1 && FD_ISSET(pcontext->sd[i], &selectfds)) {
-                pcfd->fd = accept(pcontext->sd[i], (struct sockaddr *)&client_addr, &addr_len);
-                pcfd->pc = pcontext;
+        for(i = 0; i < n; i++) {
+            src = events[i].data.ptr;
 
-                /* start new thread that will handle this TCP connected client */
-                DBG("create thread to handle client that just established a connection\n");
+            switch(src->kind) {
+            case EV_LISTEN:
+                accept_clients(pcontext, src->fd);
+                break;
+            case EV_FRAME: {
+                connection *c, *next;
 
-                if(getnameinfo((struct sockaddr *)&client_addr, addr_len, name, sizeof(name), NULL, 0, NI_NUMERICHOST) == 0) {
-                    DBG("serving client: %s\n", name);
+                if(read(src->fd, &count, sizeof(count)) < 0) {
+                    DBG("spurious frame event\n");
                 }
 
-                #if defined(MANAGMENT)
-                pcfd->client = add_client(name);
-                #endif
-
-                if(pthread_create(&client, NULL, &client_thread, pcfd) != 0) {
-                    DBG("could not launch another client thread\n");
-                    close(pcfd->fd);
-                    free(pcfd);
-                    continue;
+                /* start a part for every stream client that waits */
+                for(c = pcontext->streaming[((frame_watch *)src)->input]; c != NULL; c = next) {
+                    next = c->stream_next;
+                    if(c->part == NULL && stream_next(c))
+                        stream_flush(c);
                 }
-                pthread_detach(client);
+                } break;
+            case EV_CLIENT:
+                /* an earlier event of the batch may have closed it */
+                if(!((connection *)src)->released)
+                    conn_event((connection *)src, events[i].events);
+                break;
+            case EV_RETURN:
+                adopt_connections(pcontext);
+                break;
+            case EV_CONTROL:
+                controls_event(pcontext);
+                break;
             }
         }
+
+        if(latency_now() - last_expiry > 1000000ULL) {
+            expire_requests(pcontext);
+            last_expiry = latency_now();
+        }
+
+        conn_reap(pcontext);
     }
 
     DBG("leaving server thread, calling cleanup function now\n");
@@ -1608,26 +3118,23 @@ void *server_thread(void *arg)
 }
 
 /******************************************************************************
-Description.: Send a JSON file which is contains information about the input plugin's
+Description.: Writes the JSON which contains information about the input plugin's
               acceptable parameters
-Input Value.: fildescriptor fd to send the answer to
+Input Value.: * f is the stream to write to
+              * input_number is the input plugin
+              * version is the version of its controls
 Return Value: -
 ******************************************************************************/
-void send_input_JSON(int fd, int input_number)
+static void input_JSON(FILE *f, int input_number, unsigned long long version)
 {
-    char buffer[BUFFER_SIZE*16] = {0}; // FIXME do reallocation if the buffer size is small
     int i;
-    sprintf(buffer, "HTTP/1.0 200 OK\r\n" \
-            "Content-type: %s\r\n" \
-            STD_HEADER \
-            "\r\n", "application/x-javascript");
-
-    DBG("Serving the input plugin %d descriptor JSON file\n", input_number);
 
+    DBG("Building the input plugin %d descriptor JSON file\n", input_number);
 
-    sprintf(buffer + strlen(buffer),
+    fprintf(f,
             "{\n"
-            "\"controls\": [\n");
+            "\"version\": %llu,\n"
+            "\"controls\": [\n", version);
     if(pglobal->in[input_number].in_parameters != NULL) {
         for(i = 0; i < pglobal->in[input_number].parametercount; i++) {
 
@@ -1673,7 +3180,7 @@ void send_input_JSON(int fd, int input_number)
                 }
             }
 
-            sprintf(buffer + strlen(buffer),
+            fprintf(f,
                     "{\n"
                     "\"name\": \"%s\",\n"
                     "\"id\": \"%d\",\n"
@@ -1701,30 +3208,30 @@ void send_input_JSON(int fd, int input_number)
 
             // append the menu object to the menu typecontrols
             if(pglobal->in[input_number].in_parameters[i].ctrl.type == V4L2_CTRL_TYPE_MENU) {
-                sprintf(buffer + strlen(buffer),
+                fprintf(f,
                         ",\n"
                         "\"menu\": {%s}\n"
                         "}",
                         menuString);
             } else {
-                sprintf(buffer + strlen(buffer),
+                fprintf(f,
                         "\n"
                         "}");
             }
 
             if(i != (pglobal->in[input_number].parametercount - 1)) {
-                sprintf(buffer + strlen(buffer), ",\n");
+                fprintf(f, ",\n");
             }
             free(menuString);
         }
     } else {
         DBG("The input plugin has no paramters\n");
     }
-    sprintf(buffer + strlen(buffer),
+    fprintf(f,
             "\n],\n"
             /*"},\n"*/);
 
-    sprintf(buffer + strlen(buffer),
+    fprintf(f,
             //"{\n"
             "\"formats\": [\n");
     if(pglobal->in[input_number].in_formats != NULL) {
@@ -1777,7 +3284,7 @@ void send_input_JSON(int fd, int input_number)
                 }
             }
 
-            sprintf(buffer + strlen(buffer),
+            fprintf(f,
                     "{\n"
                     "\"id\": \"%d\",\n"
                     "\"name\": \"%s\",\n"
@@ -1803,30 +3310,24 @@ void send_input_JSON(int fd, int input_number)
                    );
 
             if(pglobal->in[input_number].in_formats[i].currentResolution != -1) {
-                sprintf(buffer + strlen(buffer),
+                fprintf(f,
                         ",\n\"currentResolution\": \"%d\"\n",
                         pglobal->in[input_number].in_formats[i].currentResolution
                        );
             }
 
             if(i != (pglobal->in[input_number].formatCount - 1)) {
-                sprintf(buffer + strlen(buffer), "},\n");
+                fprintf(f, "},\n");
             } else {
-                sprintf(buffer + strlen(buffer), "}\n");
+                fprintf(f, "}\n");
             }
 
             free(resolutionsString);
         }
     }
-    sprintf(buffer + strlen(buffer),
+    fprintf(f,
             "\n]\n"
             "}\n");
-    i = strlen(buffer);
-
-    /* first transmit HTTP-header, afterwards transmit content of file */
-    if(write(fd, buffer, i) < 0) {
-        DBG("unable to serve the control JSON file\n");
-    }
 }
 
 
@@ -1901,6 +3402,84 @@ void send_program_JSON(int fd)
     }
 }
 
+/******************************************************************************
+Description.: Send the per stage frame latency histograms of all inputs
+Input Value.: fildescriptor fd to send the answer to
+Return Value: -
+******************************************************************************/
+void send_latency_JSON(int fd)
+{
+    char header[BUFFER_SIZE] = {0};
+    char *body;
+    int length;
+
+    if((body = malloc(BUFFER_SIZE * 64)) == NULL) {
+        send_error(fd, 500, "not enough memory");
+        return;
+    }
+
+    if((length = latency_json(body, BUFFER_SIZE * 64, pglobal->incnt)) < 0) {
+        free(body);
+        send_error(fd, 500, "latency histograms do not fit the buffer");
+        return;
+    }
+
+    sprintf(header, "HTTP/1.0 200 OK\r\n" \
+            "Content-type: %s\r\n" \
+            STD_HEADER \
+            "\r\n", "application/x-javascript");
+
+    DBG("Serving the latency JSON file\n");
+
+    if(write(fd, header, strlen(header)) < 0 || write(fd, body, length) < 0) {
+        DBG("unable to serve the latency JSON file\n");
+    }
+
+    free(body);
+}
+
+/******************************************************************************
+Description.: Send the metrics registry in the Prometheus text format
+Input Value.: fildescriptor fd to send the answer to
+Return Value: -
+******************************************************************************/
+void send_metrics(int fd)
+{
+    char header[BUFFER_SIZE] = {0};
+    char *body, *bigger;
+    size_t size = BUFFER_SIZE * 64;
+    int length;
+
+    if((body = malloc(size)) == NULL) {
+        send_error(fd, 500, "not enough memory");
+        return;
+    }
+
+    /* the registry only grows, retry with a larger buffer until it fits */
+    while((length = metrics_text(body, size)) < 0) {
+        size *= 2;
+        if((bigger = realloc(body, size)) == NULL) {
+            free(body);
+            send_error(fd, 500, "not enough memory");
+            return;
+        }
+        body = bigger;
+    }
+
+    sprintf(header, "HTTP/1.0 200 OK\r\n" \
+            "Content-type: %s\r\n" \
+            STD_HEADER \
+            "\r\n", "text/plain; version=0.0.4");
+
+    DBG("Serving the metrics\n");
+
+    if(write(fd, header, strlen(header)) < 0 || write(fd, body, length) < 0) {
+        DBG("unable to serve the metrics\n");
+    }
+
+    free(body);
+}
+
 /******************************************************************************
 Description.:   checks the source string for non printable characters and replaces them with space
                 the two arguments should be the same size allocated memory areas
@@ -1921,25 +3500,23 @@ void check_JSON_string(char *source, char *destination)
 }
 
 /******************************************************************************
-Description.: Send a JSON file which is contains information about the output plugin's
+Description.: Writes the JSON which contains information about the output plugin's
               acceptable parameters
-Input Value.: fildescriptor fd to send the answer to
+Input Value.: * f is the stream to write to
+              * input_number is the output plugin
+              * version is the version of its controls
 Return Value: -
 ******************************************************************************/
-void send_output_JSON(int fd, int input_number)
+static void output_JSON(FILE *f, int input_number, unsigned long long version)
 {
-    char buffer[BUFFER_SIZE*16] = {0}; // FIXME do reallocation if the buffer size is small
     int i;
-    sprintf(buffer, "HTTP/1.0 200 OK\r\n" \
-            "Content-type: %s\r\n" \
-            STD_HEADER \
-            "\r\n", "application/x-javascript");
 
-    DBG("Serving the output plugin %d descriptor JSON file\n", input_number);
+    DBG("Building the output plugin %d descriptor JSON file\n", input_number);
 
-    sprintf(buffer + strlen(buffer),
+    fprintf(f,
             "{\n"
-            "\"controls\": [\n");
+            "\"version\": %llu,\n"
+            "\"controls\": [\n", version);
     if(pglobal->out[input_number].out_parameters != NULL) {
         for(i = 0; i < pglobal->out[input_number].parametercount; i++) {
             char *menuString = calloc(0, 0);
@@ -1970,7 +3547,7 @@ void send_output_JSON(int fd, int input_number)
                 }
             }
 
-            sprintf(buffer + strlen(buffer),
+            fprintf(f,
                     "{\n"
                     "\"name\": \"%s\",\n"
                     "\"id\": \"%d\",\n"
@@ -1997,37 +3574,135 @@ void send_output_JSON(int fd, int input_number)
                    );
 
             if(pglobal->out[input_number].out_parameters[i].ctrl.type == V4L2_CTRL_TYPE_MENU) {
-                sprintf(buffer + strlen(buffer),
+                fprintf(f,
                         ",\n"
                         "\"menu\": {%s}\n"
                         "}",
                         menuString);
             } else {
-                sprintf(buffer + strlen(buffer),
+                fprintf(f,
                         "\n"
                         "}");
             }
 
             if(i != (pglobal->out[input_number].parametercount - 1)) {
-                sprintf(buffer + strlen(buffer), ",\n");
+                fprintf(f, ",\n");
             }
             free(menuString);
         }
     } else {
         DBG("The output plugin %d has no paramters\n", input_number);
     }
-    sprintf(buffer + strlen(buffer),
+    fprintf(f,
             "\n]\n"
             /*"},\n"*/);
 
-    sprintf(buffer + strlen(buffer),
+    fprintf(f,
             "}\n");
-    i = strlen(buffer);
+}
+
+/******************************************************************************
+Description.: Sends the JSON of the controls of a plugin. It is built once for
+              each version of the controls, every later request only copies
+              it. The ETag names the version, a matching If-None-Match is
+              answered with 304.
+Input Value.: * fd is the memory file of a worker, the cache stays locked
+                while it is written
+              * type is A_INPUT_JSON or A_OUTPUT_JSON
+              * plugin is the number of the plugin
+              * req is the request
+Return Value: -
+******************************************************************************/
+static void send_controls_JSON(int fd, answer_t type, int plugin, request *req)
+{
+    control_json *c = type == A_OUTPUT_JSON ? &output_controls[plugin] : &input_controls[plugin];
+    char header[BUFFER_SIZE], etag[48];
+    unsigned long long version;
+    char *json = NULL;
+    size_t len = 0;
+    FILE *f;
+    int n;
+
+    pthread_mutex_lock(&controls_mutex);
+
+    /* read the version first, a change while building moves it again */
+    version = controls_version(type, plugin);
+    if(c->json == NULL || c->version != version) {
+        if((f = open_memstream(&json, &len)) == NULL) {
+            pthread_mutex_unlock(&controls_mutex);
+            send_error(fd, 500, "could not allocate memory");
+            return;
+        }
+        if(type == A_OUTPUT_JSON) {
+            output_JSON(f, plugin, version);
+        } else {
+            /* waits for a command or a restart of the input to complete */
+            command_lock(&pglobal->in[plugin]);
+            input_JSON(f, plugin, version);
+            command_unlock(&pglobal->in[plugin]);
+        }
+        fclose(f);
+
+        free(c->json);
+        c->json = json;
+        c->len = len;
+        c->version = version;
+    }
+
+    snprintf(etag, sizeof(etag), "\"%s-%d-%llu\"", type == A_OUTPUT_JSON ? "out" : "in", plugin, version);
+
+    if(req->etag != NULL && strstr(req->etag, etag) != NULL) {
+        n = snprintf(header, sizeof(header), "HTTP/1.0 304 Not Modified\r\n" \
+                     "ETag: %s\r\n" \
+                     "Cache-Control: no-cache\r\n" \
+                     "\r\n", etag);
+        if(write_all(fd, header, n) < 0) {
+            DBG("unable to serve the control JSON file\n");
+        }
+        pthread_mutex_unlock(&controls_mutex);
+        return;
+    }
+
+    n = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\n" \
+                 "Content-type: %s\r\n" \
+                 "ETag: %s\r\n" \
+                 STD_HEADER \
+                 "\r\n", "application/x-javascript", etag);
 
     /* first transmit HTTP-header, afterwards transmit content of file */
-    if(write(fd, buffer, i) < 0) {
+    if(write_all(fd, header, n) < 0 || write_all(fd, c->json, c->len) < 0) {
         DBG("unable to serve the control JSON file\n");
     }
+
+    pthread_mutex_unlock(&controls_mutex);
+}
+
+/******************************************************************************
+Description.: Send a JSON file which is contains information about the input plugin's
+              acceptable parameters
+Input Value.: * fd is the filedescriptor to send the answer to
+              * input_number is the input plugin
+              * req is the request
+Return Value: -
+******************************************************************************/
+void send_input_JSON(int fd, int input_number, request *req)
+{
+    DBG("Serving the input plugin %d descriptor JSON file\n", input_number);
+    send_controls_JSON(fd, A_INPUT_JSON, input_number, req);
+}
+
+/******************************************************************************
+Description.: Send a JSON file which is contains information about the output plugin's
+              acceptable parameters
+Input Value.: * fd is the filedescriptor to send the answer to
+              * input_number is the output plugin
+              * req is the request
+Return Value: -
+******************************************************************************/
+void send_output_JSON(int fd, int input_number, request *req)
+{
+    DBG("Serving the output plugin %d descriptor JSON file\n", input_number);
+    send_controls_JSON(fd, A_OUTPUT_JSON, input_number, req);
 }
 
 #ifdef MANAGMENT
@@ -2046,19 +3721,25 @@ void send_clients_JSON(int fd)
             "{\n"
             "\"clients\": [\n");
 
-    for (; i<client_infos.client_count; i++) {
+    pthread_mutex_lock(&client_infos.mutex);
+    for (; i<client_infos.client_count && strlen(buffer) < sizeof(buffer) - 256; i++) {
         sprintf(buffer + strlen(buffer),
             "{\n"
             "\"address\": \"%s\",\n"
-            "\"timestamp\": %ld\n"
+            "\"timestamp\": %ld,\n"
+            "\"frames\": %llu,\n"
+            "\"dropped\": %llu\n"
             "}\n",
             client_infos.infos[i]->address,
-            (unsigned long)client_infos.infos[i]->last_take_time.tv_sec);
+            (unsigned long)client_infos.infos[i]->last_take_time.tv_sec,
+            client_infos.infos[i]->frames,
+            client_infos.infos[i]->dropped);
 
         if(i != (client_infos.client_count - 1)) {
             sprintf(buffer + strlen(buffer), ",\n");
         }
     }
+    pthread_mutex_unlock(&client_infos.mutex);
 
     sprintf(buffer + strlen(buffer),
             "]");
@@ -20,7 +20,10 @@
 #                                                                              #
 *******************************************************************************/
 
-#define IO_BUFFER 256
+#include "www_cache.h"
+#include "websocket.h"
+#include "request_head.h"
+
 #define BUFFER_SIZE 1024
 
 /* the boundary is used for the M-JPEG stream, it separates the multipart stream of pictures */
@@ -34,6 +37,53 @@
 #define MAX_FRAME_SIZE (256*1024)
 #define TEN_K (10*1024)
 
+/* how long a snapshot request waits for the first frame of an input, in ms */
+#define SNAPSHOT_TIMEOUT 5000
+
+/* how old the latest frame of an idle input may be to answer a snapshot, in ms */
+#define SNAPSHOT_MAX_AGE 1000
+
+/* how long a client may take to send its request, in ms */
+#define REQUEST_TIMEOUT 5000
+
+/*
+ * how long a worker waits for a client to take more of an answer, in ms, a
+ * client that stalls longer is closed so it does not hold the worker
+ */
+#define SEND_TIMEOUT 5000
+
+/* how long an idle persistent connection is kept open, in ms */
+#define KEEPALIVE_TIMEOUT 15000
+
+/* how long a client waits for the controls of a plugin to change, in ms */
+#define CONTROL_POLL_TIMEOUT 30000
+
+/* longest request header accepted */
+#define HEADER_MAX (8*1024)
+
+/* threads that answer requests other than streams */
+#define DEFAULT_WORKERS 4
+#define MAX_WORKERS 64
+
+/*
+ * unsent bytes a stream socket may hold before the event loop stops writing
+ * to it, with the part in flight a slow client is at most about two frames
+ * behind instead of a whole socket buffer
+ */
+#define STREAM_LOWAT (16*1024)
+
+/* streams may be scaled by 1/2, 1/4 and 1/8, index 0 is the original size */
+#define STREAM_SCALES 4
+
+/* quality of scaled frames */
+#define SCALE_QUALITY 75
+
+/* sequence number and capture time in front of a frame sent over a WebSocket */
+#define WS_FRAME_INFO 16
+
+/* events handled per call of epoll_wait() */
+#define MAX_EVENTS 64
+
 /*
  * Standard header to be send along with other header information like mimetype.
  *
@@ -94,6 +144,9 @@ typedef enum {
     A_INPUT_JSON,
     A_OUTPUT_JSON,
     A_PROGRAM_JSON,
+    A_LATENCY_JSON,
+    A_METRICS,
+    A_WEBSOCKET,
     #ifdef MANAGMENT
     A_CLIENTS_JSON
     #endif
@@ -101,7 +154,8 @@ typedef enum {
 
 /*
  * the client sends information with each request
- * this structure is used to store the important parts
+ * this structure is used to store the important parts,
+ * the strings point into the request header of the connection
  */
 typedef struct {
     answer_t type;
@@ -109,14 +163,21 @@ typedef struct {
     char *client;
     char *credentials;
     char *query_string;
+    int http11;             /* the request line names HTTP/1.1 */
+    int keep_alive;         /* the connection persists after the answer */
+    char *etag;             /* If-None-Match */
+    int gzip;               /* Accept-Encoding names gzip */
+    int wait;               /* a snapshot waits for the next frame */
+    int fps;                /* frame rate of a stream, 0 for every frame */
+    int scale;              /* a stream is scaled by 1/2^scale */
+    int poll;               /* wait for the controls to change */
+    unsigned long long version;     /* of the controls the client knows */
+    char *ws_key;           /* Sec-WebSocket-Key */
+    int ws_version;         /* Sec-WebSocket-Version, 0 if missing */
+    int upgrade;            /* Upgrade names websocket and Connection Upgrade */
+    int ack;                /* a WebSocket client acks every frame */
 } request;
 
-/* the iobuffer structure is used to read from the HTTP-client */
-typedef struct {
-    int level;              /* how full is the buffer */
-    char buffer[IO_BUFFER]; /* the data */
-} iobuffer;
-
 /* store configuration for each server instance */
 typedef struct {
     int port;
@@ -124,10 +185,92 @@ typedef struct {
     char *credentials;
     char *www_folder;
     char nocommands;
+    int dedup;              /* ms an unchanged frame is held back, 0 sends all */
+    int workers;
 } config;
 
-/* context of each server thread */
+/*
+ * The server thread runs an epoll loop over the listening sockets and all
+ * connections. It reads requests without blocking, and streams are written
+ * from the loop as well. Every other request is answered by a small pool of
+ * worker threads, which may block, but not longer than SEND_TIMEOUT on a
+ * client that stops reading.
+ */
+typedef enum {
+    EV_LISTEN,
+    EV_FRAME,
+    EV_CLIENT,
+    EV_RETURN,
+    EV_CONTROL
+} event_kind;
+
+/* what an epoll event belongs to, first member of everything registered */
+typedef struct {
+    event_kind kind;
+    int fd;
+} event_source;
+
+/*
+ * A part of a stream, the headers in front of a frame, the frame itself and
+ * the boundary behind it. The part of a frame is built once and shared by all
+ * clients of the input that want the same size. Scaled parts are built by
+ * the watch thread of the input, so the references are counted atomically.
+ * WebSocket clients get the same frame behind ws_head instead and no tail.
+ * A part holds a copy of the frame, a slow client never keeps a slot of the
+ * ring from the producer.
+ */
+typedef struct _stream_part stream_part;
+struct _stream_part {
+    int refs;
+    int input;
+    stream_part *frame;     /* part whose frame is sent in the format of the
+                               WebcamXP, referenced */
+    unsigned char *data;    /* the frame or the scaled frame, owned by the part */
+    const unsigned char *body;
+    int body_len;           /* 0 for a response header */
+    unsigned long long seq, hash;   /* of the original frame */
+    int frame_size;
+    frame_trace trace;
+    char head[512];
+    int head_len;
+    const char *tail;
+    int tail_len;
+    unsigned char ws_head[WS_HEADER_MAX + WS_FRAME_INFO];
+    int ws_head_len;
+};
+
+/*
+ * wakes the event loop when an input published a frame, then scales the
+ * frame to the sizes stream clients asked for and wakes it again
+ */
+typedef struct {
+    event_source ev;        /* eventfd */
+    int input;
+    pthread_t thread;
+    int scales;             /* bit n: a client wants the frames scaled by 1/2^n */
+    pthread_mutex_t lock;
+    stream_part *scaled[STREAM_SCALES];     /* latest scaled parts */
+} frame_watch;
+
+/* wakes the event loop when an input ran a command */
+typedef struct {
+    int input;
+    int fd;                 /* control_ev of the context */
+    pthread_t thread;
+} control_watch;
+
+/*
+ * The JSON of the controls of a plugin, built once for each version of
+ * them and shared by all servers
+ */
 typedef struct {
+    unsigned long long version;
+    char *json;
+    size_t len;
+} control_json;
+
+/* context of each server thread */
+typedef struct _context {
     int sd[MAX_SD_LEN];
     int sd_len;
     int id;
@@ -135,6 +278,41 @@ typedef struct {
     pthread_t threadID;
 
     config conf;
+
+    /* event loop */
+    int epfd;
+    event_source listeners[MAX_SD_LEN];
+    frame_watch watch[MAX_INPUT_PLUGINS];
+    struct _connection *conns;                      /* every open connection */
+    struct _connection *released;                   /* freed after the events */
+    struct _connection *streaming[MAX_INPUT_PLUGINS]; /* streams by input */
+    stream_part *parts[MAX_INPUT_PLUGINS];          /* part of the latest frame */
+    int scaled_clients[MAX_INPUT_PLUGINS][STREAM_SCALES];
+
+    /* files of the www folder, loaded at startup */
+    www_cache cache;
+
+    /* requests waiting for a worker */
+    pthread_t workers[MAX_WORKERS];
+    struct _job *jobs, *jobs_tail;
+    pthread_mutex_t jobs_mutex;
+    pthread_cond_t jobs_cond;
+
+    /* persistent connections the workers answered, back to the loop */
+    event_source returned_ev;                       /* eventfd */
+    struct _job *returned;
+
+    /* clients waiting for the controls of a plugin to change */
+    control_watch controls[MAX_INPUT_PLUGINS];
+    event_source control_ev;                        /* eventfd */
+
+    /* registered by server_thread() */
+    metric *connections;
+    metric *requests;
+    metric *streams;
+    metric *bytes_sent;
+    metric *duplicates;
+    metric *dropped;
 } context;
 
 
@@ -146,6 +324,8 @@ typedef struct _client_info {
     struct _client_info *next;
     char *address;
     struct timeval last_take_time;
+    unsigned long long frames;      /* stream frames sent to this address */
+    unsigned long long dropped;     /* frames it was too slow for */
 } client_info;
 
 struct {
@@ -168,20 +348,87 @@ typedef struct {
     #endif
 } cfd;
 
+typedef enum {
+    CONN_REQUEST,           /* reading the request header */
+    CONN_STREAM,            /* sending frames */
+    CONN_POLL               /* waiting for the controls to change */
+} conn_state;
+
+/* a client connection owned by the event loop */
+typedef struct _connection connection;
+struct _connection {
+    event_source ev;
+    cfd lcfd;
+    conn_state state;
+    unsigned long long since;   /* latency_now() when accepted or idle */
+    int timeout;                /* ms allowed until the request is complete */
+    int want_write;             /* EPOLLOUT is armed */
+    int released;               /* left the event loop, later events of the
+                                   same epoll_wait() are ignored */
+
+    /* CONN_REQUEST */
+    char *head;
+    int head_len;
+
+    /* CONN_STREAM */
+    answer_t type;
+    int input;
+    frame_interest interest;
+    int fps;                    /* frames per second, 0 for every frame */
+    int scale;                  /* frames are scaled by 1/2^scale */
+    unsigned long long next_due;    /* latency_now() when a frame is due */
+    stream_part *part;          /* being sent, NULL while up to date */
+    size_t sent;                /* bytes of the part written so far */
+    unsigned long long last_seq, last_hash, last_sent;
+    int last_size;
+    unsigned long long frames;  /* parts of frames sent */
+    unsigned long long dropped; /* frames skipped while the client was busy */
+
+    /* A_WEBSOCKET, the messages of the client are read into head */
+    int ack;                    /* a frame is only sent after an ack */
+    int ready;                  /* the client acked the last frame */
+
+    /* CONN_POLL */
+    request req;                /* answered once the controls changed */
+    int plugin;
+    int rest;                   /* offset of the pipelined bytes in head */
+
+    connection *prev, *next;                /* all connections */
+    connection *stream_prev, *stream_next;  /* streams of the same input */
+};
+
+/*
+ * a request handed to a worker, the worker closes the connection or hands a
+ * persistent one back together with the pipelined requests behind it
+ */
+typedef struct _job job;
+struct _job {
+    cfd lcfd;
+    request req;
+    int input;
+    int keep_alive;
+    char *head;             /* buffer of the connection */
+    int rest, rest_len;     /* bytes received after the request header */
+    job *next;
+};
+
 
 
 /* prototypes */
 void *server_thread(void *arg);
 void send_error(int fd, int which, char *message);
-void send_output_JSON(int fd, int plugin_number);
-void send_input_JSON(int fd, int plugin_number);
+void send_output_JSON(int fd, int plugin_number, request *req);
+void send_input_JSON(int fd, int plugin_number, request *req);
 void send_program_JSON(int fd);
+void send_latency_JSON(int fd);
+void send_metrics(int fd);
 void check_JSON_string(char *source, char *destination);
 
 #ifdef MANAGMENT
 client_info *add_client(char *address);
 int check_client_status(client_info *client);
 void update_client_timestamp(client_info *client);
+void update_client_frames(client_info *client, unsigned long long dropped);
 void send_clients_JSON(int fd);
 #endif
 
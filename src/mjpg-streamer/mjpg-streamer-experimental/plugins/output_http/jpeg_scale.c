@@ -0,0 +1,151 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#ifndef NO_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+#include "../../mjpg_streamer.h"
+#include "jpeg_scale.h"
+
+#ifndef NO_LIBJPEG
+/* error manager that returns to jpeg_scale() instead of exiting */
+struct scale_error {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void scale_error_exit(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, message);
+    DBG("could not scale frame: %s\n", message);
+    longjmp(((struct scale_error *)cinfo->err)->jump, 1);
+}
+
+static void scale_output_message(j_common_ptr cinfo)
+{
+    (void)cinfo;
+}
+#endif
+
+/******************************************************************************
+Description.: shrinks a JPEG frame by 2, 4 or 8. The decoder scales in the DCT
+              domain, so it only decodes what the smaller picture needs, and
+              the scanlines go to the encoder without color conversion.
+Input Value.: * src, size is the JPEG frame
+              * denom is the scale, 2, 4 or 8
+              * quality of the encoder
+              * dst receives the scaled frame, free it with free()
+              * dst_size receives its size
+Return Value: 0 if ok, -1 if the frame could not be scaled
+******************************************************************************/
+int jpeg_scale(const unsigned char *src, int size, int denom, int quality,
+               unsigned char **dst, unsigned long *dst_size)
+{
+#ifdef NO_LIBJPEG
+    (void)src;
+    (void)size;
+    (void)denom;
+    (void)quality;
+    (void)dst;
+    (void)dst_size;
+    return -1;
+#else
+    struct jpeg_decompress_struct din;
+    struct jpeg_compress_struct cout;
+    struct scale_error err;
+    unsigned char *volatile line = NULL;
+    unsigned char *volatile buf = NULL;
+    unsigned char *out;
+    unsigned long out_size;
+    JSAMPROW row;
+
+    memset(&din, 0, sizeof(din));
+    memset(&cout, 0, sizeof(cout));
+    din.err = cout.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = scale_error_exit;
+    err.pub.output_message = scale_output_message;
+
+    if(setjmp(err.jump)) {
+        jpeg_destroy_compress(&cout);
+        jpeg_destroy_decompress(&din);
+        free(line);
+        free(buf);
+        return -1;
+    }
+
+    jpeg_create_decompress(&din);
+    jpeg_mem_src(&din, (unsigned char *)src, size);
+    jpeg_read_header(&din, TRUE);
+
+    din.scale_num = 1;
+    din.scale_denom = denom;
+    din.dct_method = JDCT_IFAST;
+    if(din.jpeg_color_space == JCS_YCbCr)
+        din.out_color_space = JCS_YCbCr;
+    jpeg_start_decompress(&din);
+
+    /* a scaled frame is smaller than the original, the buffer rarely grows */
+    if((buf = malloc(size)) == NULL || (line = malloc(din.output_width * din.output_components)) == NULL)
+        longjmp(err.jump, 1);
+    out = buf;
+    out_size = size;
+
+    jpeg_create_compress(&cout);
+    jpeg_mem_dest(&cout, &out, &out_size);
+    cout.image_width = din.output_width;
+    cout.image_height = din.output_height;
+    cout.input_components = din.output_components;
+    cout.in_color_space = din.out_color_space;
+    jpeg_set_defaults(&cout);
+    cout.dct_method = JDCT_IFAST;
+    jpeg_set_quality(&cout, quality, TRUE);
+    jpeg_start_compress(&cout, TRUE);
+
+    row = line;
+    while(din.output_scanline < din.output_height) {
+        jpeg_read_scanlines(&din, &row, 1);
+        jpeg_write_scanlines(&cout, &row, 1);
+    }
+
+    jpeg_finish_compress(&cout);
+    jpeg_finish_decompress(&din);
+    jpeg_destroy_compress(&cout);
+    jpeg_destroy_decompress(&din);
+    free(line);
+
+    /* the encoder moved to a buffer of its own */
+    if(out != buf)
+        free(buf);
+
+    *dst = out;
+    *dst_size = out_size;
+
+    return 0;
+#endif
+}
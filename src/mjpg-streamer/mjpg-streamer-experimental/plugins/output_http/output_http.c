@@ -64,7 +64,11 @@ void help(void)
 	    " [-l ] --listen ]........: Listen on Hostname / IP\n" \
             " [-c | --credentials ]...: ask for \"username:password\" on connect\n" \
             " [-n | --nocommands ]....: disable execution of commands\n"
-            " ---------------------------------------------------------------\n");
+            " [--dedup ms ]...........: hold back unchanged frames from stream\n" \
+            "                           clients for up to ms milliseconds\n" \
+            " [--workers n ]..........: threads answering requests other than\n" \
+            "                           streams, default %d\n"
+            " ---------------------------------------------------------------\n", DEFAULT_WORKERS);
 }
 
 /*** plugin interface functions ***/
@@ -83,6 +87,8 @@ int output_init(output_parameter *param, int id)
     int  port;
     char *credentials, *www_folder, *hostname = NULL;
     char nocommands;
+    int dedup = 0;
+    int workers = DEFAULT_WORKERS;
 
     DBG("output #%02d\n", param->id);
 
@@ -115,6 +121,8 @@ int output_init(output_parameter *param, int id)
             {"www", required_argument, 0, 0},
             {"n", no_argument, 0, 0},
             {"nocommands", no_argument, 0, 0},
+            {"dedup", required_argument, 0, 0},
+            {"workers", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -175,6 +183,22 @@ int output_init(output_parameter *param, int id)
             DBG("case 10,11\n");
             nocommands = 1;
             break;
+
+            /* dedup */
+        case 12:
+            DBG("case 12\n");
+            dedup = atoi(optarg);
+            break;
+
+            /* workers */
+        case 13:
+            DBG("case 13\n");
+            workers = atoi(optarg);
+            if(workers < 1 || workers > MAX_WORKERS) {
+                OPRINT("the number of workers must be between 1 and %d\n", MAX_WORKERS);
+                return 1;
+            }
+            break;
         }
     }
 
@@ -185,12 +209,17 @@ int output_init(output_parameter *param, int id)
     servers[param->id].conf.credentials = credentials;
     servers[param->id].conf.www_folder = www_folder;
     servers[param->id].conf.nocommands = nocommands;
+    servers[param->id].conf.dedup = dedup;
+    servers[param->id].conf.workers = workers;
 
     OPRINT("www-folder-path......: %s\n", (www_folder == NULL) ? "disabled" : www_folder);
     OPRINT("HTTP TCP port........: %d\n", ntohs(port));
     OPRINT("HTTP Listen Address..: %s\n", hostname);
     OPRINT("username:password....: %s\n", (credentials == NULL) ? "disabled" : credentials);
     OPRINT("commands.............: %s\n", (nocommands) ? "disabled" : "enabled");
+    if(dedup > 0)
+        OPRINT("unchanged frames.....: held back for up to %d ms\n", dedup);
+    OPRINT("worker threads.......: %d\n", workers);
 
     param->global->out[id].name = malloc((strlen(OUTPUT_PLUGIN_NAME) + 1) * sizeof(char));
     sprintf(param->global->out[id].name, OUTPUT_PLUGIN_NAME);
@@ -199,9 +228,9 @@ int output_init(output_parameter *param, int id)
 }
 
 /******************************************************************************
-Description.: this will stop the server thread, client threads
-              will not get cleaned properly, because they run detached and
-              no pointer is kept. This is not a huge issue, because this
+Description.: this will stop the server thread, which closes all connections
+              of its event loop. Worker threads will not get cleaned properly,
+              because they run detached. This is not a huge issue, because this
               funtion is intended to clean up the biggest mess on shutdown.
 Input Value.: id determines which server instance to send commands to
 Return Value: always 0
@@ -0,0 +1,106 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include "request_head.h"
+
+/******************************************************************************
+Description.: Ends a line of a request header in place
+Input Value.: p points to the line end, it is advanced past it
+Return Value: 0 if ok, -1 if the line does not end with CRLF or LF
+******************************************************************************/
+static int line_end(char **p)
+{
+    if(**p == '\r')
+        *(*p)++ = '\0';
+    if(**p != '\n')
+        return -1;
+    *(*p)++ = '\0';
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: Splits a complete request header in a single pass. Separators
+              and line ends are replaced with null-characters in place, so
+              the parts are strings pointing into the buffer of the
+              connection and nothing is copied or allocated.
+Input Value.: * head is the header, a null-character follows the empty line
+              * h receives the parts
+Return Value: 0 if ok, -1 if the header is malformed, -2 if it has more than
+              MAX_HEADERS fields
+******************************************************************************/
+int split_head(char *head, request_head *h)
+{
+    char *p = head, *name, *value, *end;
+
+    h->count = 0;
+
+    /* request-line: method SP request-target [SP HTTP-version] */
+    h->method = p;
+    while(*p != ' ' && *p != '\r' && *p != '\n' && *p != '\0')
+        p++;
+    if(*p != ' ')
+        return -1;
+    *p++ = '\0';
+
+    h->target = p;
+    while(*p != ' ' && *p != '\r' && *p != '\n' && *p != '\0')
+        p++;
+    h->version = "";
+    if(*p == ' ') {
+        *p++ = '\0';
+        h->version = p;
+        while(*p != '\r' && *p != '\n' && *p != '\0')
+            p++;
+    }
+    if(line_end(&p) < 0)
+        return -1;
+
+    /* header fields up to the empty line */
+    while(*p != '\r' && *p != '\n') {
+        name = p;
+        while(*p != ':' && *p != '\r' && *p != '\n' && *p != '\0')
+            p++;
+        if(*p != ':')
+            return -1;
+        *p++ = '\0';
+
+        while(*p == ' ' || *p == '\t')
+            p++;
+        value = p;
+        while(*p != '\r' && *p != '\n' && *p != '\0')
+            p++;
+        end = p;
+        if(line_end(&p) < 0)
+            return -1;
+        while(end > value && (end[-1] == ' ' || end[-1] == '\t'))
+            *--end = '\0';
+
+        if(h->count == MAX_HEADERS)
+            return -2;
+        h->fields[h->count].name = name;
+        h->fields[h->count].value = value;
+        h->count++;
+    }
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef REQUEST_HEAD_H
+#define REQUEST_HEAD_H
+
+/* most header fields a request may have */
+#define MAX_HEADERS 32
+
+/* a header field, split in place in the request header */
+typedef struct {
+    const char *name;
+    char *value;
+} header_field;
+
+/* the parts of a request header, split in place */
+typedef struct {
+    const char *method;
+    char *target;           /* path and query */
+    const char *version;
+    header_field fields[MAX_HEADERS];
+    int count;
+} request_head;
+
+int split_head(char *head, request_head *h);
+
+#endif
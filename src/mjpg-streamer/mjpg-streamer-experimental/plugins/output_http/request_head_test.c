@@ -0,0 +1,102 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "request_head.h"
+
+static int failed = 0;
+
+#define CHECK(cond) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failed++; \
+        } \
+    } while(0)
+
+/******************************************************************************
+Description.: splits a copy of a request header
+Input Value.: * text is the header
+              * h receives the parts, they point into buf
+              * buf, size receive the copy
+Return Value: what split_head() returned
+******************************************************************************/
+static int split(const char *text, request_head *h, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s", text);
+    return split_head(buf, h);
+}
+
+int main(void)
+{
+    request_head h;
+    char buf[4096], name[16], *p;
+    int i;
+
+    CHECK(split("GET /?action=stream HTTP/1.1\r\n"
+                "Host: cam\r\n"
+                "Authorization:  Basic dXNlcjpwdw== \t\r\n"
+                "X-Empty:\r\n"
+                "\r\n", &h, buf, sizeof(buf)) == 0);
+    CHECK(strcmp(h.method, "GET") == 0);
+    CHECK(strcmp(h.target, "/?action=stream") == 0);
+    CHECK(strcmp(h.version, "HTTP/1.1") == 0);
+    CHECK(h.count == 3);
+    CHECK(strcmp(h.fields[0].name, "Host") == 0 && strcmp(h.fields[0].value, "cam") == 0);
+    CHECK(strcmp(h.fields[1].name, "Authorization") == 0);
+    CHECK(strcmp(h.fields[1].value, "Basic dXNlcjpwdw==") == 0);
+    CHECK(strcmp(h.fields[2].name, "X-Empty") == 0 && h.fields[2].value[0] == '\0');
+
+    /* bare LF line ends and a request without version */
+    CHECK(split("GET /snapshot\nHost: cam\n\n", &h, buf, sizeof(buf)) == 0);
+    CHECK(strcmp(h.target, "/snapshot") == 0 && h.version[0] == '\0');
+    CHECK(h.count == 1 && strcmp(h.fields[0].value, "cam") == 0);
+
+    /* a colon in the value belongs to the value */
+    CHECK(split("GET / HTTP/1.0\r\nHost: cam:8080\r\n\r\n", &h, buf, sizeof(buf)) == 0);
+    CHECK(strcmp(h.fields[0].value, "cam:8080") == 0);
+
+    /* malformed */
+    CHECK(split("GET\r\n\r\n", &h, buf, sizeof(buf)) == -1);
+    CHECK(split("GET / HTTP/1.1\r\nHost cam\r\n\r\n", &h, buf, sizeof(buf)) == -1);
+    CHECK(split("GET / HTTP/1.1\rHost: cam\r\n\r\n", &h, buf, sizeof(buf)) == -1);
+
+    /* MAX_HEADERS fields are fine, one more is not */
+    p = buf + sprintf(buf, "GET / HTTP/1.1\r\n");
+    for(i = 0; i < MAX_HEADERS; i++)
+        p += sprintf(p, "X-%d: %d\r\n", i, i);
+    strcpy(p, "\r\n");
+    CHECK(split_head(buf, &h) == 0);
+    CHECK(h.count == MAX_HEADERS);
+    snprintf(name, sizeof(name), "X-%d", MAX_HEADERS - 1);
+    CHECK(strcmp(h.fields[MAX_HEADERS - 1].name, name) == 0);
+
+    p = buf + sprintf(buf, "GET / HTTP/1.1\r\n");
+    for(i = 0; i <= MAX_HEADERS; i++)
+        p += sprintf(p, "X-%d: %d\r\n", i, i);
+    strcpy(p, "\r\n");
+    CHECK(split_head(buf, &h) == -2);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "websocket.h"
+
+/* appended to the key of the client before hashing it, RFC 6455 */
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/******************************************************************************
+Description.: hashes one block of 64 bytes into the SHA-1 state
+Input Value.: * h is the state
+              * block is the data
+Return Value: -
+******************************************************************************/
+static void sha1_block(uint32_t h[5], const unsigned char *block)
+{
+    uint32_t w[80], a, b, c, d, e, f, k, t;
+    int i;
+
+    for(i = 0; i < 16; i++)
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    for(i = 16; i < 80; i++)
+        w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+    for(i = 0; i < 80; i++) {
+        if(i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if(i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if(i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        t = ROL(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = ROL(b, 30); b = a; a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+/******************************************************************************
+Description.: computes the SHA-1 digest of a short message, the handshake is
+              the only user and hashes less than 128 bytes
+Input Value.: * data, len is the message, at most 119 bytes
+              * digest receives 20 bytes
+Return Value: -
+******************************************************************************/
+static void sha1(const unsigned char *data, size_t len, unsigned char digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    unsigned char block[128] = {0};
+    size_t blocks = len + 9 > 64 ? 2 : 1;
+    unsigned long long bits = (unsigned long long)len * 8;
+    int i;
+
+    memcpy(block, data, len);
+    block[len] = 0x80;
+    for(i = 0; i < 8; i++)
+        block[blocks * 64 - 1 - i] = bits >> (i * 8);
+
+    for(i = 0; i < (int)blocks; i++)
+        sha1_block(h, block + i * 64);
+
+    for(i = 0; i < 20; i++)
+        digest[i] = h[i / 4] >> (24 - (i % 4) * 8);
+}
+
+/******************************************************************************
+Description.: answers the key of a WebSocket handshake
+Input Value.: * key is the value of Sec-WebSocket-Key
+              * accept receives the value of Sec-WebSocket-Accept, it holds
+                WS_ACCEPT_LEN bytes
+Return Value: -
+******************************************************************************/
+void ws_accept(const char *key, char *accept)
+{
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned char message[128], digest[20];
+    size_t len;
+    int i, n = 0;
+
+    len = snprintf((char *)message, sizeof(message) - 9, "%.60s%s", key, WS_GUID);
+    sha1(message, len, digest);
+
+    /* 20 bytes are 27 characters and one = */
+    for(i = 0; i < 20; i += 3) {
+        uint32_t v = digest[i] << 16 | digest[i + 1] << 8 | (i + 2 < 20 ? digest[i + 2] : 0);
+
+        accept[n++] = base64[v >> 18 & 63];
+        accept[n++] = base64[v >> 12 & 63];
+        accept[n++] = base64[v >> 6 & 63];
+        accept[n++] = i + 2 < 20 ? base64[v & 63] : '=';
+    }
+    accept[n] = '\0';
+}
+
+/******************************************************************************
+Description.: writes the header of an unmasked frame the server sends
+Input Value.: * buf receives up to WS_HEADER_MAX bytes
+              * opcode is the type of the frame
+              * len is the length of the payload
+Return Value: length of the header
+******************************************************************************/
+int ws_header(unsigned char *buf, int opcode, unsigned long long len)
+{
+    int i;
+
+    buf[0] = 0x80 | opcode;
+    if(len < 126) {
+        buf[1] = len;
+        return 2;
+    }
+    if(len < 65536) {
+        buf[1] = 126;
+        buf[2] = len >> 8;
+        buf[3] = len;
+        return 4;
+    }
+    buf[1] = 127;
+    for(i = 0; i < 8; i++)
+        buf[2 + i] = len >> (56 - i * 8);
+    return 10;
+}
+
+/******************************************************************************
+Description.: takes the next frame a client sent out of the received bytes,
+              frames of clients are always masked
+Input Value.: * buf, len are the received bytes, the payload is unmasked in
+                place
+              * frame receives the frame
+Return Value: bytes the frame took, 0 if it is not complete yet, -1 if the
+              client broke the protocol
+******************************************************************************/
+int ws_parse(unsigned char *buf, size_t len, ws_frame *frame)
+{
+    unsigned long long payload;
+    size_t head = 2, i;
+    unsigned char *mask;
+
+    if(len < 2)
+        return 0;
+    if(!(buf[1] & 0x80) || (buf[0] & 0x70))
+        return -1;
+
+    payload = buf[1] & 0x7F;
+    if(payload == 126) {
+        if(len < 4)
+            return 0;
+        payload = buf[2] << 8 | buf[3];
+        head = 4;
+    } else if(payload == 127) {
+        if(len < 10)
+            return 0;
+        for(payload = 0, i = 0; i < 8; i++)
+            payload = payload << 8 | buf[2 + i];
+        head = 10;
+    }
+
+    if(len < head + 4 || len - head - 4 < payload)
+        return 0;
+
+    mask = buf + head;
+    frame->fin = buf[0] >> 7;
+    frame->opcode = buf[0] & 0x0F;
+    frame->payload = buf + head + 4;
+    frame->len = payload;
+    for(i = 0; i < payload; i++)
+        frame->payload[i] ^= mask[i % 4];
+
+    return head + 4 + payload;
+}
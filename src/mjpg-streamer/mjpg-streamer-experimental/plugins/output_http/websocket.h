@@ -0,0 +1,54 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <stddef.h>
+
+/* opcodes of WebSocket frames, RFC 6455 */
+#define WS_CONTINUATION 0x0
+#define WS_TEXT         0x1
+#define WS_BINARY       0x2
+#define WS_CLOSE        0x8
+#define WS_PING         0x9
+#define WS_PONG         0xA
+
+/* longest frame header the server sends */
+#define WS_HEADER_MAX 10
+
+/* length of the value of Sec-WebSocket-Accept with its zero */
+#define WS_ACCEPT_LEN 29
+
+/* a frame received from a client, its payload is unmasked in place */
+typedef struct {
+    int fin;
+    int opcode;
+    unsigned char *payload;
+    size_t len;
+} ws_frame;
+
+void ws_accept(const char *key, char *accept);
+int ws_header(unsigned char *buf, int opcode, unsigned long long len);
+int ws_parse(unsigned char *buf, size_t len, ws_frame *frame);
+
+#endif
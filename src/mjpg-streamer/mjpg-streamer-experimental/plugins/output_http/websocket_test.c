@@ -0,0 +1,168 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "websocket.h"
+
+static int failed = 0;
+
+#define CHECK(cond) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failed++; \
+        } \
+    } while(0)
+
+/******************************************************************************
+Description.: checks the Sec-WebSocket-Accept value, which also covers SHA-1
+              across the block boundaries of the key length
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void check_accept(void)
+{
+    char accept[WS_ACCEPT_LEN];
+    char key[80];
+
+    /* example of RFC 6455 */
+    ws_accept("dGhlIHNhbXBsZSBub25jZQ==", accept);
+    CHECK(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);
+
+    ws_accept("", accept);
+    CHECK(strcmp(accept, "Kfh9QIsMVZcl6xEPYxPHzW8SZ8w=") == 0);
+
+    /* the key and the GUID fill 56 bytes, the length spills into a
+       second block */
+    memset(key, 'x', 20);
+    key[20] = '\0';
+    ws_accept(key, accept);
+    CHECK(strcmp(accept, "7jD6MP55bPPoLSNhT1mD/AE8sjc=") == 0);
+
+    /* 64 bytes, exactly one block before the padding */
+    memset(key, 'x', 28);
+    key[28] = '\0';
+    ws_accept(key, accept);
+    CHECK(strcmp(accept, "atUL8kQGe4qplhq19Y5TKRw/Uj4=") == 0);
+
+    /* keys are cut after 60 characters */
+    memset(key, 'A', 60);
+    key[60] = '\0';
+    ws_accept(key, accept);
+    CHECK(strcmp(accept, "MVBzqFGokPadjEQw2Wrkd4hl8rA=") == 0);
+    strcpy(key + 60, "ignored");
+    ws_accept(key, accept);
+    CHECK(strcmp(accept, "MVBzqFGokPadjEQw2Wrkd4hl8rA=") == 0);
+}
+
+/******************************************************************************
+Description.: checks the three lengths of frame headers the server sends
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void check_header(void)
+{
+    unsigned char buf[WS_HEADER_MAX];
+
+    CHECK(ws_header(buf, WS_BINARY, 125) == 2);
+    CHECK(buf[0] == 0x82 && buf[1] == 125);
+
+    CHECK(ws_header(buf, WS_TEXT, 126) == 4);
+    CHECK(buf[0] == 0x81 && buf[1] == 126 && buf[2] == 0x00 && buf[3] == 126);
+
+    CHECK(ws_header(buf, WS_BINARY, 65535) == 4);
+    CHECK(buf[2] == 0xFF && buf[3] == 0xFF);
+
+    CHECK(ws_header(buf, WS_BINARY, 65536) == 10);
+    CHECK(buf[1] == 127);
+    CHECK(memcmp(buf + 2, "\x00\x00\x00\x00\x00\x01\x00\x00", 8) == 0);
+}
+
+/******************************************************************************
+Description.: checks parsing and unmasking of frames sent by clients
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void check_parse(void)
+{
+    /* masked "Hello" of RFC 6455 */
+    static const unsigned char hello[] = {
+        0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58
+    };
+    unsigned char buf[4 + 4 + 200 + 2];
+    ws_frame frame;
+    size_t i;
+
+    /* every prefix is incomplete */
+    for(i = 0; i < sizeof(hello); i++) {
+        memcpy(buf, hello, sizeof(hello));
+        CHECK(ws_parse(buf, i, &frame) == 0);
+    }
+
+    /* bytes of the next frame stay where they are */
+    memcpy(buf, hello, sizeof(hello));
+    buf[sizeof(hello)] = 0x89;
+    CHECK(ws_parse(buf, sizeof(hello) + 1, &frame) == (int)sizeof(hello));
+    CHECK(frame.fin == 1 && frame.opcode == WS_TEXT);
+    CHECK(frame.len == 5 && memcmp(frame.payload, "Hello", 5) == 0);
+    CHECK(frame.payload == buf + 6);
+
+    /* clients have to mask their frames */
+    memcpy(buf, "\x81\x05Hello", 7);
+    CHECK(ws_parse(buf, 7, &frame) == -1);
+
+    /* no extension was negotiated, RSV bits are not allowed */
+    memcpy(buf, hello, sizeof(hello));
+    buf[0] |= 0x40;
+    CHECK(ws_parse(buf, sizeof(hello), &frame) == -1);
+
+    /* 16 bit length, not final */
+    buf[0] = WS_BINARY;
+    buf[1] = 0x80 | 126;
+    buf[2] = 0;
+    buf[3] = 200;
+    memcpy(buf + 4, "\x01\x02\x03\x04", 4);
+    for(i = 0; i < 200; i++)
+        buf[8 + i] = (unsigned char)i ^ buf[4 + i % 4];
+    CHECK(ws_parse(buf, 3, &frame) == 0);
+    CHECK(ws_parse(buf, 207, &frame) == 0);
+    CHECK(ws_parse(buf, 208, &frame) == 208);
+    CHECK(frame.fin == 0 && frame.opcode == WS_BINARY && frame.len == 200);
+    for(i = 0; i < 200; i++)
+        CHECK(frame.payload[i] == (unsigned char)i);
+
+    /* a 64 bit length is only complete once the payload arrived */
+    memcpy(buf, "\x82\xff\x00\x00\x00\x00\x00\x01\x00\x00", 10);
+    CHECK(ws_parse(buf, 9, &frame) == 0);
+    CHECK(ws_parse(buf, sizeof(buf), &frame) == 0);
+}
+
+int main(void)
+{
+    check_accept();
+    check_header();
+    check_parse();
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
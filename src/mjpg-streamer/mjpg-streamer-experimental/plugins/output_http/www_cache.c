@@ -0,0 +1,199 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "../../mjpg_streamer.h"
+#include "www_cache.h"
+
+#ifdef USE_ZLIB
+/******************************************************************************
+Description.: compresses a file for clients accepting gzip
+Input Value.: f is the file, its data is loaded
+Return Value: -
+******************************************************************************/
+static void compress_file(www_file *f)
+{
+    z_stream zs;
+    uLong bound;
+
+    memset(&zs, 0, sizeof(zs));
+    if(deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+
+    bound = deflateBound(&zs, f->size);
+    if((f->gzip = malloc(bound)) == NULL) {
+        deflateEnd(&zs);
+        return;
+    }
+
+    zs.next_in = f->data;
+    zs.avail_in = f->size;
+    zs.next_out = f->gzip;
+    zs.avail_out = bound;
+
+    /* images and archives hardly shrink, they are sent as they are */
+    if(deflate(&zs, Z_FINISH) != Z_STREAM_END || zs.total_out > (uLong)f->size * 9 / 10) {
+        free(f->gzip);
+        f->gzip = NULL;
+    } else {
+        f->gzip_size = zs.total_out;
+    }
+
+    deflateEnd(&zs);
+}
+#endif
+
+/******************************************************************************
+Description.: reads a file of the www folder into the cache
+Input Value.: * cache is the cache
+              * folder is the www folder, ending with a slash
+              * name is the file name
+Return Value: 0 if it was loaded, -1 otherwise
+******************************************************************************/
+static int load_file(www_cache *cache, const char *folder, const char *name)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    www_file *f;
+    ssize_t n;
+    off_t done = 0;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s%s", folder, name);
+    if((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+
+    if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size > WWW_FILE_MAX ||
+       cache->bytes + st.st_size > WWW_CACHE_MAX ||
+       (f = calloc(1, sizeof(www_file))) == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    f->size = st.st_size;
+    f->mtime = st.st_mtime;
+    if((f->name = strdup(name)) == NULL || (f->data = malloc(f->size + 1)) == NULL) {
+        free(f->name);
+        free(f);
+        close(fd);
+        return -1;
+    }
+
+    while(done < f->size && (n = read(fd, f->data + done, f->size - done)) > 0)
+        done += n;
+    close(fd);
+
+    if(done != f->size) {
+        free(f->data);
+        free(f->name);
+        free(f);
+        return -1;
+    }
+
+    #ifdef USE_ZLIB
+    compress_file(f);
+    #endif
+
+    cache->bytes += f->size + f->gzip_size;
+    f->next = cache->files;
+    cache->files = f;
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: loads the files of the www folder, which has no subfolders
+Input Value.: * cache is the cache to fill
+              * folder is the www folder, ending with a slash
+Return Value: number of files loaded, -1 if the folder can not be read
+******************************************************************************/
+int www_cache_load(www_cache *cache, const char *folder)
+{
+    struct dirent *entry;
+    DIR *dir;
+    int count = 0;
+
+    memset(cache, 0, sizeof(*cache));
+
+    if((dir = opendir(folder)) == NULL)
+        return -1;
+
+    while((entry = readdir(dir)) != NULL) {
+        if(entry->d_name[0] == '.')
+            continue;
+        if(load_file(cache, folder, entry->d_name) == 0)
+            count++;
+    }
+
+    closedir(dir);
+
+    return count;
+}
+
+/******************************************************************************
+Description.: looks up a file
+Input Value.: * cache is the cache
+              * name is the file name
+Return Value: the file, NULL if it is not cached
+******************************************************************************/
+www_file *www_cache_find(www_cache *cache, const char *name)
+{
+    www_file *f;
+
+    for(f = cache->files; f != NULL; f = f->next) {
+        if(strcmp(f->name, name) == 0)
+            return f;
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: releases all files of the cache
+Input Value.: cache is the cache
+Return Value: -
+******************************************************************************/
+void www_cache_free(www_cache *cache)
+{
+    www_file *f;
+
+    while((f = cache->files) != NULL) {
+        cache->files = f->next;
+        free(f->name);
+        free(f->data);
+        free(f->gzip);
+        free(f);
+    }
+
+    cache->bytes = 0;
+}
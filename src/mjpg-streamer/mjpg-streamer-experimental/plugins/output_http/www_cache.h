@@ -0,0 +1,59 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef WWW_CACHE_H
+#define WWW_CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+
+/* files larger than this are always sent from the disk */
+#define WWW_FILE_MAX (1024*1024)
+
+/* memory the cache of a server may use */
+#define WWW_CACHE_MAX (16*1024*1024)
+
+/*
+ * A file of the www folder loaded at startup. Size and modification time
+ * tell whether the file on the disk still is the same.
+ */
+typedef struct _www_file www_file;
+struct _www_file {
+    char *name;
+    off_t size;
+    time_t mtime;
+    unsigned char *data;
+    unsigned char *gzip;    /* compressed data, NULL if it does not pay off */
+    size_t gzip_size;
+    www_file *next;
+};
+
+typedef struct {
+    www_file *files;
+    size_t bytes;
+} www_cache;
+
+int www_cache_load(www_cache *cache, const char *folder);
+www_file *www_cache_find(www_cache *cache, const char *name);
+void www_cache_free(www_cache *cache);
+
+#endif
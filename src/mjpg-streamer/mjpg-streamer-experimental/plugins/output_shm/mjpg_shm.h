@@ -0,0 +1,69 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef MJPG_SHM_H
+#define MJPG_SHM_H
+
+#include <stdint.h>
+
+/*
+ * Layout of the shared memory object written by output_shm and read by
+ * mjpg_shm_reader. It starts with a header, followed by the slot table and
+ * the frame data of every slot, each at a page aligned offset.
+ *
+ * A slot is rewritten in place: the writer clears its seq, copies the frame
+ * and stores the new seq last. A reader that sees the same non-zero seq
+ * before and after looking at the frame knows the data was not touched in
+ * between. After each frame the writer bumps the futex word and wakes all
+ * processes waiting on it.
+ */
+#define MJPG_SHM_MAGIC   0x4d4a5047   /* "MJPG" */
+#define MJPG_SHM_VERSION 1
+
+#define MJPG_SHM_DEFAULT_NAME  "/mjpg-streamer"
+#define MJPG_SHM_DEFAULT_SLOTS 8
+#define MJPG_SHM_DEFAULT_SIZE  (1024 * 1024)
+
+typedef struct {
+    uint64_t seq;           /* sequence number of the frame, 0 while written */
+    uint64_t offset;        /* of the frame data from the start of the object */
+    uint32_t capacity;
+    uint32_t size;
+    int64_t tv_sec;         /* capture timestamp of the frame */
+    int64_t tv_usec;
+} mjpg_shm_slot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slot_size;
+    uint64_t total_size;    /* of the whole object */
+    uint64_t seq;           /* latest complete frame */
+    uint32_t futex;         /* incremented after every frame */
+    int32_t writer_pid;     /* 0 once the writer has stopped */
+    mjpg_shm_slot slot[];
+} mjpg_shm_header;
+
+#define MJPG_SHM_SLOT_OF(header, seq) (&(header)->slot[(seq) % (header)->slots])
+
+#endif
@@ -0,0 +1,221 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "mjpg_shm_reader.h"
+
+struct _mjpg_shm_reader {
+    const mjpg_shm_header *header;
+    size_t size;
+};
+
+/******************************************************************************
+Description.: maps the shared memory object of an output_shm plugin
+Input Value.: name of the object, as passed to output_shm with --name
+Return Value: the reader, or NULL with errno set
+******************************************************************************/
+mjpg_shm_reader *mjpg_shm_open(const char *name)
+{
+    mjpg_shm_reader *r;
+    struct stat st;
+    void *map;
+    int fd, err;
+
+    if((fd = shm_open(name, O_RDONLY, 0)) < 0)
+        return NULL;
+
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(mjpg_shm_header)) {
+        err = errno ? errno : EINVAL;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return NULL;
+
+    r = malloc(sizeof(*r));
+    if(r == NULL) {
+        munmap(map, st.st_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    r->header = map;
+    r->size = st.st_size;
+
+    /* the writer may still be setting up the object */
+    if(__atomic_load_n(&r->header->magic, __ATOMIC_ACQUIRE) != MJPG_SHM_MAGIC ||
+       r->header->version != MJPG_SHM_VERSION ||
+       r->header->total_size > r->size) {
+        mjpg_shm_close(r);
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    return r;
+}
+
+/******************************************************************************
+Description.: unmaps the object, frames returned before become invalid
+Input Value.: r is the reader
+Return Value: -
+******************************************************************************/
+void mjpg_shm_close(mjpg_shm_reader *r)
+{
+    if(r == NULL)
+        return;
+
+    munmap((void *)r->header, r->size);
+    free(r);
+}
+
+/******************************************************************************
+Description.: waits for a frame newer than last_seq and returns the newest one
+Input Value.: * r is the reader
+              * last_seq is the sequence number of the last frame seen, 0 to
+                take whatever frame is there
+              * timeout_ms limits the wait, -1 waits forever
+              * frame is filled in with a pointer to the frame
+Return Value: 0 if ok, -1 with errno ETIMEDOUT on timeout or EPIPE once the
+              writer has stopped
+******************************************************************************/
+int mjpg_shm_next(mjpg_shm_reader *r, uint64_t last_seq, int timeout_ms, mjpg_shm_frame *frame)
+{
+    const mjpg_shm_header *h = r->header;
+    const mjpg_shm_slot *s;
+    struct timespec now, deadline, left;
+    uint64_t seq;
+    uint32_t futex;
+
+    if(timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if(deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    while(1) {
+        /* read the futex word first, so a frame published after the
+           check below still ends the wait */
+        futex = __atomic_load_n(&h->futex, __ATOMIC_ACQUIRE);
+        seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+
+        if(seq > last_seq) {
+            s = MJPG_SHM_SLOT_OF(h, seq);
+
+            /* a different seq means the writer is already past this frame */
+            if(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != seq)
+                continue;
+
+            frame->data = (const unsigned char *)h + s->offset;
+            frame->size = s->size;
+            frame->timestamp.tv_sec = s->tv_sec;
+            frame->timestamp.tv_usec = s->tv_usec;
+            frame->seq = seq;
+            frame->slot = s;
+
+            if(mjpg_shm_valid(frame))
+                return 0;
+            continue;
+        }
+
+        if(__atomic_load_n(&h->writer_pid, __ATOMIC_ACQUIRE) == 0) {
+            errno = EPIPE;
+            return -1;
+        }
+
+        if(timeout_ms >= 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            left.tv_sec = deadline.tv_sec - now.tv_sec;
+            left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if(left.tv_nsec < 0) {
+                left.tv_sec--;
+                left.tv_nsec += 1000000000L;
+            }
+            if(left.tv_sec < 0) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+        }
+
+        /* returns at once if the writer bumped the word in the meantime */
+        syscall(SYS_futex, &h->futex, FUTEX_WAIT, futex,
+                timeout_ms >= 0 ? &left : NULL, NULL, 0);
+    }
+}
+
+/******************************************************************************
+Description.: checks that the slot of a frame was not rewritten since the
+              frame was returned by mjpg_shm_next()
+Input Value.: frame as returned by mjpg_shm_next()
+Return Value: 1 if the data is intact, 0 otherwise
+******************************************************************************/
+int mjpg_shm_valid(const mjpg_shm_frame *frame)
+{
+    /* order the reads of the frame data before the read of seq */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&frame->slot->seq, __ATOMIC_RELAXED) == frame->seq;
+}
+
+/******************************************************************************
+Description.: like mjpg_shm_next(), but copies the frame to a buffer owned by
+              the caller and retries if the writer overwrote it meanwhile
+Input Value.: * r, last_seq, timeout_ms and frame as for mjpg_shm_next(),
+                frame->data points into buffer afterwards
+              * buffer and size describe the destination
+Return Value: 0 if ok, -1 with errno set, ENOBUFS if the frame is too large
+******************************************************************************/
+int mjpg_shm_copy(mjpg_shm_reader *r, uint64_t last_seq, int timeout_ms,
+                  unsigned char *buffer, size_t size, mjpg_shm_frame *frame)
+{
+    while(1) {
+        if(mjpg_shm_next(r, last_seq, timeout_ms, frame) < 0)
+            return -1;
+
+        if(frame->size > size) {
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        memcpy(buffer, frame->data, frame->size);
+
+        if(mjpg_shm_valid(frame)) {
+            frame->data = buffer;
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef MJPG_SHM_READER_H
+#define MJPG_SHM_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "mjpg_shm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Reads the frames output_shm publishes, without copying them:
+ *
+ *     mjpg_shm_reader *r = mjpg_shm_open(MJPG_SHM_DEFAULT_NAME);
+ *     mjpg_shm_frame frame = {0};
+ *
+ *     while(mjpg_shm_next(r, frame.seq, 1000, &frame) == 0) {
+ *         decode(frame.data, frame.size);
+ *         if(!mjpg_shm_valid(&frame))
+ *             continue;      // the writer reused the slot meanwhile
+ *         ...
+ *     }
+ *
+ * frame.data points into the shared memory object and is rewritten once the
+ * writer went around all slots. Check mjpg_shm_valid() after using the data,
+ * or let mjpg_shm_copy() do that.
+ */
+typedef struct {
+    const unsigned char *data;
+    uint32_t size;
+    uint64_t seq;
+    struct timeval timestamp;
+    const mjpg_shm_slot *slot;
+} mjpg_shm_frame;
+
+typedef struct _mjpg_shm_reader mjpg_shm_reader;
+
+mjpg_shm_reader *mjpg_shm_open(const char *name);
+void mjpg_shm_close(mjpg_shm_reader *r);
+
+int mjpg_shm_next(mjpg_shm_reader *r, uint64_t last_seq, int timeout_ms, mjpg_shm_frame *frame);
+int mjpg_shm_valid(const mjpg_shm_frame *frame);
+int mjpg_shm_copy(mjpg_shm_reader *r, uint64_t last_seq, int timeout_ms,
+                  unsigned char *buffer, size_t size, mjpg_shm_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,455 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+/*
+  This output plugin copies the frames of an input plugin into a POSIX shared
+  memory object, see mjpg_shm.h for the layout. Processes on the same machine
+  read the frames in place with mjpg_shm_reader instead of pulling them over
+  HTTP.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "../../utils.h"
+#include "../../mjpg_streamer.h"
+#include "mjpg_shm.h"
+
+#define OUTPUT_PLUGIN_NAME "SHM output plugin"
+
+#define PAGE_ALIGN(x) (((x) + 4095) & ~((size_t)4095))
+
+/* limits of --slots and --size, the object stays below 64 GB */
+#define MAX_SLOTS   1024
+#define MAX_SIZE_KB (64 * 1024)
+
+static pthread_t worker;
+static globals *pglobal;
+static frame_consumer consumer;
+static consumer_policy policy = CONSUME_LATEST;
+static int policy_param = 0;
+static int input_number = 0;
+static char *name = MJPG_SHM_DEFAULT_NAME;
+static int slots = MJPG_SHM_DEFAULT_SLOTS;
+static int slot_size = MJPG_SHM_DEFAULT_SIZE;
+static mode_t mode = S_IRUSR | S_IWUSR;
+
+static mjpg_shm_header *header = NULL;
+static size_t total_size = 0;
+static metric *frames_written, *frames_oversized;
+
+/******************************************************************************
+Description.: print a help message
+Input Value.: -
+Return Value: -
+******************************************************************************/
+void help(void)
+{
+    fprintf(stderr, " ---------------------------------------------------------------\n" \
+            " Help for output plugin..: "OUTPUT_PLUGIN_NAME"\n" \
+            " ---------------------------------------------------------------\n" \
+            " The following parameters can be passed to this plugin:\n\n" \
+            " [-n | --name ]..........: name of the shared memory object (default "MJPG_SHM_DEFAULT_NAME")\n" \
+            " [-s | --slots ].........: number of frames kept in the object\n" \
+            " [-z | --size ]..........: largest frame in kB, larger frames are skipped\n" \
+            " [-m | --mode ]..........: permissions of the object in octal (default 600)\n" \
+            " [-i | --input ].........: read frames from the specified input plugin\n" \
+            " [--policy ].............: latest, every[:queue length] or fps:rate\n" \
+            " ---------------------------------------------------------------\n");
+}
+
+/******************************************************************************
+Description.: wakes up all readers waiting for a frame
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void shm_wake(void)
+{
+    __atomic_add_fetch(&header->futex, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &header->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/******************************************************************************
+Description.: parses a number of an option and checks its range
+Input Value.: * s is the argument of the option
+              * min and max are the valid range
+              * value receives the number
+Return Value: 0 if ok, -1 if s is no number or out of range
+******************************************************************************/
+static int parse_range(const char *s, long min, long max, int *value)
+{
+    char *end;
+    long v;
+
+    errno = 0;
+    v = strtol(s, &end, 10);
+    if(errno != 0 || end == s || *end != '\0' || v < min || v > max)
+        return -1;
+
+    *value = v;
+    return 0;
+}
+
+/******************************************************************************
+Description.: creates the shared memory object and lays out the slots, an
+              existing object is left alone, it may belong to another writer
+Input Value.: -
+Return Value: 0 if ok, -1 on error
+******************************************************************************/
+static int shm_create(void)
+{
+    size_t table, offset;
+    int fd, i;
+
+    table = PAGE_ALIGN(sizeof(mjpg_shm_header) + slots * sizeof(mjpg_shm_slot));
+    total_size = table + slots * PAGE_ALIGN(slot_size);
+
+    if((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, mode)) < 0) {
+        OPRINT("could not create shared memory object %s: %s\n", name, strerror(errno));
+        if(errno == EEXIST)
+            OPRINT("another writer may use it, remove /dev/shm%s if it is left over\n", name);
+        return -1;
+    }
+
+    /* the umask must not take away what --mode grants */
+    if(fchmod(fd, mode) < 0) {
+        OPRINT("could not set the mode of %s: %s\n", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    if(ftruncate(fd, total_size) < 0) {
+        OPRINT("could not resize shared memory object %s: %s\n", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    header = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(header == MAP_FAILED) {
+        OPRINT("could not map shared memory object %s: %s\n", name, strerror(errno));
+        header = NULL;
+        shm_unlink(name);
+        return -1;
+    }
+
+    header->version = MJPG_SHM_VERSION;
+    header->slots = slots;
+    header->slot_size = slot_size;
+    header->total_size = total_size;
+    header->writer_pid = getpid();
+
+    offset = table;
+    for(i = 0; i < slots; i++) {
+        header->slot[i].offset = offset;
+        header->slot[i].capacity = slot_size;
+        offset += PAGE_ALIGN(slot_size);
+    }
+
+    /* readers check the magic before they trust anything else */
+    __atomic_store_n(&header->magic, MJPG_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: copies a frame into the next slot of the shared memory object
+Input Value.: frame is the pinned frame of the input
+Return Value: -
+******************************************************************************/
+static void shm_write(frame_slot *frame)
+{
+    mjpg_shm_slot *s;
+    uint64_t seq = header->seq + 1;
+
+    if(frame->size > slot_size) {
+        DBG("frame of %d bytes does not fit a slot of %d bytes\n", frame->size, slot_size);
+        metric_inc(frames_oversized);
+        return;
+    }
+
+    s = MJPG_SHM_SLOT_OF(header, seq);
+
+    /* invalidate the slot before its data changes */
+    __atomic_store_n(&s->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy((unsigned char *)header + s->offset, frame->buf, frame->size);
+    s->size = frame->size;
+    s->tv_sec = frame->timestamp.tv_sec;
+    s->tv_usec = frame->timestamp.tv_usec;
+
+    __atomic_store_n(&s->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->seq, seq, __ATOMIC_RELEASE);
+
+    shm_wake();
+    metric_inc(frames_written);
+}
+
+/******************************************************************************
+Description.: clean up allocated resources
+Input Value.: unused argument
+Return Value: -
+******************************************************************************/
+void worker_cleanup(void *arg)
+{
+    static unsigned char first_run = 1;
+
+    if(!first_run) {
+        DBG("already cleaned up resources\n");
+        return;
+    }
+
+    first_run = 0;
+    OPRINT("cleaning up resources allocated by worker thread\n");
+
+    consumer_free(&consumer);
+
+    if(header != NULL) {
+        /* let waiting readers notice that no more frames will come */
+        __atomic_store_n(&header->writer_pid, 0, __ATOMIC_RELEASE);
+        shm_wake();
+        munmap(header, total_size);
+        header = NULL;
+        shm_unlink(name);
+    }
+}
+
+/******************************************************************************
+Description.: this is the main worker thread
+              it loops forever, grabs a fresh frame and copies it to the
+              shared memory object
+Input Value.:
+Return Value:
+******************************************************************************/
+void *worker_thread(void *arg)
+{
+    frame_slot *slot;
+
+    consumer_init(&consumer, &pglobal->in[input_number], policy, policy_param);
+
+    /* set cleanup handler to cleanup allocated resources */
+    pthread_cleanup_push(worker_cleanup, NULL);
+
+    while(!pglobal->stop) {
+        DBG("waiting for fresh frame\n");
+
+        /* the frame stays pinned while it is copied, no private copy needed */
+        slot = consumer_acquire(&consumer);
+        shm_write(slot);
+        latency_delivered(&slot->trace, input_number);
+        consumer_release(&consumer, slot);
+    }
+
+    /* cleanup now */
+    pthread_cleanup_pop(1);
+
+    return NULL;
+}
+
+/*** plugin interface functions ***/
+/******************************************************************************
+Description.: this function is called first, in order to initialise
+              this plugin and pass a parameter string
+Input Value.: parameters
+Return Value: 0 if everything is ok, non-zero otherwise
+******************************************************************************/
+int output_init(output_parameter *param, int id)
+{
+    char labels[32], *end;
+    int i;
+
+    pglobal = param->global;
+    pglobal->out[id].name = malloc((1+strlen(OUTPUT_PLUGIN_NAME))*sizeof(char));
+    sprintf(pglobal->out[id].name, "%s", OUTPUT_PLUGIN_NAME);
+
+    param->argv[0] = OUTPUT_PLUGIN_NAME;
+
+    /* show all parameters for DBG purposes */
+    for(i = 0; i < param->argc; i++) {
+        DBG("argv[%d]=%s\n", i, param->argv[i]);
+    }
+
+    reset_getopt();
+    while(1) {
+        int option_index = 0, c = 0;
+        static struct option long_options[] = {
+            {"h", no_argument, 0, 0},
+            {"help", no_argument, 0, 0},
+            {"n", required_argument, 0, 0},
+            {"name", required_argument, 0, 0},
+            {"s", required_argument, 0, 0},
+            {"slots", required_argument, 0, 0},
+            {"z", required_argument, 0, 0},
+            {"size", required_argument, 0, 0},
+            {"i", required_argument, 0, 0},
+            {"input", required_argument, 0, 0},
+            {"policy", required_argument, 0, 0},
+            {"m", required_argument, 0, 0},
+            {"mode", required_argument, 0, 0},
+            {0, 0, 0, 0}
+        };
+
+        c = getopt_long_only(param->argc, param->argv, "", long_options, &option_index);
+
+        /* no more options to parse */
+        if(c == -1) break;
+
+        /* unrecognized option */
+        if(c == '?') {
+            help();
+            return 1;
+        }
+
+        switch(option_index) {
+            /* h, help */
+        case 0:
+        case 1:
+            DBG("case 0,1\n");
+            help();
+            return 1;
+            break;
+
+            /* n, name */
+        case 2:
+        case 3:
+            DBG("case 2,3\n");
+            if(optarg[0] != '/' || strchr(optarg + 1, '/') != NULL) {
+                OPRINT("the name must start with / and contain no other /\n");
+                return 1;
+            }
+            name = strdup(optarg);
+            break;
+
+            /* s, slots */
+        case 4:
+        case 5:
+            DBG("case 4,5\n");
+            if(parse_range(optarg, 2, MAX_SLOTS, &slots) < 0) {
+                OPRINT("the number of slots must be between 2 and %d\n", MAX_SLOTS);
+                return 1;
+            }
+            break;
+
+            /* z, size */
+        case 6:
+        case 7:
+            DBG("case 6,7\n");
+            if(parse_range(optarg, 1, MAX_SIZE_KB, &slot_size) < 0) {
+                OPRINT("the frame size must be between 1 and %d kB\n", MAX_SIZE_KB);
+                return 1;
+            }
+            slot_size *= 1024;
+            break;
+
+            /* i, input */
+        case 8:
+        case 9:
+            DBG("case 8,9\n");
+            input_number = atoi(optarg);
+            break;
+
+            /* policy */
+        case 10:
+            DBG("case 10\n");
+            if(consumer_parse_policy(optarg, &policy, &policy_param) < 0) {
+                OPRINT("invalid policy %s\n", optarg);
+                help();
+                return 1;
+            }
+            break;
+
+            /* m, mode */
+        case 11:
+        case 12:
+            DBG("case 11,12\n");
+            errno = 0;
+            mode = strtol(optarg, &end, 8);
+            if(errno != 0 || end == optarg || *end != '\0' || (mode & ~0777) != 0) {
+                OPRINT("invalid mode %s, expected octal permissions like 640\n", optarg);
+                return 1;
+            }
+            break;
+        }
+    }
+
+    if(!(input_number < pglobal->incnt)) {
+        OPRINT("ERROR: the %d input_plugin number is too much only %d plugins loaded\n", input_number, pglobal->incnt);
+        return 1;
+    }
+
+    OPRINT("input plugin.....: %d: %s\n", input_number, pglobal->in[input_number].plugin);
+    OPRINT("shared memory.....: %s\n", name);
+    OPRINT("slots.............: %d of %d kB\n", slots, slot_size / 1024);
+    OPRINT("mode..............: %03o\n", (unsigned int)mode);
+    OPRINT("frame policy......: %s\n", consumer_policy_name(policy));
+
+    if(shm_create() < 0)
+        return 1;
+
+    snprintf(labels, sizeof(labels), "output=\"%d\"", id);
+    frames_written = metric_counter("mjpg_shm_frames_total", labels,
+                                    "Frames copied to the shared memory object.");
+    frames_oversized = metric_counter("mjpg_shm_frames_oversized_total", labels,
+                                      "Frames skipped because they do not fit a slot.");
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: calling this function stops the worker thread
+Input Value.: -
+Return Value: always 0
+******************************************************************************/
+int output_stop(int id)
+{
+    DBG("will cancel worker thread\n");
+    pthread_cancel(worker);
+    return 0;
+}
+
+/******************************************************************************
+Description.: calling this function creates and starts the worker thread
+Input Value.: -
+Return Value: always 0
+******************************************************************************/
+int output_run(int id)
+{
+    DBG("launching worker thread\n");
+    pthread_create(&worker, 0, worker_thread, NULL);
+    pthread_detach(worker);
+    return 0;
+}
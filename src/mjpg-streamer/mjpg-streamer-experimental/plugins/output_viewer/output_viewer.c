@@ -38,7 +38,9 @@
 
 static pthread_t worker;
 static globals *pglobal;
-static unsigned char *frame = NULL;
+static frame_consumer consumer;
+static consumer_policy policy = CONSUME_LATEST;
+static int policy_param = 0;
 static int input_number = 0;
 
 /******************************************************************************
@@ -50,6 +52,10 @@ void help(void)
 {
     fprintf(stderr, " ---------------------------------------------------------------\n" \
             " Help for output plugin..: "OUTPUT_PLUGIN_NAME"\n" \
+            " ---------------------------------------------------------------\n" \
+            " The following parameters can be passed to this plugin:\n\n" \
+            " [-i | --input ].........: read frames from the specified input plugin\n" \
+            " [--policy ].............: latest, every[:queue length] or fps:rate\n" \
             " ---------------------------------------------------------------\n");
 }
 
@@ -70,7 +76,7 @@ void worker_cleanup(void *arg)
     first_run = 0;
     OPRINT("cleaning up resources allocated by worker thread\n");
 
-    free(frame);
+    consumer_free(&consumer);
     SDL_Quit();
 }
 
@@ -253,6 +259,7 @@ Return Value:
 void *worker_thread(void *arg)
 {
     int frame_size = 0, firstrun = 1;
+    unsigned char *frame;
 
     SDL_Surface *screen = NULL, *image = NULL;
     decompressed_image rgbimage;
@@ -267,25 +274,21 @@ void *worker_thread(void *arg)
         exit(EXIT_FAILURE);
     }
 
-    /* just allocate a large buffer for the JPEGs */
-    if((frame = malloc(4096 * 1024)) == NULL) {
-        OPRINT("not enough memory for worker thread\n");
-        exit(EXIT_FAILURE);
-    }
+    consumer_init(&consumer, &pglobal->in[input_number], policy, policy_param);
 
     /* set cleanup handler to cleanup allocated resources */
     pthread_cleanup_push(worker_cleanup, NULL);
 
     while(!pglobal->stop) {
         DBG("waiting for fresh frame\n");
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        if(consumer_next(&consumer) < 0) {
+            OPRINT("not enough memory for worker thread\n");
+            exit(EXIT_FAILURE);
+        }
 
         /* read buffer */
-        frame_size = pglobal->in[input_number].size;
-        memcpy(frame, pglobal->in[input_number].buf, frame_size);
-
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
+        frame = consumer.buf;
+        frame_size = consumer.size;
 
         /* decompress the JPEG and store results in memory */
         if(decompress_jpeg(frame, frame_size, &rgbimage)) {
@@ -360,6 +363,7 @@ int output_init(output_parameter *param)
             {"help", no_argument, 0, 0},
             {"i", required_argument, 0, 0},
             {"input", required_argument, 0, 0},
+            {"policy", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -388,6 +392,15 @@ int output_init(output_parameter *param)
             DBG("case 2,3\n");
             input_number = atoi(optarg);
             break;
+            /* policy */
+        case 4:
+            DBG("case 4\n");
+            if(consumer_parse_policy(optarg, &policy, &policy_param) < 0) {
+                OPRINT("invalid policy %s\n", optarg);
+                help();
+                return 1;
+            }
+            break;
         }
     }
 
@@ -397,6 +410,7 @@ int output_init(output_parameter *param)
         return 1;
     }
     OPRINT("input plugin.....: %d: %s\n", input_number, pglobal->in[input_number].plugin);
+    OPRINT("frame policy......: %s\n", consumer_policy_name(policy));
 
     return 0;
 }
@@ -58,6 +58,9 @@ static int fd, ringbuffer_size = -1, ringbuffer_exceed = 0, max_frame_size;
 static char *folder = "/tmp";
 static unsigned char *frame = NULL;
 static unsigned char *frames[MAX_ZMQ_BUFFER_SIZE];
+static frame_consumer consumer;
+static consumer_policy policy = CONSUME_LATEST;
+static int policy_param = 0;
 static char *command = NULL;
 static int input_number = 0;
 static char *mjpgFileName = NULL;
@@ -88,6 +91,7 @@ void help(void)
             " [-f | --folder ]........: folder to save pictures\n" \
             " [-m | --mjpeg ].........: save the frames to an mjpg file \n" \
             " [-i | --input ].........: read frames from the specified input plugin\n" \
+            " [--policy ].............: latest, every[:queue length] or fps:rate\n" \
             " The following arguments are takes effect only if the current mode is not MJPG\n" \
             " [-s | --size ]..........: size of ring buffer (max number of pictures to hold)\n" \
             " [-e | --exceed ]........: allow ringbuffer to exceed limit by this amount\n" \
@@ -120,6 +124,7 @@ void worker_cleanup(void *arg)
     if(frame != NULL) {
         free(frame);
     }
+    consumer_free(&consumer);
     close(fd);
 
     // cleanup zmq
@@ -240,6 +245,7 @@ void *worker_thread(void *arg)
     char buffer1[1024] = {0}, buffer2[1024] = {0};
     unsigned long long counter = 0;
     unsigned char *tmp_framebuffer = NULL;
+    frame_slot *slot;
 
     //  Prepare our context and publisher
     //char zmqAddress[20];
@@ -277,17 +283,19 @@ void *worker_thread(void *arg)
         }
         pb__package__frame__init(pbPackage.frame[i]);
     }
+    consumer_init(&consumer, &pglobal->in[input_number], policy, policy_param);
+
     /* set cleanup handler to cleanup allocated ressources */
     pthread_cleanup_push(worker_cleanup, NULL);
 
     while(ok >= 0 && !pglobal->stop) {
         DBG("waiting for fresh frame\n");
 
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        /* pin the next frame, it is copied without holding the mutex */
+        slot = consumer_acquire(&consumer);
 
         /* read buffer */
-        frame_size = pglobal->in[input_number].size;
+        frame_size = slot->size;
 
         /* set the right frame to store the data */
         frame = frames[zmqBufferPos];
@@ -300,7 +308,7 @@ void *worker_thread(void *arg)
                 max_frame_size = frame_size + (1 << 16);
             }
             if((tmp_framebuffer = realloc(frame, max_frame_size)) == NULL) {
-                pthread_mutex_unlock(&pglobal->in[input_number].db);
+                consumer_release(&consumer, slot);
                 LOG("not enough memory\n");
                 return NULL;
             }
@@ -313,17 +321,15 @@ void *worker_thread(void *arg)
         }
 
         /* copy v4l2_buffer timeval to user space */
-        timestamp = pglobal->in[input_number].timestamp;
+        timestamp = slot->timestamp;
 
         /* copy frame to our local buffer now */
-        memcpy(frame, pglobal->in[input_number].buf, frame_size);
+        memcpy(frame, slot->buf, frame_size);
+        consumer_release(&consumer, slot);
 
         /* resync again with the frame buffer */
         frames[zmqBufferPos] = frame;
 
-        /* allow others to access the global buffer again */
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
-
         if (mjpgFileName == NULL) { // single files with ringbuffer mode
             DBG("Packaging data: %lld\n", counter);
             counter++;
@@ -471,6 +477,7 @@ int output_init(output_parameter *param, int id)
             {"address", required_argument, 0, 0},
             {"b", required_argument, 0, 0},
             {"buffer_size", required_argument, 0, 0},
+            {"policy", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -541,6 +548,15 @@ int output_init(output_parameter *param, int id)
             DBG("case 14,15\n");
             zmqBufferSize = atoi(optarg);
             break;
+            /* policy */
+        case 16:
+            DBG("case 16\n");
+            if(consumer_parse_policy(optarg, &policy, &policy_param) < 0) {
+                OPRINT("invalid policy %s\n", optarg);
+                help();
+                return 1;
+            }
+            break;
         }
     }
 
@@ -551,6 +567,7 @@ int output_init(output_parameter *param, int id)
 
     OPRINT("output folder.....: %s\n", folder);
     OPRINT("input plugin.....: %d: %s\n", input_number, pglobal->in[input_number].plugin);
+    OPRINT("frame policy......: %s\n", consumer_policy_name(policy));
     if  (mjpgFileName == NULL) {
         if(ringbuffer_size > 0) {
             OPRINT("ringbuffer size...: %d to %d\n", ringbuffer_size, ringbuffer_size + ringbuffer_exceed);
@@ -647,35 +664,14 @@ int output_cmd(int plugin_id, unsigned int control_id, unsigned int group, int v
 					switch(control_id) {
                             case OUT_FILE_CMD_TAKE: {
                                 if (valueStr != NULL) {
-                                    int frame_size = 0;
-                                    unsigned char *tmp_framebuffer = NULL;
+                                    frame_slot *slot;
 
-                                    if(pthread_mutex_lock(&pglobal->in[input_number].db)) {
-                                        DBG("Unable to lock mutex\n");
+                                    /* take the current frame, there is no need to wait for the next one */
+                                    slot = wait_for_frame(&pglobal->in[input_number], 0, 0);
+                                    if(slot == NULL) {
+                                        OPRINT("no frame available yet\n");
                                         return -1;
                                     }
-                                    /* read buffer */
-                                    frame_size = pglobal->in[input_number].size;
-
-                                    /* check if buffer for frame is large enough, increase it if necessary */
-                                    if(frame_size > max_frame_size) {
-                                        DBG("increasing buffer size to %d\n", frame_size);
-
-                                        max_frame_size = frame_size + (1 << 16);
-                                        if((tmp_framebuffer = realloc(frame, max_frame_size)) == NULL) {
-                                            pthread_mutex_unlock(&pglobal->in[input_number].db);
-                                            LOG("not enough memory\n");
-                                            return -1;
-                                        }
-
-                                        frame = tmp_framebuffer;
-                                    }
-
-                                    /* copy frame to our local buffer now */
-                                    memcpy(frame, pglobal->in[input_number].buf, frame_size);
-
-                                    /* allow others to access the global buffer again */
-                                    pthread_mutex_unlock(&pglobal->in[input_number].db);
 
                                     DBG("writing file: %s\n", valueStr);
 
@@ -683,18 +679,21 @@ int output_cmd(int plugin_id, unsigned int control_id, unsigned int group, int v
                                     /* open file for write */
                                     if((fd = open(valueStr, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
                                         OPRINT("could not open the file %s\n", valueStr);
+                                        frame_unref(&pglobal->in[input_number], slot);
                                         return -1;
                                     }
 
-                                    /* save picture to file */
+                                    /* save picture to file, straight from the pinned slot */
                                     //if(write(fileno(stdout), frame, frame_size) < 0) {
-                                    if(fwrite(frame, sizeof(unsigned char), frame_size, stdout) < 0) {
+                                    if(fwrite(slot->buf, sizeof(unsigned char), slot->size, stdout) < 0) {
                                         OPRINT("could not write to file %s\n", valueStr);
                                         perror("fwrite()");
+                                        frame_unref(&pglobal->in[input_number], slot);
                                         close(fd);
                                         return -1;
                                     }
 
+                                    frame_unref(&pglobal->in[input_number], slot);
                                     close(fd);
                                 } else {
                                     DBG("No filename specified\n");
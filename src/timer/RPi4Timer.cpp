@@ -31,17 +31,21 @@
 #include "RPi4Timer.h"
 #include "RPi4.h"
 
-unsigned long get_microsecond_timestamp()
+// 64 bit even where long is 32 bit, which would wrap after 71 minutes
+uint64_t get_microsecond_timestamp()
 {
 	struct timespec t;
 
-	if(clock_gettime(CLOCK_MONOTONIC_RAW, &t) != 0) { return 0; }
+	// CLOCK_MONOTONIC is shared with mjpg-streamer, so frame stamps can be compared
+	if(clock_gettime(CLOCK_MONOTONIC, &t) != 0) { return 0; }
 
-	return (unsigned long) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+	return (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
 }
 
 void RPi4Timer::delay_us(unsigned int micros)
 {
-	unsigned long nowtime = get_microsecond_timestamp();
+	uint64_t nowtime = get_microsecond_timestamp();
 	while((get_microsecond_timestamp() - nowtime) < micros / 2) {}
-}
\ No newline at end of file
+}
+
+uint64_t RPi4Timer::micros() { return get_microsecond_timestamp(); }
\ No newline at end of file
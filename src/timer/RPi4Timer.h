@@ -38,8 +38,9 @@ class RPi4Timer : public Timer
 	volatile unsigned int * arm_timer;
 
   public:
-	void init() {}
-	void delay_us(unsigned int micros);
+	void		  init() {}
+	void		  delay_us(unsigned int micros);
+	uint64_t	  micros();
 };
 
 #endif
\ No newline at end of file
@@ -29,17 +29,21 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include <stdint.h>
+
 class Timer
 {
   public:
 	virtual void init();
-	virtual void delay_us(unsigned int micros);
-	void		 delay_ms(unsigned int millis);
+	virtual void		  delay_us(unsigned int micros);
+	virtual uint64_t	  micros();
+	void				  delay_ms(unsigned int millis);
 };
 
 inline void Timer::delay_ms(unsigned int millis) { this->delay_us(millis * 1000); };
 
 inline void Timer::init() {}
 inline void Timer::delay_us(unsigned int micros) {}
+inline uint64_t Timer::micros() { return 0; }
 
 #endif
\ No newline at end of file